@@ -0,0 +1,164 @@
+#include "pch.h"
+
+#include "phm_benchmark.h"
+
+#include "phm_entity.h"
+#include "phm_view.h"
+#include "phm_model.h"
+
+#include <array>
+#include <bitset>
+#include <memory>
+#include <vector>
+
+// Iterates Transform and ModelComponent of 1M entities, once in the archetype storage and once in the layout the ECS had before:
+// every entity a separate heap allocation and every component a new T behind a std::unique_ptr with a virtual update.
+
+namespace
+{
+	constexpr uint32_t ENTITY_COUNT = 1'000'000;
+	constexpr uint32_t REPETITIONS = 10;
+
+	namespace legacy
+	{
+		constexpr size_t maxComponents = 32;
+
+		class Entity;
+
+		class Component
+		{
+		public:
+			virtual ~Component() = default;
+
+			virtual void update(Entity& entity) {};
+
+		protected:
+			Entity* entityPtr_ = nullptr;
+
+			friend Entity;
+		};
+
+		inline size_t getComponentTypeID()
+		{
+			static size_t lastID = 0;
+			return lastID++;
+		}
+
+		template<typename T>
+		inline size_t getComponentTypeID() noexcept
+		{
+			static size_t typeID = getComponentTypeID();
+			return typeID;
+		}
+
+		class ModelComponent : public Component
+		{
+		public:
+			std::shared_ptr<phm::Model> model{};
+			glm::vec3 color{};
+		};
+
+		class Entity
+		{
+		public:
+			phm::Transform transform{};
+
+			template<typename T>
+			inline bool hasComponent() const
+			{
+				return componentBitSet_[getComponentTypeID<T>()];
+			}
+
+			template<typename T>
+			T& addComponent()
+			{
+				T* c(new T());
+				c->entityPtr_ = this;
+				components_.emplace_back(c);
+
+				componentArray_[getComponentTypeID<T>()] = c;
+				componentBitSet_[getComponentTypeID<T>()] = true;
+
+				return *c;
+			}
+
+			template<typename T>
+			inline T& getComponent() const
+			{
+				return *static_cast<T*>(componentArray_[getComponentTypeID<T>()]);
+			}
+
+		private:
+			std::vector<std::unique_ptr<Component>> components_;
+
+			std::array<Component*, maxComponents> componentArray_{};
+			std::bitset<maxComponents> componentBitSet_{};
+		};
+	}
+
+	glm::vec3 colorOf(uint32_t i)
+	{
+		return glm::vec3{ static_cast<float>(i % 7), static_cast<float>(i % 11), static_cast<float>(i % 13) };
+	}
+
+	glm::vec3 translationOf(uint32_t i)
+	{
+		return glm::vec3{ static_cast<float>(i % 1000), static_cast<float>(i / 1000), 1.0f };
+	}
+}
+
+int main()
+{
+	std::printf("Iterating Transform + ModelComponent of %u entities, best of %u\n", ENTITY_COUNT, REPETITIONS);
+
+	// Current layout
+	phm::ecs::ArchetypeStorage storage{};
+	for (uint32_t i = 0; i < ENTITY_COUNT; i++)
+	{
+		phm::ecs::Entity entity{ storage, storage.createEntity() };
+		entity.addComponent<phm::Transform>();
+		entity.transform().setTranslation(translationOf(i));
+
+		std::shared_ptr<phm::Model> model{};
+		entity.addComponent<phm::ecs::ModelComponent>(model).color = colorOf(i);
+	}
+
+	const phm::ecs::View<phm::Transform, phm::ecs::ModelComponent> view{ storage };
+	const double archetypeMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			glm::vec3 sum{ 0.0f };
+			view.eachChunk([&](uint32_t count, const phm::ecs::EntityId*, phm::Transform* transforms, phm::ecs::ModelComponent* models)
+				{
+					for (uint32_t i = 0; i < count; i++)
+						sum += transforms[i].getTranslation() * models[i].color;
+				});
+			phm::benchmark::doNotOptimize(sum);
+		});
+
+	// Previous layout
+	std::vector<std::unique_ptr<legacy::Entity>> entities;
+	entities.reserve(ENTITY_COUNT);
+	for (uint32_t i = 0; i < ENTITY_COUNT; i++)
+	{
+		auto entity = std::make_unique<legacy::Entity>();
+		entity->transform.setTranslation(translationOf(i));
+		entity->addComponent<legacy::ModelComponent>().color = colorOf(i);
+		entities.emplace_back(std::move(entity));
+	}
+
+	const double legacyMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			glm::vec3 sum{ 0.0f };
+			for (auto& entity : entities)
+			{
+				if (entity->hasComponent<legacy::ModelComponent>())
+					sum += entity->transform.getTranslation() * entity->getComponent<legacy::ModelComponent>().color;
+			}
+			phm::benchmark::doNotOptimize(sum);
+		});
+
+	phm::benchmark::report("Heap entities, unique_ptr components", legacyMilliseconds);
+	phm::benchmark::report("Archetype chunks", archetypeMilliseconds, legacyMilliseconds);
+
+	return 0;
+}
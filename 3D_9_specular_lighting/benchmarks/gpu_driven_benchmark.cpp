@@ -0,0 +1,156 @@
+#include "pch.h"
+
+#include "phm_benchmark.h"
+
+#include "phm_window.h"
+#include "phm_device.h"
+#include "phm_renderer.h"
+#include "phm_descriptor.h"
+#include "phm_manager.h"
+#include "phm_jobSystem.h"
+#include "phm_assetCache.h"
+#include "phm_meshCache.h"
+#include "phm_geometryPool.h"
+
+#include <filesystem>
+#include <memory>
+
+// Renders a grid of 100k models through the ECS manager, once on the GPU driven path and once on the CPU culled path,
+// and compares the CPU time per frame the manager spends culling and recording the draws of the scene, as counted in its render stats.
+// The whole frame, including waiting for the GPU and presenting, is reported as well. It depends on the GPU, on lavapipe it is mostly rasterization.
+
+namespace
+{
+	constexpr uint32_t GRID_SIZE = 317;
+	constexpr float GRID_SPACING = 1.5f;
+	// The object buffers of every frame in flight have to be filled before the frames are representative.
+	constexpr uint32_t WARMUP_FRAMES = 10;
+	constexpr uint32_t FRAMES = 100;
+
+	struct FrameTimes
+	{
+		double cpuMilliseconds = 0.0;
+		double frameMilliseconds = 0.0;
+		phm::RenderStats lastStats{};
+	};
+
+	FrameTimes renderFrames(phm::Device& device, phm::Renderer& renderer, phm::ecs::Manager& manager, phm::Camera& camera, GLFWwindow* window)
+	{
+		FrameTimes times{};
+		uint32_t frame = 0;
+		while (frame < WARMUP_FRAMES + FRAMES)
+		{
+			glfwPollEvents();
+
+			const auto start = std::chrono::steady_clock::now();
+
+			device.getGeometryPool().update();
+
+			auto commandBuffer = renderer.beginFrame();
+			if (commandBuffer == nullptr)
+				continue;
+
+			const phm::FrameInfo frameInfo{
+				renderer.getFrameIndex(),
+				1.0f / 60.0f,
+				commandBuffer,
+				camera
+			};
+
+			manager.update(frameInfo, renderer, window);
+			manager.prepareRender(frameInfo);
+
+			renderer.beginSwapChainRenderPass(commandBuffer);
+			manager.render(frameInfo, renderer);
+			renderer.endSwapChainRenderPass(commandBuffer);
+			renderer.endFrame();
+
+			manager.refresh();
+
+			const auto end = std::chrono::steady_clock::now();
+			if (frame++ < WARMUP_FRAMES)
+				continue;
+
+			times.cpuMilliseconds += manager.getRenderStats().cpuMilliseconds;
+			times.frameMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+			times.lastStats = manager.getRenderStats();
+		}
+
+		vkDeviceWaitIdle(device.device());
+
+		times.cpuMilliseconds /= FRAMES;
+		times.frameMilliseconds /= FRAMES;
+		return times;
+	}
+
+	void printStats(const char* name, const phm::RenderStats& stats)
+	{
+		std::printf("%-48s %u visible, %u draw calls, %u triangles\n", name, stats.visibleObjects, stats.drawCalls, stats.triangles);
+	}
+}
+
+int main()
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "phm_gpu_driven_benchmark.obj").string();
+	phm::benchmark::writeSphereObj(path, 8, 12);
+
+	phm::Window window{ 800, 600, "GPU driven benchmark" };
+	phm::Device device{ window };
+	phm::Renderer renderer{ window, device };
+	phm::JobSystem jobSystem{};
+
+	std::unique_ptr<phm::DescriptorPool> globalPool{ phm::DescriptorPool::Builder(device)
+		.setMaxSets(phm::Swapchain::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, phm::Swapchain::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * phm::Swapchain::MAX_FRAMES_IN_FLIGHT)
+		.build() };
+
+	phm::AssetCache assetCache{ device, &jobSystem, phm::VertexFormat::Quantized };
+	phm::ecs::Manager manager{ device, renderer.getSwapChainRenderPass(), globalPool.get(), jobSystem };
+
+	{
+		std::shared_ptr<phm::Model> model = assetCache.getModel(path);
+		for (uint32_t x = 0; x < GRID_SIZE; x++)
+		{
+			for (uint32_t z = 0; z < GRID_SIZE; z++)
+			{
+				auto entity = manager.addEntity();
+				entity.addComponent<phm::ecs::ModelComponent>(model);
+				entity.transform().setTranslation({ (x - GRID_SIZE / 2.0f) * GRID_SPACING, 0.0f, (z - GRID_SIZE / 2.0f) * GRID_SPACING });
+				entity.transform().setScale(glm::vec3{ 0.5f });
+			}
+		}
+	}
+	std::filesystem::remove(phm::MeshCache::getCachePath(path));
+	std::filesystem::remove(path);
+
+	phm::Camera camera{};
+	auto viewerEntity = manager.addEntity();
+	manager.setCamera(&camera);
+	manager.setViewerEntity(viewerEntity);
+	viewerEntity.transform().setTranslation({ 0.0f, -5.0f, -GRID_SIZE * GRID_SPACING / 4.0f });
+
+	std::printf("Rendering %u models, average of %u frames\n", GRID_SIZE * GRID_SIZE, FRAMES);
+
+	manager.setGpuDriven(false);
+	const FrameTimes cpuCulled = renderFrames(device, renderer, manager, camera, window.getGLFWWindow());
+
+	manager.setGpuDriven(true);
+	if (!manager.isGpuDriven())
+	{
+		std::printf("The device doesn't support multiDrawIndirect, only the CPU culled path can run\n");
+		phm::benchmark::report("CPU culled, culling and recording", cpuCulled.cpuMilliseconds);
+		phm::benchmark::report("CPU culled, whole frame", cpuCulled.frameMilliseconds);
+		return 0;
+	}
+	const FrameTimes gpuDriven = renderFrames(device, renderer, manager, camera, window.getGLFWWindow());
+
+	printStats("CPU culled", cpuCulled.lastStats);
+	printStats("GPU driven", gpuDriven.lastStats);
+	phm::benchmark::report("CPU culled, culling and recording", cpuCulled.cpuMilliseconds);
+	phm::benchmark::report("GPU driven, culling and recording", gpuDriven.cpuMilliseconds, cpuCulled.cpuMilliseconds);
+	phm::benchmark::report("CPU culled, whole frame", cpuCulled.frameMilliseconds);
+	phm::benchmark::report("GPU driven, whole frame", gpuDriven.frameMilliseconds, cpuCulled.frameMilliseconds);
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include "pch.h"
+
+#include "phm_benchmark.h"
+
+#include "phm_jobSystem.h"
+
+#include <cmath>
+#include <vector>
+
+// Measures the cost of spawning jobs, and how a parallelFor over a compute bound loop scales from 1 to all hardware threads.
+
+namespace
+{
+	constexpr uint32_t JOB_COUNT = 100'000;
+	constexpr uint32_t ELEMENT_COUNT = 4'000'000;
+	constexpr uint32_t REPETITIONS = 5;
+
+	// Enough work per element that the loop is bound by the arithmetic rather than by memory.
+	float work(float value)
+	{
+		for (uint32_t i = 0; i < 16; i++)
+			value = std::sqrt(value * value + 1.0f) * 0.999f;
+		return value;
+	}
+}
+
+int main()
+{
+	const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::printf("Spawn overhead, %u empty jobs, best of %u\n", JOB_COUNT, REPETITIONS);
+	for (uint32_t threads = 1; threads <= maxThreads; threads++)
+	{
+		phm::JobSystem jobSystem{ threads - 1 };
+
+		const double milliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+			{
+				phm::JobSystem::Counter counter;
+				for (uint32_t i = 0; i < JOB_COUNT; i++)
+					jobSystem.run(counter, []() {});
+				jobSystem.wait(counter);
+			});
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "%u thread(s)", threads);
+		std::printf("%-48s %10.3f ms %8.1f ns/job\n", name, milliseconds, milliseconds * 1e6 / JOB_COUNT);
+	}
+
+	std::printf("\nDependent jobs, a chain of %u jobs each waiting for the previous one\n", JOB_COUNT / 10);
+	{
+		phm::JobSystem jobSystem{};
+		const uint32_t chainLength = JOB_COUNT / 10;
+
+		const double milliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+			{
+				std::vector<phm::JobSystem::Counter> counters(chainLength);
+				jobSystem.run(counters[0], []() {});
+				for (uint32_t i = 1; i < chainLength; i++)
+					jobSystem.runAfter(counters[i - 1], counters[i], []() {});
+				jobSystem.wait(counters[chainLength - 1]);
+			});
+
+		std::printf("%-48s %10.3f ms %8.1f ns/job\n", "All threads", milliseconds, milliseconds * 1e6 / chainLength);
+	}
+
+	std::printf("\nparallelFor scaling, %u elements, best of %u\n", ELEMENT_COUNT, REPETITIONS);
+	std::vector<float> values(ELEMENT_COUNT);
+	double singleThreadMilliseconds = 0.0;
+	for (uint32_t threads = 1; threads <= maxThreads; threads++)
+	{
+		phm::JobSystem jobSystem{ threads - 1 };
+
+		const double milliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+			{
+				jobSystem.parallelFor(ELEMENT_COUNT, jobSystem.getBatchSize(ELEMENT_COUNT, 1024), [&](uint32_t begin, uint32_t end)
+					{
+						for (uint32_t i = begin; i < end; i++)
+							values[i] = work(static_cast<float>(i));
+					});
+			});
+		phm::benchmark::doNotOptimize(values[ELEMENT_COUNT / 2]);
+
+		if (threads == 1)
+			singleThreadMilliseconds = milliseconds;
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "%u thread(s)", threads);
+		phm::benchmark::report(name, milliseconds, singleThreadMilliseconds);
+	}
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include "pch.h"
+
+#include "phm_benchmark.h"
+
+#include "phm_model.h"
+#include "phm_meshCache.h"
+#include "phm_meshOptimizer.h"
+#include "phm_meshSimplifier.h"
+#include "phm_jobSystem.h"
+
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+// Compares the load time of a mesh through the OBJ path, which every launch paid before the cache existed,
+// with a cold load that misses the cache (parse, optimize, simplify and write the cache entry, as the first launch does),
+// and a warm load that maps the cache entry and copies its streams out, like they are copied into a staging buffer.
+
+namespace
+{
+	constexpr uint32_t RINGS = 300;
+	constexpr uint32_t SEGMENTS = 600;
+	constexpr uint32_t REPETITIONS = 3;
+}
+
+int main()
+{
+	namespace fs = std::filesystem;
+
+	const std::string path = (fs::temp_directory_path() / "phm_mesh_cache_benchmark.obj").string();
+	phm::benchmark::writeSphereObj(path, RINGS, SEGMENTS);
+	const std::string cachePath = phm::MeshCache::getCachePath(path);
+
+	phm::JobSystem jobSystem{};
+
+	std::printf("Loading a mesh of %u triangles (%.1f MiB of OBJ), best of %u\n", 2 * RINGS * SEGMENTS,
+		fs::file_size(path) / (1024.0 * 1024.0), REPETITIONS);
+
+	const double objMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			phm::Model::Builder builder{};
+			builder.loadModel(path, &jobSystem);
+			phm::benchmark::doNotOptimize(builder.indices.back());
+		});
+
+	const double coldMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			fs::remove(cachePath);
+
+			phm::Model::Builder builder{};
+			builder.loadModel(path, &jobSystem);
+			phm::MeshOptimizer::optimize(builder);
+			phm::MeshSimplifier::generateLods(builder);
+			phm::MeshCache::store(path, builder);
+		});
+
+	if (!phm::MeshCache::load(path))
+	{
+		std::printf("The cache entry was not written, is the working directory writable?\n");
+		return 1;
+	}
+
+	std::vector<phm::Model::Vertex> stagingVertices{};
+	std::vector<uint32_t> stagingIndices{};
+	const double warmMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			auto mesh = phm::MeshCache::load(path);
+			stagingVertices.resize(mesh->getVertexCount());
+			stagingIndices.resize(mesh->getIndexCount());
+			std::memcpy(stagingVertices.data(), mesh->getVertices(), stagingVertices.size() * sizeof(phm::Model::Vertex));
+			std::memcpy(stagingIndices.data(), mesh->getIndices(), stagingIndices.size() * sizeof(uint32_t));
+		});
+
+	fs::remove(cachePath);
+	fs::remove(path);
+
+	phm::benchmark::report("OBJ, parse and deduplicate", objMilliseconds);
+	phm::benchmark::report("Cold cache, OBJ path and writing the entry", coldMilliseconds, objMilliseconds);
+	phm::benchmark::report("Warm cache, mapped and copied", warmMilliseconds, objMilliseconds);
+
+	return 0;
+}
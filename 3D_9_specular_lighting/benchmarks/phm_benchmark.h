@@ -0,0 +1,95 @@
+#ifndef PHM_BENCHMARK_H
+#define PHM_BENCHMARK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace phm
+{
+	namespace benchmark
+	{
+		// Runs func repetitions times and returns the fastest run in milliseconds.
+		// The fastest run is the one least disturbed by the rest of the system.
+		template<typename Func>
+		double measure(uint32_t repetitions, Func&& func)
+		{
+			double best = std::numeric_limits<double>::max();
+			for (uint32_t i = 0; i < repetitions; i++)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				func();
+				const auto end = std::chrono::steady_clock::now();
+				best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+			}
+			return best;
+		}
+
+		// Keeps the compiler from optimizing away a computation whose result is otherwise unused.
+		template<typename T>
+		inline void doNotOptimize(const T& value)
+		{
+			static const T* volatile sink = nullptr;
+			sink = &value;
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+		}
+
+		inline void report(const char* name, double milliseconds)
+		{
+			std::printf("%-48s %10.3f ms\n", name, milliseconds);
+		}
+
+		// Reports the measurement along with how many times faster it is than the baseline.
+		inline void report(const char* name, double milliseconds, double baselineMilliseconds)
+		{
+			std::printf("%-48s %10.3f ms %8.2fx\n", name, milliseconds, baselineMilliseconds / milliseconds);
+		}
+
+		// Writes a UV sphere with texture coordinates and normals to an OBJ file, 2 * rings * segments triangles.
+		// Generated instead of shipped, so benchmarks can pick any size.
+		inline void writeSphereObj(const std::string& path, uint32_t rings, uint32_t segments)
+		{
+			FILE* file = std::fopen(path.c_str(), "w");
+			if (file == nullptr)
+				throw std::runtime_error("failed to create " + path);
+
+			const float pi = 3.14159265358979f;
+			for (uint32_t ring = 0; ring <= rings; ring++)
+			{
+				const float theta = pi * ring / rings;
+				for (uint32_t segment = 0; segment <= segments; segment++)
+				{
+					const float phi = 2.0f * pi * segment / segments;
+					const float x = std::sin(theta) * std::cos(phi);
+					const float y = std::cos(theta);
+					const float z = std::sin(theta) * std::sin(phi);
+
+					std::fprintf(file, "v %f %f %f\nvt %f %f\nvn %f %f %f\n", x, y, z,
+						static_cast<float>(segment) / segments, static_cast<float>(ring) / rings, x, y, z);
+				}
+			}
+
+			// Every vertex has the same index for all its attributes.
+			for (uint32_t ring = 0; ring < rings; ring++)
+			{
+				for (uint32_t segment = 0; segment < segments; segment++)
+				{
+					const uint32_t a = ring * (segments + 1) + segment + 1;
+					const uint32_t b = a + segments + 1;
+					std::fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, a + 1, a + 1, a + 1);
+					std::fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a + 1, a + 1, a + 1, b, b, b, b + 1, b + 1, b + 1);
+				}
+			}
+
+			std::fclose(file);
+		}
+	}
+}
+
+#endif /* PHM_BENCHMARK_H */
@@ -0,0 +1,147 @@
+#include "pch.h"
+
+#include "phm_benchmark.h"
+
+#include "phm_spatialIndex.h"
+#include "phm_camera.h"
+
+#include <random>
+#include <vector>
+
+// Measures insert, refit and query throughput of the spatial index on a scene of 100k entities scattered through a cube.
+// The frustum query is compared with the linear SIMD cull over every bounding sphere it replaced.
+
+namespace
+{
+	constexpr uint32_t ENTITY_COUNT = 100'000;
+	constexpr uint32_t QUERY_COUNT = 10'000;
+	constexpr float SCENE_EXTENT = 500.0f;
+	constexpr uint32_t REPETITIONS = 5;
+
+	struct Object
+	{
+		phm::ecs::EntityId entity{};
+		glm::vec3 center{};
+		float halfSize = 0.0f;
+
+		inline phm::AABB box() const { return { center - glm::vec3(halfSize), center + glm::vec3(halfSize) }; };
+		inline phm::BoundingSphere sphere() const { return { center, halfSize * 1.7320508f }; };
+	};
+
+	void updateAll(phm::ecs::SpatialIndex& index, const std::vector<Object>& objects)
+	{
+		index.beginUpdate();
+		for (const Object& object : objects)
+			index.update(object.entity, object.box(), object.sphere());
+		index.endUpdate();
+	}
+
+	void printThroughput(const char* name, double milliseconds, uint32_t count)
+	{
+		std::printf("%-48s %10.3f ms %8.2f M/s\n", name, milliseconds, count / (milliseconds * 1000.0));
+	}
+}
+
+int main()
+{
+	std::mt19937 random{ 42 };
+	std::uniform_real_distribution<float> position{ -SCENE_EXTENT, SCENE_EXTENT };
+	std::uniform_real_distribution<float> size{ 0.5f, 3.0f };
+	std::uniform_real_distribution<float> unit{ -1.0f, 1.0f };
+
+	std::vector<Object> objects(ENTITY_COUNT);
+	for (uint32_t i = 0; i < ENTITY_COUNT; i++)
+		objects[i] = { phm::ecs::EntityId{ i, 0 }, glm::vec3{ position(random), position(random), position(random) }, size(random) };
+
+	std::printf("Spatial index over %u entities, best of %u\n", ENTITY_COUNT, REPETITIONS);
+
+	phm::ecs::SpatialIndex index{};
+	const double insertMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			index.clear();
+			updateAll(index, objects);
+		});
+	printThroughput("Insert", insertMilliseconds, ENTITY_COUNT);
+	std::printf("%-48s %10d\n", "Tree height", index.getHeight());
+
+	// Small moves stay inside the fattened boxes of the leaves and leave the tree alone.
+	std::vector<Object> moved = objects;
+	const double refitMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			for (uint32_t i = 0; i < ENTITY_COUNT; i++)
+				moved[i].center = objects[i].center + glm::vec3{ unit(random), unit(random), unit(random) } * (phm::ecs::SpatialIndex::AABB_MARGIN * 0.5f);
+			updateAll(index, moved);
+		});
+	printThroughput("Refit, every entity moves inside its margin", refitMilliseconds, ENTITY_COUNT);
+
+	// A tenth of the entities move far enough to be reinserted.
+	const double reinsertMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			for (uint32_t i = 0; i < ENTITY_COUNT; i += 10)
+				moved[i].center += glm::vec3{ unit(random), unit(random), unit(random) } * 5.0f;
+			updateAll(index, moved);
+		});
+	printThroughput("Refit, a tenth of the entities reinserted", reinsertMilliseconds, ENTITY_COUNT);
+
+	// Frustum query from the center of the scene against the linear cull of every sphere.
+	phm::Camera camera{};
+	camera.setPerspectiveProjection(glm::radians(50.0f), 16.0f / 9.0f, 0.1f, SCENE_EXTENT);
+	camera.setViewDirection(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f });
+	const phm::Frustum frustum = phm::Frustum::fromMatrix(camera.getProjection() * camera.getView());
+
+	phm::SphereBoundsSoA spheres{};
+	for (const Object& object : moved)
+		spheres.push_back(object.sphere());
+	std::vector<uint8_t> visible(ENTITY_COUNT);
+
+	uint32_t linearVisible = 0;
+	const double linearMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			linearVisible = phm::cullSpheres(frustum, spheres, visible.data());
+		});
+
+	std::vector<phm::ecs::EntityId> result{};
+	const double frustumMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			result.clear();
+			index.queryFrustum(frustum, result);
+		});
+
+	std::printf("\nFrustum query, %u of %u visible\n", static_cast<uint32_t>(result.size()), linearVisible);
+	phm::benchmark::report("Linear cull of every sphere", linearMilliseconds);
+	phm::benchmark::report("Spatial index", frustumMilliseconds, linearMilliseconds);
+
+	std::vector<glm::vec3> points(QUERY_COUNT);
+	std::vector<glm::vec3> directions(QUERY_COUNT);
+	for (uint32_t i = 0; i < QUERY_COUNT; i++)
+	{
+		points[i] = glm::vec3{ position(random), position(random), position(random) };
+		directions[i] = glm::normalize(glm::vec3{ unit(random), unit(random), unit(random) } + glm::vec3{ 0.0f, 0.0f, 0.001f });
+	}
+
+	std::printf("\n%u queries\n", QUERY_COUNT);
+
+	uint32_t sphereHits = 0;
+	const double sphereMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			sphereHits = 0;
+			for (const glm::vec3& point : points)
+				index.querySphere(point, 10.0f, [&](phm::ecs::EntityId) { sphereHits++; });
+		});
+	printThroughput("Sphere, radius 10", sphereMilliseconds, QUERY_COUNT);
+
+	uint32_t rayHits = 0;
+	const double rayMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			rayHits = 0;
+			for (uint32_t i = 0; i < QUERY_COUNT; i++)
+			{
+				if (!index.raycast(phm::Ray{ points[i], directions[i] }, SCENE_EXTENT).isNull())
+					rayHits++;
+			}
+		});
+	printThroughput("Ray, length 500", rayMilliseconds, QUERY_COUNT);
+	std::printf("%-48s %10u\n%-48s %10u\n", "Sphere query hits", sphereHits, "Ray hits", rayHits);
+
+	return 0;
+}
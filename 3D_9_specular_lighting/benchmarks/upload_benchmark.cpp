@@ -0,0 +1,141 @@
+#include "pch.h"
+
+#include "phm_benchmark.h"
+
+#include "phm_window.h"
+#include "phm_device.h"
+#include "phm_buffer.h"
+#include "phm_model.h"
+#include "phm_uploadBatcher.h"
+#include "phm_geometryPool.h"
+#include "phm_swapchain.h"
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// Loads the geometry of 500 models onto the GPU in three ways:
+// the previous path, a staging buffer per vertex and index buffer copied with Device::copyBuffer, which idles the queue after every copy,
+// the same buffers uploaded through the UploadBatcher, and constructing the models, which sub-allocates them from the GeometryPool.
+// The mesh is parsed once up front, only the uploads are measured.
+
+namespace
+{
+	constexpr uint32_t MODEL_COUNT = 500;
+	constexpr uint32_t REPETITIONS = 3;
+
+	struct DedicatedBuffers
+	{
+		std::unique_ptr<phm::Buffer> vertexBuffer{};
+		std::unique_ptr<phm::Buffer> indexBuffer{};
+	};
+
+	std::unique_ptr<phm::Buffer> createDeviceLocal(phm::Device& device, VkDeviceSize instanceSize, uint32_t instanceCount, VkBufferUsageFlags usage)
+	{
+		return std::make_unique<phm::Buffer>(
+			device,
+			instanceSize,
+			instanceCount,
+			usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			);
+	}
+
+	// What Model::createVertexBuffers and createIndexBuffers used to do for every buffer.
+	std::unique_ptr<phm::Buffer> uploadWithCopyBuffer(phm::Device& device, const void* data, VkDeviceSize instanceSize, uint32_t instanceCount, VkBufferUsageFlags usage)
+	{
+		phm::Buffer stagingBuffer{
+			device,
+			instanceSize,
+			instanceCount,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		};
+		stagingBuffer.map();
+		stagingBuffer.writeToBuffer(const_cast<void*>(data));
+
+		auto buffer = createDeviceLocal(device, instanceSize, instanceCount, usage);
+		device.copyBuffer(stagingBuffer.getBuffer(), buffer->getBuffer(), instanceSize * instanceCount);
+		return buffer;
+	}
+
+	// Releases the geometry freed by the previous repetition, and grows the pool if the models didn't fit.
+	void recycleGeometry(phm::Device& device)
+	{
+		vkDeviceWaitIdle(device.device());
+		for (int i = 0; i <= phm::Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+			device.getGeometryPool().update();
+	}
+}
+
+int main()
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "phm_upload_benchmark.obj").string();
+	// Just below Model::MESHLET_MIN_TRIANGLES, so constructing the models doesn't build meshlets on top of the upload.
+	phm::benchmark::writeSphereObj(path, 24, 40);
+
+	phm::Model::Builder builder{};
+	builder.loadModel(path);
+	std::filesystem::remove(path);
+
+	const uint32_t vertexCount = static_cast<uint32_t>(builder.vertices.size());
+	const uint32_t indexCount = static_cast<uint32_t>(builder.indices.size());
+
+	phm::Window window{ 800, 600, "Upload benchmark" };
+	phm::Device device{ window };
+
+	std::printf("Uploading %u models of %u vertices and %u indices, best of %u\n", MODEL_COUNT, vertexCount, indexCount, REPETITIONS);
+
+	const double copyBufferMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			std::vector<DedicatedBuffers> models(MODEL_COUNT);
+			for (DedicatedBuffers& model : models)
+			{
+				model.vertexBuffer = uploadWithCopyBuffer(device, builder.vertices.data(), sizeof(phm::Model::Vertex), vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+				model.indexBuffer = uploadWithCopyBuffer(device, builder.indices.data(), sizeof(uint32_t), indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+			}
+		});
+
+	const double batchedMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			phm::UploadBatcher& batcher = device.getUploadBatcher();
+
+			std::vector<DedicatedBuffers> models(MODEL_COUNT);
+			for (DedicatedBuffers& model : models)
+			{
+				model.vertexBuffer = createDeviceLocal(device, sizeof(phm::Model::Vertex), vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+				model.indexBuffer = createDeviceLocal(device, sizeof(uint32_t), indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+				batcher.upload(model.vertexBuffer->getBuffer(), builder.vertices.data(), model.vertexBuffer->getBufferSize());
+				batcher.upload(model.indexBuffer->getBuffer(), builder.indices.data(), model.indexBuffer->getBufferSize());
+			}
+			batcher.waitIdle();
+		});
+
+	// Freeing and recycling the geometry of the previous repetition isn't measured.
+	// The first repetition grows the geometry pool to fit all models, so it is left out.
+	std::vector<std::unique_ptr<phm::Model>> models{};
+	double modelMilliseconds = std::numeric_limits<double>::max();
+	for (uint32_t repetition = 0; repetition <= REPETITIONS; repetition++)
+	{
+		models.clear();
+		recycleGeometry(device);
+
+		const double milliseconds = phm::benchmark::measure(1, [&]()
+			{
+				for (uint32_t i = 0; i < MODEL_COUNT; i++)
+					models.push_back(std::make_unique<phm::Model>(device, builder));
+				device.getUploadBatcher().waitIdle();
+			});
+
+		if (repetition > 0)
+			modelMilliseconds = std::min(modelMilliseconds, milliseconds);
+	}
+	models.clear();
+	recycleGeometry(device);
+
+	phm::benchmark::report("Staging buffer and copyBuffer per buffer", copyBufferMilliseconds);
+	phm::benchmark::report("UploadBatcher, a buffer per model", batchedMilliseconds, copyBufferMilliseconds);
+	phm::benchmark::report("Model construction, GeometryPool", modelMilliseconds, copyBufferMilliseconds);
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+#include "pch.h"
+
+#include "phm_benchmark.h"
+
+#include "phm_model.h"
+#include "phm_vertexDeduplicator.h"
+#include "phm_utils.h"
+
+#include <glm/gtc/constants.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+// Deduplicates the face corners of a multi-million triangle mesh, once with the VertexDeduplicator
+// and once with the std::unordered_map that Model::Builder::loadModel used before, including its count() and twice operator[] per corner.
+// The corners are what the OBJ loader assembles from the face indices of a file, a sphere in which every vertex is shared by six corners.
+// They are generated in memory, so only the deduplication is measured and not the parsing.
+
+namespace std
+{
+	template<>
+	struct hash<phm::Model::Vertex>
+	{
+		size_t operator()(const phm::Model::Vertex& vertex) const
+		{
+			size_t seed = 0;
+			phm::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+			return seed;
+		}
+	};
+}
+
+namespace
+{
+	constexpr uint32_t RINGS = 1000;
+	constexpr uint32_t SEGMENTS = 1500;
+	constexpr uint32_t REPETITIONS = 3;
+
+	struct Mesh
+	{
+		std::vector<phm::Model::Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+	};
+}
+
+int main()
+{
+	// The distinct vertices of the sphere, and the vertex of every corner of its triangles.
+	std::vector<phm::Model::Vertex> sphere{};
+	sphere.reserve((RINGS + 1) * (SEGMENTS + 1));
+	for (uint32_t ring = 0; ring <= RINGS; ring++)
+	{
+		const float theta = glm::pi<float>() * ring / RINGS;
+		for (uint32_t segment = 0; segment <= SEGMENTS; segment++)
+		{
+			const float phi = 2.0f * glm::pi<float>() * segment / SEGMENTS;
+			phm::Model::Vertex vertex{};
+			vertex.position = glm::vec3{ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+			vertex.normal = vertex.position;
+			vertex.color = glm::vec3{ 1.0f };
+			vertex.uv = glm::vec2{ static_cast<float>(segment) / SEGMENTS, static_cast<float>(ring) / RINGS };
+			sphere.push_back(vertex);
+		}
+	}
+
+	std::vector<uint32_t> corners{};
+	corners.reserve(6ull * RINGS * SEGMENTS);
+	for (uint32_t ring = 0; ring < RINGS; ring++)
+	{
+		for (uint32_t segment = 0; segment < SEGMENTS; segment++)
+		{
+			const uint32_t a = ring * (SEGMENTS + 1) + segment;
+			const uint32_t b = a + SEGMENTS + 1;
+			corners.insert(corners.end(), { a, b, a + 1, a + 1, b, b + 1 });
+		}
+	}
+
+	std::printf("Deduplicating %u corners of %u triangles into %u vertices, best of %u\n",
+		static_cast<uint32_t>(corners.size()), static_cast<uint32_t>(corners.size() / 3), static_cast<uint32_t>(sphere.size()), REPETITIONS);
+
+	Mesh mapMesh{};
+	const double mapMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			mapMesh = Mesh{};
+			std::unordered_map<phm::Model::Vertex, uint32_t> uniqueVertices{};
+			for (uint32_t corner : corners)
+			{
+				const phm::Model::Vertex& vertex = sphere[corner];
+				if (uniqueVertices.count(vertex) == 0)
+				{
+					uniqueVertices[vertex] = static_cast<uint32_t>(mapMesh.vertices.size());
+					mapMesh.vertices.push_back(vertex);
+				}
+				mapMesh.indices.push_back(uniqueVertices[vertex]);
+			}
+		});
+
+	Mesh flatMesh{};
+	const double flatMilliseconds = phm::benchmark::measure(REPETITIONS, [&]()
+		{
+			flatMesh = Mesh{};
+			flatMesh.indices.reserve(corners.size());
+			phm::VertexDeduplicator deduplicator{ flatMesh.vertices, corners.size() };
+			for (uint32_t corner : corners)
+				flatMesh.indices.push_back(deduplicator.insert(sphere[corner]));
+		});
+
+	if (mapMesh.vertices != flatMesh.vertices || mapMesh.indices != flatMesh.indices)
+	{
+		std::printf("The deduplicated meshes differ!\n");
+		return 1;
+	}
+
+	phm::benchmark::report("std::unordered_map", mapMilliseconds);
+	phm::benchmark::report("VertexDeduplicator", flatMilliseconds, mapMilliseconds);
+
+	return 0;
+}
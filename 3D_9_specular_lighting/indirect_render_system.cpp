@@ -0,0 +1,466 @@
+#include "pch.h"
+
+#include "indirect_render_system.h"
+#include "phm_swapchain.h"
+#include "phm_geometryPool.h"
+#include "phm_view.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <stdexcept>
+#include <array>
+#include <algorithm>
+#include <cstring>
+
+
+namespace phm
+{
+	static_assert(sizeof(VkDrawIndexedIndirectCommand) == 5 * sizeof(uint32_t), "The culling shader writes tightly packed draw commands");
+
+	IndirectRenderSystem::IndirectRenderSystem(Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
+		: device_(device), frames_(Swapchain::MAX_FRAMES_IN_FLIGHT)
+	{
+		// The layouts have to match the std430 structs of cull.comp
+		static_assert(sizeof(ObjectData) == 128 && sizeof(MeshData) == 96, "Object or mesh data out of sync with the culling shader");
+		static_assert(sizeof(CullPushConstants) == 128, "Push constants exceed the guaranteed minimum size");
+
+		cullSetLayout_ = DescriptorSetLayout::Builder(device_)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		descriptorPool_ = DescriptorPool::Builder(device_)
+			.setMaxSets(Swapchain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * Swapchain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		createPipelineLayouts(globalSetLayout);
+		createPipelines(renderPass);
+	}
+
+	IndirectRenderSystem::~IndirectRenderSystem()
+	{
+		vkDestroyPipelineLayout(device_.device(), pipelineLayout_, nullptr);
+		vkDestroyPipelineLayout(device_.device(), cullPipelineLayout_, nullptr);
+	}
+
+	bool IndirectRenderSystem::canDrawIndirect(const Model& model)
+	{
+		const std::vector<Model::Lod>& lods = model.getLods();
+		if (!model.isPooled() || lods.empty() || lods.size() > MeshSimplifier::MAX_LODS)
+			return false;
+
+		return std::all_of(lods.begin(), lods.end(), [](const Model::Lod& lod) { return lod.subMeshCount == 1; });
+	}
+
+	void IndirectRenderSystem::createPipelineLayouts(VkDescriptorSetLayout globalSetLayout)
+	{
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCreateInfo.setLayoutCount = 1;
+		pipelineLayoutCreateInfo.pSetLayouts = &globalSetLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+		pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+
+		if (vkCreatePipelineLayout(device_.device(), &pipelineLayoutCreateInfo, nullptr, &pipelineLayout_) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline layout. ");
+		}
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(CullPushConstants);
+
+		VkDescriptorSetLayout cullSetLayout = cullSetLayout_->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo cullLayoutCreateInfo{};
+		cullLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		cullLayoutCreateInfo.setLayoutCount = 1;
+		cullLayoutCreateInfo.pSetLayouts = &cullSetLayout;
+		cullLayoutCreateInfo.pushConstantRangeCount = 1;
+		cullLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(device_.device(), &cullLayoutCreateInfo, nullptr, &cullPipelineLayout_) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create culling pipeline layout. ");
+		}
+	}
+
+	void IndirectRenderSystem::createPipelines(VkRenderPass renderPass)
+	{
+		for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++)
+		{
+			const VertexFormat vertexFormat = static_cast<VertexFormat>(format);
+
+			phm::PipelineConfigInfo pipelineConfig{};
+			Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+			pipelineConfig.renderPass = renderPass;
+			pipelineConfig.pipelineLayout = pipelineLayout_;
+			pipelineConfig.bindingDescriptions = Model::getBindingDescriptions(vertexFormat);
+			pipelineConfig.attributeDescriptions = Model::getAttributeDescriptions(vertexFormat);
+
+			// The object data starts with the same matrices as the instance data of the SimpleRenderSystem, only the stride differs.
+			pipelineConfig.bindingDescriptions.push_back({ 1, sizeof(ObjectData), VK_VERTEX_INPUT_RATE_INSTANCE });
+			for (uint32_t column = 0; column < 4; column++)
+			{
+				pipelineConfig.attributeDescriptions.push_back({ 4 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+					static_cast<uint32_t>(offsetof(ObjectData, modelMatrix) + column * sizeof(glm::vec4)) });
+			}
+			for (uint32_t column = 0; column < 3; column++)
+			{
+				pipelineConfig.attributeDescriptions.push_back({ 8 + column, 1, VK_FORMAT_R32G32B32_SFLOAT,
+					static_cast<uint32_t>(offsetof(ObjectData, normalMatrix) + column * sizeof(glm::vec3)) });
+			}
+
+			// OCTAHEDRAL_NORMALS, a VkBool32
+			const VkBool32 octahedralNormals = vertexFormat == VertexFormat::Quantized;
+			pipelineConfig.vertexSpecializationEntries.push_back({ 0, 0, sizeof(VkBool32) });
+			pipelineConfig.vertexSpecializationData.resize(sizeof(VkBool32));
+			std::memcpy(pipelineConfig.vertexSpecializationData.data(), &octahedralNormals, sizeof(VkBool32));
+
+			pipelines_[format] = std::make_unique<Pipeline>(
+				device_,
+				"shaders/simple_shader.vert.spv",
+				"shaders/simple_shader.frag.spv",
+				pipelineConfig
+				);
+		}
+
+		cullPipeline_ = std::make_unique<ComputePipeline>(device_, "shaders/cull.comp.spv", cullPipelineLayout_);
+	}
+
+	void IndirectRenderSystem::cull(const FrameInfo& frameInfo, ecs::ArchetypeStorage& storage, std::vector<ecs::EntityId>& fallbackEntities)
+	{
+		FrameResources& frame = frames_[frameInfo.frameIndex];
+
+		// The fence of this frame index has been waited on, so the counts of its last culling pass are final
+		// and the object buffer can be written.
+		if (frame.culled)
+		{
+			const auto* counts = static_cast<const uint32_t*>(frame.countBuffer->getMappedMemory());
+			lastTriangles_ = counts[0];
+			lastVisibleObjects_ = 0;
+			for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++)
+				lastVisibleObjects_ += counts[1 + format];
+		}
+
+		const glm::mat4& projection = frameInfo.camera.getProjection();
+		const Frustum frustum = Frustum::fromMatrix(projection * frameInfo.camera.getView());
+
+		meshes_.clear();
+		meshLookup_.clear();
+		frame.objectCount = 0;
+		frame.objectCounts.fill(0);
+		frame.uploadedObjects = 0;
+
+		// The view size includes the entities without a model and those left to the fallback, so it is an upper bound.
+		const ecs::View<Transform, ecs::ModelComponent> view{ storage };
+		reserveObjects(frame, view.size());
+
+		auto* objects = static_cast<ObjectData*>(frame.objectBuffer->getMappedMemory());
+		const Model* lastModel = nullptr;
+		uint32_t lastMeshIndex = 0;
+
+		view.eachChunk([&](uint32_t count, const ecs::EntityId* entities, const Transform* transforms, ecs::ModelComponent* components)
+			{
+				for (uint32_t i = 0; i < count; i++)
+				{
+					const Model* model = components[i].model.get();
+					if (model == nullptr)
+						continue;
+
+					if (!canDrawIndirect(*model))
+					{
+						const BoundingSphere sphere = model->getBoundingSphere().transformed(transforms[i].mat4());
+						if (frustum.intersectsSphere(sphere.center, sphere.radius))
+							fallbackEntities.push_back(entities[i]);
+						continue;
+					}
+
+					// Neighbouring entities usually share their model.
+					if (model != lastModel)
+					{
+						lastModel = model;
+						lastMeshIndex = getMeshIndex(*model);
+					}
+
+					const uint32_t slot = frame.objectCount++;
+					frame.objectCounts[static_cast<uint32_t>(model->getVertexFormat())]++;
+
+					const ObjectState state{ entities[i], model, transforms[i].getVersion(), lastMeshIndex };
+					if (slot < frame.objectStates.size())
+					{
+						ObjectState& written = frame.objectStates[slot];
+						if (written.entity == state.entity && written.model == state.model &&
+							written.transformVersion == state.transformVersion && written.meshIndex == state.meshIndex)
+							continue;
+
+						written = state;
+					}
+					else
+					{
+						frame.objectStates.push_back(state);
+					}
+
+					// Quantized positions are mapped back into model space by the model matrix.
+					const glm::mat4 transformMatrix = transforms[i].mat4();
+					const BoundingSphere sphere = model->getBoundingSphere().transformed(transformMatrix);
+
+					ObjectData& object = objects[slot];
+					object.modelMatrix = transformMatrix;
+					if (model->getVertexFormat() != VertexFormat::Full)
+						object.modelMatrix = object.modelMatrix * model->getDequantizationMatrix();
+					object.sphere = glm::vec4{ sphere.center, sphere.radius };
+					object.normalMatrix = transforms[i].normalMatrix();
+					object.meshIndex = lastMeshIndex;
+					frame.uploadedObjects++;
+				}
+			});
+
+		frame.culled = frame.objectCount > 0;
+		if (!frame.culled)
+			return;
+
+		prepareBuffers(frame);
+
+		std::memcpy(frame.meshBuffer->getMappedMemory(), meshes_.data(), meshes_.size() * sizeof(MeshData));
+		std::memset(frame.countBuffer->getMappedMemory(), 0, (1 + VERTEX_FORMAT_COUNT) * sizeof(uint32_t));
+
+		// Without the count, every command of a region is drawn, so the ones the shader doesn't write have to be empty.
+		const uint32_t maxDrawCount = *std::max_element(frame.objectCounts.begin(), frame.objectCounts.end());
+		frame.useDrawCount = device_.getDrawIndexedIndirectCount() != nullptr && maxDrawCount <= device_.properties.limits.maxDrawIndirectCount;
+
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+		if (!frame.useDrawCount)
+		{
+			vkCmdFillBuffer(commandBuffer, frame.drawBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+			VkMemoryBarrier clearBarrier{};
+			clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			clearBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0,
+				1, &clearBarrier,
+				0, nullptr,
+				0, nullptr);
+		}
+
+		CullPushConstants push{};
+		for (int p = 0; p < Frustum::PlaneCount; p++)
+			push.frustumPlanes[p] = frustum.planes[p];
+		push.cameraPosition = glm::vec4{ glm::vec3{ frameInfo.camera.getInverseView()[3] }, projection[1][1] };
+		push.objectCount = frame.objectCount;
+		push.maxDraws = frame.objectBuffer->getInstanceCount();
+		push.perspective = projection[3][3] == 0.0f;
+		push.lodThreshold = Model::LOD_ERROR_THRESHOLD;
+
+		cullPipeline_->bind(commandBuffer);
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			cullPipelineLayout_,
+			0,
+			1,
+			&frame.descriptorSet,
+			0,
+			nullptr
+		);
+		vkCmdPushConstants(commandBuffer, cullPipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push);
+		vkCmdDispatch(commandBuffer, (push.objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+		// The draws read the commands and counts written by the shader
+		VkMemoryBarrier cullBarrier{};
+		cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0,
+			1, &cullBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	void IndirectRenderSystem::renderObjects(const FrameInfo& frameInfo, const VkDescriptorSet* const descriptorSet, RenderStats& stats)
+	{
+		const FrameResources& frame = frames_[frameInfo.frameIndex];
+		stats.uploadedObjects += frame.uploadedObjects;
+		if (!frame.culled)
+			return;
+
+		stats.visibleObjects += lastVisibleObjects_;
+		stats.triangles += lastTriangles_;
+
+		vkCmdBindDescriptorSets(
+			frameInfo.commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout_,
+			0,
+			1,
+			descriptorSet,
+			0,
+			nullptr
+		);
+
+		VkBuffer objectBuffer = frame.objectBuffer->getBuffer();
+		VkDeviceSize objectOffset = 0;
+		vkCmdBindVertexBuffers(frameInfo.commandBuffer, 1, 1, &objectBuffer, &objectOffset);
+
+		const VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+		const uint32_t maxDrawCount = device_.properties.limits.maxDrawIndirectCount;
+		GeometryPool& geometryPool = device_.getGeometryPool();
+
+		for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++)
+		{
+			const uint32_t objectCount = frame.objectCounts[format];
+			if (objectCount == 0)
+				continue;
+
+			pipelines_[format]->bind(frameInfo.commandBuffer);
+			geometryPool.bind(frameInfo.commandBuffer, static_cast<VertexFormat>(format));
+
+			const VkDeviceSize regionOffset = format * frame.objectBuffer->getInstanceCount() * stride;
+			if (frame.useDrawCount)
+			{
+				device_.getDrawIndexedIndirectCount()(frameInfo.commandBuffer, frame.drawBuffer->getBuffer(), regionOffset,
+					frame.countBuffer->getBuffer(), (1 + format) * sizeof(uint32_t), objectCount, static_cast<uint32_t>(stride));
+				stats.drawCalls++;
+				continue;
+			}
+
+			// The culled commands were cleared and draw nothing.
+			for (uint32_t first = 0; first < objectCount; first += maxDrawCount)
+			{
+				vkCmdDrawIndexedIndirect(frameInfo.commandBuffer, frame.drawBuffer->getBuffer(), regionOffset + first * stride,
+					std::min(maxDrawCount, objectCount - first), static_cast<uint32_t>(stride));
+				stats.drawCalls++;
+			}
+		}
+	}
+
+	uint32_t IndirectRenderSystem::getMeshIndex(const Model& model)
+	{
+		auto [it, inserted] = meshLookup_.try_emplace(&model, static_cast<uint32_t>(meshes_.size()));
+		if (!inserted)
+			return it->second;
+
+		// The pool offsets change when the pool is compacted, so the meshes are written every frame.
+		MeshData& mesh = meshes_.emplace_back();
+		const std::vector<Model::Lod>& lods = model.getLods();
+		const Model::SubMesh* subMeshes = model.getSubMeshes().data();
+		for (size_t i = 0; i < lods.size(); i++)
+		{
+			const Model::SubMesh& subMesh = subMeshes[lods[i].firstSubMesh];
+			mesh.lods[i].indexCount = subMesh.indexCount;
+			mesh.lods[i].firstIndex = model.getBaseIndex() + subMesh.firstIndex;
+			mesh.lods[i].vertexOffset = model.getBaseVertex() + subMesh.vertexOffset;
+			mesh.lods[i].error = lods[i].error;
+		}
+		mesh.lodCount = static_cast<uint32_t>(lods.size());
+		mesh.format = static_cast<uint32_t>(model.getVertexFormat());
+		mesh.radius = model.getBoundingSphere().radius;
+
+		return it->second;
+	}
+
+	void IndirectRenderSystem::reserveObjects(FrameResources& frame, uint32_t objectCount)
+	{
+		if (frame.objectBuffer && frame.objectBuffer->getInstanceCount() >= objectCount)
+			return;
+
+		// Grow geometrically so a slowly growing scene does not reallocate every frame.
+		uint32_t capacity = frame.objectBuffer ? frame.objectBuffer->getInstanceCount() : 256;
+		while (capacity < objectCount)
+			capacity *= 2;
+
+		frame.objectBuffer = std::make_unique<Buffer>(
+			device_,
+			sizeof(ObjectData),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			);
+		frame.objectBuffer->map();
+		// Nothing of the new buffer has been written yet.
+		frame.objectStates.clear();
+
+		// One region of commands per vertex format, each large enough for every object.
+		frame.drawBuffer = std::make_unique<Buffer>(
+			device_,
+			sizeof(VkDrawIndexedIndirectCommand),
+			capacity * VERTEX_FORMAT_COUNT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			);
+		frame.descriptorsDirty = true;
+	}
+
+	void IndirectRenderSystem::prepareBuffers(FrameResources& frame)
+	{
+		if (!frame.meshBuffer || frame.meshBuffer->getInstanceCount() < meshes_.size())
+		{
+			uint32_t capacity = frame.meshBuffer ? frame.meshBuffer->getInstanceCount() : 64;
+			while (capacity < meshes_.size())
+				capacity *= 2;
+
+			frame.meshBuffer = std::make_unique<Buffer>(
+				device_,
+				sizeof(MeshData),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				);
+			frame.meshBuffer->map();
+			frame.descriptorsDirty = true;
+		}
+
+		if (!frame.countBuffer)
+		{
+			frame.countBuffer = std::make_unique<Buffer>(
+				device_,
+				sizeof(uint32_t),
+				1 + VERTEX_FORMAT_COUNT,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				);
+			frame.countBuffer->map();
+			frame.descriptorsDirty = true;
+		}
+
+		if (!frame.descriptorsDirty)
+			return;
+		frame.descriptorsDirty = false;
+
+		auto objectInfo = frame.objectBuffer->descriptorInfo();
+		auto meshInfo = frame.meshBuffer->descriptorInfo();
+		auto drawInfo = frame.drawBuffer->descriptorInfo();
+		auto countInfo = frame.countBuffer->descriptorInfo();
+
+		DescriptorWriter writer(*cullSetLayout_, *descriptorPool_);
+		writer.writeBuffer(0, &objectInfo)
+			.writeBuffer(1, &meshInfo)
+			.writeBuffer(2, &drawInfo)
+			.writeBuffer(3, &countInfo);
+
+		if (frame.descriptorSet == VK_NULL_HANDLE)
+		{
+			if (!writer.build(frame.descriptorSet))
+				throw std::runtime_error("Failed to allocate the culling descriptor set");
+		}
+		else
+		{
+			writer.overwrite(frame.descriptorSet);
+		}
+	}
+}
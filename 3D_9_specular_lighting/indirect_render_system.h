@@ -0,0 +1,160 @@
+#ifndef PHM_INDIRECT_RENDER_SYSTEM_H
+#define PHM_INDIRECT_RENDER_SYSTEM_H
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "phm_camera.h"
+#include "phm_pipeline.h"
+#include "phm_frame_info.h"
+#include "phm_descriptor.h"
+
+#include "phm_entity.h"
+#include "phm_archetype.h"
+#include "phm_model.h"
+#include "phm_meshSimplifier.h"
+
+
+namespace phm
+{
+	// Renders objects that have a normal model without walking them on the CPU during the render pass.
+	// The transform, bounds and mesh of every object are written to a storage buffer, a compute shader frustum culls them,
+	// selects their level of detail and writes an indirect draw command per visible object, and a single indirect draw per vertex format draws them all.
+	// Only pooled models whose levels of detail are a single draw each qualify, the rest is left to the SimpleRenderSystem.
+	class IndirectRenderSystem
+	{
+
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+		IndirectRenderSystem(Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		~IndirectRenderSystem();
+
+		IndirectRenderSystem(const IndirectRenderSystem&) = delete;
+		IndirectRenderSystem& operator=(const IndirectRenderSystem&) = delete;
+
+		// Drawing one object per indirect command needs multiDrawIndirect and drawIndirectFirstInstance.
+		static bool isSupported(const Device& device) { return device.supportsMultiDrawIndirect(); };
+		// True if the model can be drawn by an indirect command: its geometry is in the geometry pool and every level of detail is one sub-mesh.
+		static bool canDrawIndirect(const Model& model);
+
+		// Writes the object data of the entities with a ModelComponent whose transform or model changed since the buffers of the frame were last used,
+		// and records the culling dispatch, which has to happen outside of the render pass.
+		// Entities whose model can't be drawn indirectly are frustum culled on the CPU, the visible ones are appended to fallbackEntities.
+		void cull(const FrameInfo& frameInfo, ecs::ArchetypeStorage& storage, std::vector<ecs::EntityId>& fallbackEntities);
+
+		// Draws the objects that survived the culling. Adds the draw calls to the stats, along with the visible objects and the triangles
+		// counted by the GPU, which are read back MAX_FRAMES_IN_FLIGHT frames late.
+		void renderObjects(const FrameInfo& frameInfo, const VkDescriptorSet* const descriptorSet, RenderStats& stats);
+
+	private:
+		// Per object data, read by the culling shader and, through vertex binding 1, by the vertex shader.
+		// The draw commands select the object with their first instance.
+		struct ObjectData
+		{
+			glm::mat4 modelMatrix{ 1.0f };
+			// World space bounding sphere, w is the radius
+			glm::vec4 sphere{ 0.0f };
+			glm::mat3 normalMatrix{ 1.0f };
+			uint32_t meshIndex = 0;
+			uint32_t padding[2]{};
+		};
+
+		// What an object slot of the object buffer was last written with.
+		struct ObjectState
+		{
+			ecs::EntityId entity{};
+			const Model* model = nullptr;
+			uint32_t transformVersion = 0;
+			uint32_t meshIndex = 0;
+		};
+
+		struct MeshLod
+		{
+			uint32_t indexCount = 0;
+			uint32_t firstIndex = 0;
+			int32_t vertexOffset = 0;
+			float error = 0.0f;
+		};
+
+		// The levels of detail of a model, with their offsets in the geometry pool.
+		struct MeshData
+		{
+			MeshLod lods[MeshSimplifier::MAX_LODS]{};
+			uint32_t lodCount = 0;
+			uint32_t format = 0;
+			// Radius of the model space bounding sphere, relates the world radius to the model scale for the level of detail selection.
+			float radius = 0.0f;
+			uint32_t padding = 0;
+		};
+
+		struct CullPushConstants
+		{
+			glm::vec4 frustumPlanes[Frustum::PlaneCount];
+			// w is the vertical projection scale
+			glm::vec4 cameraPosition;
+			uint32_t objectCount;
+			uint32_t maxDraws;
+			uint32_t perspective;
+			float lodThreshold;
+		};
+
+		// Buffers of one frame in flight. The fence of the frame has been waited on before they are written again.
+		struct FrameResources
+		{
+			// Persistently mapped, a slot is only rewritten if its entity, model or transform changed.
+			std::unique_ptr<Buffer> objectBuffer{};
+			std::vector<ObjectState> objectStates{};
+			std::unique_ptr<Buffer> meshBuffer{};
+			// VERTEX_FORMAT_COUNT regions of objectBuffer capacity commands each
+			std::unique_ptr<Buffer> drawBuffer{};
+			// Triangles, then the number of commands in each region. Host visible, so the counts can be read back.
+			std::unique_ptr<Buffer> countBuffer{};
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			bool descriptorsDirty = true;
+
+			uint32_t objectCount = 0;
+			// Objects of each vertex format, the upper bound of the draw counts.
+			std::array<uint32_t, VERTEX_FORMAT_COUNT> objectCounts{};
+			// Objects whose data had to be written this frame.
+			uint32_t uploadedObjects = 0;
+			// Read the draw counts from the count buffer, otherwise the draw buffer is cleared and the empty commands are drawn as well.
+			bool useDrawCount = false;
+			bool culled = false;
+		};
+
+		Device& device_;
+
+		// One pipeline per vertex format, the same shaders as the SimpleRenderSystem with the object data as instance data.
+		std::array<std::unique_ptr<Pipeline>, VERTEX_FORMAT_COUNT> pipelines_{};
+		VkPipelineLayout pipelineLayout_;
+
+		std::unique_ptr<ComputePipeline> cullPipeline_;
+		VkPipelineLayout cullPipelineLayout_;
+		std::unique_ptr<DescriptorSetLayout> cullSetLayout_;
+		std::unique_ptr<DescriptorPool> descriptorPool_;
+
+		std::vector<FrameResources> frames_;
+
+		// Scratch storage reused between frames to avoid reallocating every frame.
+		std::vector<MeshData> meshes_{};
+		std::unordered_map<const Model*, uint32_t> meshLookup_{};
+
+		// Counted by the culling shader of the last frame that used the buffers of the current frame index.
+		uint32_t lastVisibleObjects_ = 0;
+		uint32_t lastTriangles_ = 0;
+
+		void createPipelineLayouts(VkDescriptorSetLayout globalSetLayout);
+		void createPipelines(VkRenderPass renderPass);
+
+		uint32_t getMeshIndex(const Model& model);
+		// Grows the object and draw buffers of the frame to fit objectCount objects. Growing starts over with an empty object buffer.
+		void reserveObjects(FrameResources& frame, uint32_t objectCount);
+		// Grows the mesh buffer to fit the gathered meshes, and points the descriptor set at the current buffers.
+		void prepareBuffers(FrameResources& frame);
+	};
+}
+
+#endif /* PHM_INDIRECT_RENDER_SYSTEM_H */
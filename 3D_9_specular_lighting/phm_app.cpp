@@ -12,6 +12,7 @@
 
 #include "phm_pointLightComponent.h"
 #include "phm_functionComponent.h"
+#include "phm_geometryPool.h"
 
 
 #define GLM_FORCE_RADIANS
@@ -33,6 +34,10 @@ namespace phm
 	Application::Application() 
 	{
 		loadObjects();
+
+		[[maybe_unused]] const AssetCache::Statistics assets = assetCache_.getStatistics();
+		DebugPrint("Models: " << assets.residentModels << " loaded for " << assets.requests << " requests, "
+			<< assets.residentBytes / 1024 << " KiB resident, " << assets.savedBytes / 1024 << " KiB saved by sharing");
 	}
 
 	Application::~Application()
@@ -43,15 +48,15 @@ namespace phm
 	{
 		// Set up the camera/viewer
 		Camera camera{};
-		auto& viewerEntity = entityManager_.addEntity();
+		auto viewerEntity = entityManager_.addEntity();
 		
 		entityManager_.setCamera(&camera);
-		entityManager_.setViewerEntity(&viewerEntity);
+		entityManager_.setViewerEntity(viewerEntity);
 		
-		viewerEntity.transform.translation.z = -2.3f;
-		viewerEntity.transform.translation.y = -0.5f;
+		viewerEntity.transform().setTranslation({ 0.0f, -0.5f, -2.3f });
 
 		Time time;
+		float statsTimer = 0.0f;
 
 		//float currRot = 0;
 
@@ -60,6 +65,9 @@ namespace phm
 			glfwPollEvents();
 
 			time.updateTime();
+
+			// Releases the geometry of models destroyed a few frames ago, and grows the pool if it ran full.
+			device_.getGeometryPool().update();
 			
 			// BeginFrame returns a nullptr if the swapchain needs to be recreated. 
 			// This skips the frame draw call, if that's the case.
@@ -75,12 +83,25 @@ namespace phm
 
 				// Update
 				entityManager_.update(frameInfo, renderer_, window_.getGLFWWindow());
+				entityManager_.prepareRender(frameInfo);
 				
 				// Render
 				renderer_.beginSwapChainRenderPass(commandBuffer);
 				entityManager_.render(frameInfo, renderer_);
 				renderer_.endSwapChainRenderPass(commandBuffer);
 				renderer_.endFrame();
+
+				// Remove the entities destroyed during the frame
+				entityManager_.refresh();
+
+				statsTimer += time.deltaTime();
+				if (statsTimer >= 1.0f)
+				{
+					[[maybe_unused]] const RenderStats& stats = entityManager_.getRenderStats();
+					DebugPrint("Visible: " << stats.visibleObjects << ", culled: " << stats.culledObjects << ", draw calls: " << stats.drawCalls << ", triangles: " << stats.triangles << ", uploaded: " << stats.uploadedObjects << ", light sprites: " << stats.lightSprites << ", uploaded lights: " << stats.uploadedLights
+						<< ", CPU: " << stats.cpuMilliseconds << " ms (" << (entityManager_.isGpuDriven() ? "GPU driven" : "CPU culled") << ")");
+					statsTimer = 0.0f;
+				}
 			}
 		}
 
@@ -91,22 +112,22 @@ namespace phm
 	void Application::loadObjects()
 	{
 		{
-			auto& e = entityManager_.addEntity();
-			e.addComponent<ecs::ModelComponent>(device_, "models/smooth_vase.obj");
-			e.transform.translation = { -0.8f, 0.0f, 0.0f };
-			e.transform.scale = glm::vec3(3);
+			auto e = entityManager_.addEntity();
+			e.addComponent<ecs::ModelComponent>(assetCache_, "models/smooth_vase.obj");
+			e.transform().setTranslation({ -0.8f, 0.0f, 0.0f });
+			e.transform().setScale(glm::vec3(3));
 		}
 		{
-			auto& e = entityManager_.addEntity();
-			e.addComponent<ecs::ModelComponent>(device_, "models/flat_vase.obj");
-			e.transform.translation = { 0.8f, 0.0f, 0.0f };
-			e.transform.scale = glm::vec3(3);
+			auto e = entityManager_.addEntity();
+			e.addComponent<ecs::ModelComponent>(assetCache_, "models/flat_vase.obj");
+			e.transform().setTranslation({ 0.8f, 0.0f, 0.0f });
+			e.transform().setScale(glm::vec3(3));
 		}
 		{
-			auto& e = entityManager_.addEntity();
-			e.addComponent<ecs::ModelComponent>(device_, "models/quad.obj");
-			e.transform.translation = { 0.0f, 0.0f, 0.0f };
-			e.transform.scale = glm::vec3{ 3.0f, 1.0f, 3.0f };
+			auto e = entityManager_.addEntity();
+			e.addComponent<ecs::ModelComponent>(assetCache_, "models/quad.obj");
+			e.transform().setTranslation({ 0.0f, 0.0f, 0.0f });
+			e.transform().setScale(glm::vec3{ 3.0f, 1.0f, 3.0f });
 		}
 		{
 			std::function rotateFunc = FUNCTIONCOMPONENTLAMDA(1, const int, lightOffset)
@@ -114,40 +135,40 @@ namespace phm
 				constexpr int numberOfLights = 4;
 				constexpr float rotationSpeed = 0;
 
-				e.transform.translation = 
+				e.transform().setTranslation(
 				{
 					2.0f * cos(glm::two_pi<float>() / numberOfLights * lightOffset[0] + std::fmod(Time::elapsedTime() * rotationSpeed, glm::two_pi<float>())),
-					e.transform.translation.y, 
+					e.transform().getTranslation().y, 
 					2.0f * sin(glm::two_pi<float>() / numberOfLights * lightOffset[0] + std::fmod(Time::elapsedTime() * rotationSpeed, glm::two_pi<float>()))
-				};
+				});
 			};
 			
 			// Add the lights
 			{
-				auto& e = entityManager_.addEntity();
+				auto e = entityManager_.addEntity();
 				e.addComponent<ecs::PointlightComponent>(glm::vec3(1.0f, 0.0f, 0.0f), 0.7f, 0.01f);
-				e.transform.translation = { 1.3f, -1.0f, 1.3f };
+				e.transform().setTranslation({ 1.3f, -1.0f, 1.3f });
 				const std::array<const int, 1> arr = { 0 };
 				e.addComponent<ecs::FunctionComponent<1>>(rotateFunc, arr);
 			}
 			{
-				auto& e = entityManager_.addEntity();
+				auto e = entityManager_.addEntity();
 				e.addComponent<ecs::PointlightComponent>(glm::vec3(0.0f, 0.0f, 1.0f), 0.4f, 0.1f);
-				e.transform.translation = { -1.3f, -1.0f, -1.3f };
+				e.transform().setTranslation({ -1.3f, -1.0f, -1.3f });
 				const std::array<const int, 1> arr = { 1 };
 				e.addComponent<ecs::FunctionComponent<1>>(rotateFunc, arr);
 			}
 			{
-				auto& e = entityManager_.addEntity();
+				auto e = entityManager_.addEntity();
 				e.addComponent<ecs::PointlightComponent>(glm::vec3(0.0f, 1.0f, 0.0f), 0.1f, 0.05f);
-				e.transform.translation = { -1.3f, -1.0f, -1.3f };
+				e.transform().setTranslation({ -1.3f, -1.0f, -1.3f });
 				const std::array<const int, 1> arr = { 2 };
 				e.addComponent<ecs::FunctionComponent<1>>(rotateFunc, arr);
 			}
 			{
-				auto& e = entityManager_.addEntity();
+				auto e = entityManager_.addEntity();
 				e.addComponent<ecs::PointlightComponent>(glm::vec3(1.0f, 1.0f, 1.0f), 0.34f, 0.05f);
-				e.transform.translation = { -1.3f, -1.0f, -1.3f };
+				e.transform().setTranslation({ -1.3f, -1.0f, -1.3f });
 				const std::array<const int, 1> arr = { 3 };
 				e.addComponent<ecs::FunctionComponent<1>>(rotateFunc, arr);
 			}
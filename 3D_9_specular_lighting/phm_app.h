@@ -9,6 +9,8 @@
 #include "phm_descriptor.h"
 
 #include "phm_manager.h"
+#include "phm_jobSystem.h"
+#include "phm_assetCache.h"
 
 
 namespace phm
@@ -32,12 +34,15 @@ namespace phm
 		Window window_{ WIDTH, HEIGHT, "3D" };
 		Device device_{ window_ };
 		Renderer renderer_{ window_, device_ };
+		JobSystem jobSystem_{};
+		AssetCache assetCache_{ device_, &jobSystem_, VertexFormat::Quantized };
 
 		std::unique_ptr<DescriptorPool> globalPool_{ DescriptorPool::Builder(device_)
 			.setMaxSets(Swapchain::MAX_FRAMES_IN_FLIGHT)
 			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, Swapchain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * Swapchain::MAX_FRAMES_IN_FLIGHT)
 			.build() };
-		ecs::Manager entityManager_{ device_, renderer_.getSwapChainRenderPass(), globalPool_.get() };
+		ecs::Manager entityManager_{ device_, renderer_.getSwapChainRenderPass(), globalPool_.get(), jobSystem_ };
 		//std::vector<Object> objects_; // TEMP
 		
 		void loadObjects(); // TEMP
@@ -0,0 +1,316 @@
+#include "pch.h"
+
+#include "phm_archetype.h"
+
+namespace phm
+{
+	namespace ecs
+	{
+		// Chunks are cache line aligned, so the first element of every column starts on its own cache line boundary.
+		constexpr size_t CHUNK_ALIGNMENT = 64;
+
+		static size_t alignUp(size_t value, size_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		Archetype::Archetype(const ComponentBitSet& signature)
+			: signature_(signature)
+		{
+			columnLookup_.fill(-1);
+
+			size_t rowBytes = sizeof(EntityId);
+			size_t alignmentSlack = 0;
+			for (ComponentTypeID id = 0; id < maxComponents; id++)
+			{
+				if (!signature_[id])
+					continue;
+
+				const ComponentInfo& info = getComponentInfo(id);
+				assert(info.size > 0 && "Component type has not been registered");
+
+				columnLookup_[id] = static_cast<int8_t>(componentTypes_.size());
+				componentTypes_.push_back(id);
+				columnSizes_.push_back(info.size);
+
+				rowBytes += info.size;
+				alignmentSlack += info.alignment;
+			}
+
+			// Fit as many rows as possible in a chunk, but always at least one.
+			chunkCapacity_ = static_cast<uint32_t>(std::max<size_t>(1, (CHUNK_SIZE - alignmentSlack) / rowBytes));
+
+			// Layout: [EntityId x capacity][Column 0 x capacity][Column 1 x capacity]...
+			size_t offset = sizeof(EntityId) * chunkCapacity_;
+			for (ComponentTypeID id : componentTypes_)
+			{
+				const ComponentInfo& info = getComponentInfo(id);
+				offset = alignUp(offset, info.alignment);
+				columnOffsets_.push_back(offset);
+				offset += info.size * chunkCapacity_;
+			}
+			chunkBytes_ = alignUp(offset, CHUNK_ALIGNMENT);
+		}
+
+		Archetype::~Archetype()
+		{
+			for (size_t column = 0; column < componentTypes_.size(); column++)
+			{
+				const ComponentInfo& info = getComponentInfo(componentTypes_[column]);
+				for (uint32_t row = 0; row < size_; row++)
+					info.destroy(getSlot(row, column));
+			}
+
+			for (std::byte* chunk : chunks_)
+				::operator delete(chunk, std::align_val_t{ CHUNK_ALIGNMENT });
+		}
+
+		void* Archetype::getComponent(uint32_t row, ComponentTypeID id) const
+		{
+			assert(signature_[id] && "Archetype does not contain the component");
+			return getSlot(row, columnLookup_[id]);
+		}
+
+		EntityId Archetype::getEntity(uint32_t row) const
+		{
+			return getEntities(row / chunkCapacity_)[row % chunkCapacity_];
+		}
+
+		uint32_t Archetype::pushRow(EntityId entity)
+		{
+			if (size_ == chunks_.size() * chunkCapacity_)
+				chunks_.push_back(static_cast<std::byte*>(::operator new(chunkBytes_, std::align_val_t{ CHUNK_ALIGNMENT })));
+
+			const uint32_t row = size_++;
+			getEntities(row / chunkCapacity_)[row % chunkCapacity_] = entity;
+			return row;
+		}
+
+		EntityId Archetype::eraseRow(uint32_t row)
+		{
+			assert(row < size_ && "Row out of range");
+
+			for (size_t column = 0; column < componentTypes_.size(); column++)
+				getComponentInfo(componentTypes_[column]).destroy(getSlot(row, column));
+
+			return fillHole(row);
+		}
+
+		EntityId Archetype::moveRow(uint32_t row, Archetype& dst, uint32_t dstRow)
+		{
+			assert(row < size_ && "Row out of range");
+
+			for (size_t column = 0; column < componentTypes_.size(); column++)
+			{
+				const ComponentTypeID id = componentTypes_[column];
+				const ComponentInfo& info = getComponentInfo(id);
+				void* src = getSlot(row, column);
+
+				if (dst.hasComponent(id))
+					info.moveConstruct(dst.getComponent(dstRow, id), src);
+				info.destroy(src);
+			}
+
+			return fillHole(row);
+		}
+
+		void* Archetype::getSlot(uint32_t row, size_t column) const
+		{
+			const uint32_t chunk = row / chunkCapacity_;
+			const uint32_t index = row % chunkCapacity_;
+			return chunks_[chunk] + columnOffsets_[column] + index * columnSizes_[column];
+		}
+
+		// Expects the components of the row to already be destroyed.
+		EntityId Archetype::fillHole(uint32_t row)
+		{
+			const uint32_t last = size_ - 1;
+			EntityId moved{};
+
+			if (row != last)
+			{
+				for (size_t column = 0; column < componentTypes_.size(); column++)
+				{
+					const ComponentInfo& info = getComponentInfo(componentTypes_[column]);
+					void* src = getSlot(last, column);
+					info.moveConstruct(getSlot(row, column), src);
+					info.destroy(src);
+				}
+
+				moved = getEntity(last);
+				getEntities(row / chunkCapacity_)[row % chunkCapacity_] = moved;
+			}
+
+			size_--;
+
+			// Release the last chunk once the chunk before it is empty too. Keeping one empty chunk around
+			// stops an entity that passes through the archetype from allocating and freeing a chunk every time.
+			if (chunks_.size() > 1 && size_ <= (chunks_.size() - 2) * chunkCapacity_)
+			{
+				::operator delete(chunks_.back(), std::align_val_t{ CHUNK_ALIGNMENT });
+				chunks_.pop_back();
+			}
+
+			return moved;
+		}
+
+
+		ArchetypeStorage::ArchetypeStorage()
+		{
+			emptyArchetype_ = &getArchetype(ComponentBitSet{});
+		}
+
+		EntityId ArchetypeStorage::createEntity()
+		{
+			assert(!structureLocked_ && "Cannot create entities while the structure is locked");
+
+			EntityId id{};
+			if (!freeIndices_.empty())
+			{
+				id.index = freeIndices_.back();
+				freeIndices_.pop_back();
+			}
+			else
+			{
+				id.index = static_cast<uint32_t>(records_.size());
+				records_.emplace_back();
+			}
+
+			EntityRecord& record = records_[id.index];
+			id.generation = record.generation;
+			record.archetype = emptyArchetype_;
+			record.row = emptyArchetype_->pushRow(id);
+			record.pendingDestroy = false;
+
+			return id;
+		}
+
+		void ArchetypeStorage::destroyEntity(EntityId entity)
+		{
+			assert(isValid(entity) && "Invalid entity handle");
+
+			EntityRecord& record = records_[entity.index];
+			if (record.pendingDestroy)
+				return;
+
+			record.pendingDestroy = true;
+			pendingDestroy_.push_back(entity);
+		}
+
+		void ArchetypeStorage::flushDestroyed()
+		{
+			assert(!structureLocked_ && "Cannot remove entities while the structure is locked");
+
+			for (EntityId entity : pendingDestroy_)
+			{
+				EntityRecord& record = records_[entity.index];
+
+				const EntityId moved = record.archetype->eraseRow(record.row);
+				if (!moved.isNull())
+					records_[moved.index].row = record.row;
+
+				// Invalidate all handles to the slot before recycling it
+				record.archetype = nullptr;
+				record.pendingDestroy = false;
+				record.generation++;
+				freeIndices_.push_back(entity.index);
+			}
+
+			pendingDestroy_.clear();
+		}
+
+		void* ArchetypeStorage::addComponent(EntityId entity, ComponentTypeID id)
+		{
+			assert(!structureLocked_ && "Cannot add components while the structure is locked");
+			assert(isValid(entity) && "Invalid entity handle");
+
+			EntityRecord& record = records_[entity.index];
+			Archetype* src = record.archetype;
+			Archetype*& dst = src->addEdges[id];
+			if (dst == nullptr)
+			{
+				ComponentBitSet signature = src->getSignature();
+				signature.set(id);
+				dst = &getArchetype(signature);
+				dst->removeEdges[id] = src;
+			}
+
+			const uint32_t dstRow = dst->pushRow(entity);
+			const EntityId moved = src->moveRow(record.row, *dst, dstRow);
+			if (!moved.isNull())
+				records_[moved.index].row = record.row;
+
+			record.archetype = dst;
+			record.row = dstRow;
+
+			return dst->getComponent(dstRow, id);
+		}
+
+		void ArchetypeStorage::removeComponent(EntityId entity, ComponentTypeID id)
+		{
+			assert(!structureLocked_ && "Cannot remove components while the structure is locked");
+			assert(isValid(entity) && "Invalid entity handle");
+
+			EntityRecord& record = records_[entity.index];
+			Archetype* src = record.archetype;
+			assert(src->hasComponent(id) && "Entity does not have the component");
+
+			Archetype*& dst = src->removeEdges[id];
+			if (dst == nullptr)
+			{
+				ComponentBitSet signature = src->getSignature();
+				signature.reset(id);
+				dst = &getArchetype(signature);
+				dst->addEdges[id] = src;
+			}
+
+			const uint32_t dstRow = dst->pushRow(entity);
+			const EntityId moved = src->moveRow(record.row, *dst, dstRow);
+			if (!moved.isNull())
+				records_[moved.index].row = record.row;
+
+			record.archetype = dst;
+			record.row = dstRow;
+		}
+
+		Archetype& ArchetypeStorage::getArchetype(const ComponentBitSet& signature)
+		{
+			auto it = archetypes_.find(signature);
+			if (it != archetypes_.end())
+				return *it->second;
+
+			auto archetype = std::make_unique<Archetype>(signature);
+			Archetype* ptr = archetype.get();
+			archetypes_.emplace(signature, std::move(archetype));
+			archetypeList_.push_back(ptr);
+
+			// Add the new archetype to every cached query it satisfies
+			std::lock_guard<std::mutex> lock(queryMutex_);
+			for (auto& [querySignature, matches] : queries_)
+			{
+				if ((signature & querySignature) == querySignature)
+					matches.push_back(ptr);
+			}
+
+			return *ptr;
+		}
+
+		const std::vector<Archetype*>& ArchetypeStorage::getMatchingArchetypes(const ComponentBitSet& signature)
+		{
+			std::lock_guard<std::mutex> lock(queryMutex_);
+
+			auto it = queries_.find(signature);
+			if (it != queries_.end())
+				return it->second;
+
+			std::vector<Archetype*> matches;
+			for (Archetype* archetype : archetypeList_)
+			{
+				if ((archetype->getSignature() & signature) == signature)
+					matches.push_back(archetype);
+			}
+
+			return queries_.emplace(signature, std::move(matches)).first->second;
+		}
+	}
+}
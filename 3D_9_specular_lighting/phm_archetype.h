@@ -0,0 +1,184 @@
+#ifndef PHM_ARCHETYPE_H
+#define PHM_ARCHETYPE_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "phm_component.h"
+
+namespace phm
+{
+	namespace ecs
+	{
+		// An archetype stores every entity that has exactly the same set of components.
+		// The components are kept in fixed size chunks, where each chunk holds one tightly packed array per component type 
+		// (structure of arrays), so iterating a component type touches contiguous memory only.
+		class Archetype
+		{
+		public:
+			// Target size of a single chunk in bytes.
+			static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+			Archetype(const ComponentBitSet& signature);
+			~Archetype();
+
+			Archetype(const Archetype&) = delete;
+			Archetype& operator=(const Archetype&) = delete;
+
+			[[nodiscard]] inline const ComponentBitSet& getSignature() const { return signature_; };
+			[[nodiscard]] inline const std::vector<ComponentTypeID>& getComponentTypes() const { return componentTypes_; };
+			[[nodiscard]] inline bool hasComponent(ComponentTypeID id) const { return signature_[id]; };
+			[[nodiscard]] inline uint32_t size() const { return size_; };
+
+			[[nodiscard]] inline uint32_t getChunkCapacity() const { return chunkCapacity_; };
+			[[nodiscard]] inline size_t getChunkCount() const { return chunks_.size(); };
+			[[nodiscard]] inline uint32_t getChunkSize(size_t chunkIndex) const
+			{
+				const uint32_t first = static_cast<uint32_t>(chunkIndex) * chunkCapacity_;
+				return std::min(chunkCapacity_, size_ - first);
+			};
+
+			// Returns the start of the array of T in the given chunk.
+			template<typename T>
+			[[nodiscard]] inline T* getColumn(size_t chunkIndex) const
+			{
+				return static_cast<T*>(getColumn(chunkIndex, getComponentTypeID<T>()));
+			};
+			[[nodiscard]] inline void* getColumn(size_t chunkIndex, ComponentTypeID id) const
+			{
+				assert(signature_[id] && "Archetype does not contain the component");
+				return chunks_[chunkIndex] + columnOffsets_[columnLookup_[id]];
+			};
+			[[nodiscard]] inline EntityId* getEntities(size_t chunkIndex) const
+			{
+				return reinterpret_cast<EntityId*>(chunks_[chunkIndex]);
+			};
+
+			[[nodiscard]] void* getComponent(uint32_t row, ComponentTypeID id) const;
+			[[nodiscard]] EntityId getEntity(uint32_t row) const;
+
+			// Appends a row for the entity. The component slots of the row are left uninitialized.
+			uint32_t pushRow(EntityId entity);
+			// Destroys the components of a row and fills the hole with the last row.
+			// Returns the entity that was moved into the row, or a null id if the last row was removed.
+			EntityId eraseRow(uint32_t row);
+			// Moves the components shared with the destination archetype into dstRow, destroys the rest 
+			// and fills the hole with the last row. Returns the entity moved into the row, or a null id.
+			EntityId moveRow(uint32_t row, Archetype& dst, uint32_t dstRow);
+
+			// Cached transitions to the archetype with one component added/removed.
+			std::array<Archetype*, maxComponents> addEdges{};
+			std::array<Archetype*, maxComponents> removeEdges{};
+
+		private:
+			ComponentBitSet signature_;
+			std::vector<ComponentTypeID> componentTypes_;
+			std::array<int8_t, maxComponents> columnLookup_;
+			std::vector<size_t> columnOffsets_;
+			std::vector<size_t> columnSizes_;
+
+			size_t chunkBytes_ = 0;
+			uint32_t chunkCapacity_ = 0;
+			uint32_t size_ = 0;
+			std::vector<std::byte*> chunks_;
+
+			[[nodiscard]] void* getSlot(uint32_t row, size_t column) const;
+			EntityId fillHole(uint32_t row);
+		};
+
+
+		// Owns all archetypes of a scene and moves entities between them when their set of components change.
+		// Entities are addressed by generational ids. Destroyed slots are recycled through a free list, 
+		// so creating and destroying entities is O(1) regardless of the number of entities in the scene.
+		class ArchetypeStorage
+		{
+		public:
+			ArchetypeStorage();
+
+			ArchetypeStorage(const ArchetypeStorage&) = delete;
+			ArchetypeStorage& operator=(const ArchetypeStorage&) = delete;
+
+			// Creates an entity without any components.
+			[[nodiscard]] EntityId createEntity();
+			// Queues the entity for destruction. It is removed on the next call to flushDestroyed.
+			void destroyEntity(EntityId entity);
+			// Removes all entities queued for destruction and recycles their slots.
+			void flushDestroyed();
+
+			[[nodiscard]] inline bool isValid(EntityId entity) const
+			{
+				return entity.index < records_.size() && records_[entity.index].generation == entity.generation 
+					&& records_[entity.index].archetype != nullptr;
+			};
+			[[nodiscard]] inline bool isPendingDestroy(EntityId entity) const
+			{
+				assert(isValid(entity) && "Invalid entity handle");
+				return records_[entity.index].pendingDestroy;
+			};
+			[[nodiscard]] inline uint32_t getEntityCount() const 
+			{ 
+				return static_cast<uint32_t>(records_.size() - freeIndices_.size()); 
+			};
+
+			[[nodiscard]] inline bool hasComponent(EntityId entity, ComponentTypeID id) const
+			{
+				assert(isValid(entity) && "Invalid entity handle");
+				return records_[entity.index].archetype->hasComponent(id);
+			};
+			[[nodiscard]] inline void* getComponent(EntityId entity, ComponentTypeID id) const
+			{
+				assert(isValid(entity) && "Invalid entity handle");
+				const EntityRecord& record = records_[entity.index];
+				return record.archetype->getComponent(record.row, id);
+			};
+
+			// Moves the entity to the archetype that also contains the component and returns the uninitialized component slot.
+			[[nodiscard]] void* addComponent(EntityId entity, ComponentTypeID id);
+			// Destroys the component and moves the entity to the archetype without it.
+			void removeComponent(EntityId entity, ComponentTypeID id);
+
+			// While locked, entities and components can't be added or removed, as it would invalidate the chunks being iterated.
+			inline void setStructureLocked(bool locked) { structureLocked_ = locked; };
+			[[nodiscard]] inline bool isStructureLocked() const { return structureLocked_; };
+
+			[[nodiscard]] Archetype& getArchetype(const ComponentBitSet& signature);
+			[[nodiscard]] inline const std::vector<Archetype*>& getArchetypes() const { return archetypeList_; };
+
+			// Returns all archetypes that contain at least the components in the signature.
+			// The list is cached and kept up to date as new archetypes are created, so the reference stays valid.
+			// Safe to call from multiple systems at once.
+			[[nodiscard]] const std::vector<Archetype*>& getMatchingArchetypes(const ComponentBitSet& signature);
+
+		private:
+			// Location of an entity's components
+			struct EntityRecord
+			{
+				Archetype* archetype = nullptr;
+				uint32_t row = 0;
+				uint32_t generation = 0;
+				bool pendingDestroy = false;
+			};
+
+			std::vector<EntityRecord> records_;
+			std::vector<uint32_t> freeIndices_;
+			std::vector<EntityId> pendingDestroy_;
+
+			std::unordered_map<ComponentBitSet, std::unique_ptr<Archetype>> archetypes_;
+			// The archetypes in creation order. Gives a stable iteration order.
+			std::vector<Archetype*> archetypeList_;
+			// Cached query results, keyed by the required components.
+			std::unordered_map<ComponentBitSet, std::vector<Archetype*>> queries_;
+			std::mutex queryMutex_;
+			Archetype* emptyArchetype_;
+
+			bool structureLocked_ = false;
+		};
+	}
+}
+
+#endif /* PHM_ARCHETYPE_H */
@@ -0,0 +1,105 @@
+#include "pch.h"
+
+#include "phm_assetCache.h"
+
+#include <filesystem>
+
+namespace phm
+{
+	AssetCache::AssetCache(Device& device, JobSystem* jobSystem, VertexFormat vertexFormat)
+		: device_(device), jobSystem_(jobSystem), vertexFormat_(vertexFormat)
+	{
+	}
+
+	std::shared_ptr<Model> AssetCache::getModel(std::string_view filePath)
+	{
+		// Different spellings of the same path share an entry
+		const std::string key = std::filesystem::path(filePath).lexically_normal().generic_string();
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		statistics_.requests++;
+
+		Entry& entry = entries_[key];
+		if (std::shared_ptr<Model> model = entry.model.lock())
+		{
+			statistics_.hits++;
+			return model;
+		}
+
+		if (entry.loading.valid())
+		{
+			statistics_.coalescedLoads++;
+			std::shared_future<std::shared_ptr<Model>> loading = entry.loading;
+
+			lock.unlock();
+			return loading.get();
+		}
+
+		evictExpired();
+
+		// Load without holding the lock, so other files can be requested in the meantime
+		std::promise<std::shared_ptr<Model>> promise;
+		entries_[key].loading = promise.get_future().share();
+		statistics_.loads++;
+		lock.unlock();
+
+		std::shared_ptr<Model> model{};
+		try
+		{
+			model = Model::createModelFromFile(device_, filePath, jobSystem_, vertexFormat_);
+		}
+		catch (...)
+		{
+			// Waiting requests get the exception too, the next request tries again
+			promise.set_exception(std::current_exception());
+
+			lock.lock();
+			entries_.erase(key);
+			throw;
+		}
+
+		lock.lock();
+		Entry& loaded = entries_[key];
+		loaded.model = model;
+		loaded.size = model->getMemorySize();
+		loaded.loading = {};
+		lock.unlock();
+
+		promise.set_value(model);
+		return model;
+	}
+
+	AssetCache::Statistics AssetCache::getStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		Statistics statistics = statistics_;
+		statistics.residentModels = 0;
+		statistics.residentBytes = 0;
+		statistics.savedBytes = 0;
+
+		for (const auto& [key, entry] : entries_)
+		{
+			const long users = entry.model.use_count();
+			if (users == 0)
+				continue;
+
+			statistics.residentModels++;
+			statistics.residentBytes += entry.size;
+			statistics.savedBytes += entry.size * static_cast<uint64_t>(users - 1);
+		}
+
+		return statistics;
+	}
+
+	void AssetCache::evictExpired()
+	{
+		for (auto it = entries_.begin(); it != entries_.end();)
+		{
+			if (it->second.model.expired() && !it->second.loading.valid())
+				it = entries_.erase(it);
+			else
+				++it;
+		}
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef PHM_ASSET_CACHE_H
+#define PHM_ASSET_CACHE_H
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "phm_model.h"
+#include "phm_jobSystem.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Shares loaded models between everyone who asks for the same file.
+	/// Models are held weakly, so a model is released as soon as the last user drops it and is loaded again on the next request.
+	/// Safe to call from multiple threads. Concurrent requests for a file that is still loading wait for that load instead of starting another one.
+	/// </summary>
+	class AssetCache
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t requests = 0;
+			uint32_t hits = 0;
+			// Requests that waited for a load already in flight
+			uint32_t coalescedLoads = 0;
+			uint32_t loads = 0;
+
+			uint32_t residentModels = 0;
+			// Vertex and index buffer memory of the resident models
+			uint64_t residentBytes = 0;
+			// Memory every user of a model would have needed on top of that with its own copy
+			uint64_t savedBytes = 0;
+		};
+
+		// Every model of the cache is created with the given vertex format.
+		AssetCache(Device& device, JobSystem* jobSystem = nullptr, VertexFormat vertexFormat = VertexFormat::Full);
+
+		AssetCache(const AssetCache&) = delete;
+		AssetCache& operator=(const AssetCache&) = delete;
+
+		/// <summary>
+		/// Returns the model of the file, loading it if it isn't resident. Throws if the file can't be loaded.
+		/// </summary>
+		std::shared_ptr<Model> getModel(std::string_view filePath);
+
+		Statistics getStatistics();
+
+	private:
+		struct Entry
+		{
+			std::weak_ptr<Model> model{};
+			uint64_t size = 0;
+
+			// Valid while the model is being loaded
+			std::shared_future<std::shared_ptr<Model>> loading{};
+		};
+
+		Device& device_;
+		JobSystem* jobSystem_;
+		VertexFormat vertexFormat_;
+
+		std::unordered_map<std::string, Entry> entries_{};
+		Statistics statistics_{};
+		std::mutex mutex_;
+
+		// Drops the entries of released models
+		void evictExpired();
+	};
+}
+
+#endif /* PHM_ASSET_CACHE_H */
@@ -0,0 +1,232 @@
+#include "pch.h"
+
+#include "phm_bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PHM_BOUNDS_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace phm
+{
+	AABB AABB::transformed(const glm::mat4& matrix) const
+	{
+		// Transform the center and project the extents onto the new axes.
+		const glm::vec3 c = glm::vec3(matrix * glm::vec4(center(), 1.0f));
+		const glm::vec3 e = extents();
+
+		glm::vec3 newExtents{ 0.0f };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			newExtents += glm::abs(glm::vec3(matrix[axis])) * e[axis];
+		}
+
+		return { c - newExtents, c + newExtents };
+	}
+
+	AABB AABB::fromPoints(const glm::vec3* points, size_t count, size_t stride)
+	{
+		if (count == 0)
+			return {};
+
+		const auto* bytes = reinterpret_cast<const unsigned char*>(points);
+
+		AABB box{ points[0], points[0] };
+		for (size_t i = 1; i < count; i++)
+		{
+			const glm::vec3& p = *reinterpret_cast<const glm::vec3*>(bytes + i * stride);
+			box.min = glm::min(box.min, p);
+			box.max = glm::max(box.max, p);
+		}
+		return box;
+	}
+
+	bool AABB::intersectsSphere(const glm::vec3& center, float radius) const
+	{
+		const glm::vec3 closest = glm::clamp(center, min, max);
+		const glm::vec3 offset = closest - center;
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	bool AABB::intersectsRay(const Ray& ray, const glm::vec3& inverseDirection, float maxDistance, float& entryDistance) const
+	{
+		const glm::vec3 t1 = (min - ray.origin) * inverseDirection;
+		const glm::vec3 t2 = (max - ray.origin) * inverseDirection;
+		const glm::vec3 tNear = glm::min(t1, t2);
+		const glm::vec3 tFar = glm::max(t1, t2);
+
+		const float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		if (entry > exit)
+			return false;
+
+		entryDistance = entry;
+		return true;
+	}
+
+	BoundingSphere BoundingSphere::transformed(const glm::mat4& matrix) const
+	{
+		// Rotation does not change the sphere, the longest basis vector bounds the radius.
+		const float maxScaleSquared = std::max(
+			glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+			std::max(glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1])), glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]))));
+
+		return { glm::vec3(matrix * glm::vec4(center, 1.0f)), radius * std::sqrt(maxScaleSquared) };
+	}
+
+	bool BoundingSphere::intersectsRay(const Ray& ray, float maxDistance, float& hitDistance) const
+	{
+		const glm::vec3 offset = ray.origin - center;
+		const float b = glm::dot(offset, ray.direction);
+		const float c = glm::dot(offset, offset) - radius * radius;
+
+		// Outside of the sphere and pointing away from it.
+		if (c > 0.0f && b > 0.0f)
+			return false;
+
+		const float discriminant = b * b - c;
+		if (discriminant < 0.0f)
+			return false;
+
+		const float distance = std::max(-b - std::sqrt(discriminant), 0.0f);
+		if (distance > maxDistance)
+			return false;
+
+		hitDistance = distance;
+		return true;
+	}
+
+	Frustum Frustum::fromMatrix(const glm::mat4& m)
+	{
+		// Rows of the matrix (glm is column major).
+		auto row = [&m](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+		Frustum frustum{};
+		frustum.planes[Left] = row(3) + row(0);
+		frustum.planes[Right] = row(3) - row(0);
+		frustum.planes[Bottom] = row(3) + row(1);
+		frustum.planes[Top] = row(3) - row(1);
+		frustum.planes[Near] = row(2); // Depth ranges from zero to one
+		frustum.planes[Far] = row(3) - row(2);
+
+		for (glm::vec4& plane : frustum.planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
+	bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (const glm::vec4& plane : planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	bool Frustum::intersectsAABB(const AABB& box) const
+	{
+		const glm::vec3 center = box.center();
+		const glm::vec3 extents = box.extents();
+
+		for (const glm::vec4& plane : planes)
+		{
+			const float projectedRadius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -projectedRadius)
+				return false;
+		}
+		return true;
+	}
+
+	Containment Frustum::classifyAABB(const AABB& box) const
+	{
+		const glm::vec3 center = box.center();
+		const glm::vec3 extents = box.extents();
+
+		Containment result = Containment::Inside;
+		for (const glm::vec4& plane : planes)
+		{
+			const float projectedRadius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+			const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+
+			if (distance < -projectedRadius)
+				return Containment::Outside;
+			if (distance < projectedRadius)
+				result = Containment::Intersects;
+		}
+		return result;
+	}
+
+	void SphereBoundsSoA::clear()
+	{
+		x.clear();
+		y.clear();
+		z.clear();
+		radius.clear();
+	}
+
+	void SphereBoundsSoA::push_back(const BoundingSphere& sphere)
+	{
+		x.push_back(sphere.center.x);
+		y.push_back(sphere.center.y);
+		z.push_back(sphere.center.z);
+		radius.push_back(sphere.radius);
+	}
+
+	uint32_t cullSpheres(const Frustum& frustum, const SphereBoundsSoA& spheres, uint8_t* visible)
+	{
+		const size_t count = spheres.size();
+		uint32_t visibleCount = 0;
+		size_t i = 0;
+
+#ifdef PHM_BOUNDS_SSE
+		// Test four spheres against one plane at a time.
+		__m128 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount], planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+		for (int p = 0; p < Frustum::PlaneCount; p++)
+		{
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+			const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+			const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+			const __m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(&spheres.radius[i]));
+
+			__m128 inside = _mm_cmpeq_ps(zero, zero);
+			for (int p = 0; p < Frustum::PlaneCount; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], x), planeW[p]);
+				distance = _mm_add_ps(distance, _mm_mul_ps(planeY[p], y));
+				distance = _mm_add_ps(distance, _mm_mul_ps(planeZ[p], z));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			const int mask = _mm_movemask_ps(inside);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+				visibleCount += visible[i + lane];
+			}
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			visible[i] = frustum.intersectsSphere({ spheres.x[i], spheres.y[i], spheres.z[i] }, spheres.radius[i]) ? 1 : 0;
+			visibleCount += visible[i];
+		}
+
+		return visibleCount;
+	}
+}
@@ -0,0 +1,100 @@
+#ifndef PHM_BOUNDS_H
+#define PHM_BOUNDS_H
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace phm
+{
+	struct Ray
+	{
+		glm::vec3 origin{ 0.0f };
+		glm::vec3 direction{ 0.0f, 0.0f, 1.0f }; // Normalized
+	};
+
+	// Axis aligned bounding box
+	struct AABB
+	{
+		glm::vec3 min{ 0.0f };
+		glm::vec3 max{ 0.0f };
+
+		inline glm::vec3 center() const { return (min + max) * 0.5f; };
+		inline glm::vec3 extents() const { return (max - min) * 0.5f; };
+		inline float surfaceArea() const 
+		{ 
+			const glm::vec3 size = max - min;
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		};
+
+		inline bool contains(const AABB& other) const 
+		{ 
+			return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+				max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+		};
+		inline AABB expanded(float margin) const { return { min - glm::vec3(margin), max + glm::vec3(margin) }; };
+
+		static inline AABB merge(const AABB& a, const AABB& b) { return { glm::min(a.min, b.min), glm::max(a.max, b.max) }; };
+
+		bool intersectsSphere(const glm::vec3& center, float radius) const;
+
+		// Slab test. inverseDirection is 1 / ray.direction, so it can be reused between boxes.
+		bool intersectsRay(const Ray& ray, const glm::vec3& inverseDirection, float maxDistance, float& entryDistance) const;
+
+		// Bounding box of this box after applying the transform.
+		AABB transformed(const glm::mat4& matrix) const;
+
+		static AABB fromPoints(const glm::vec3* points, size_t count, size_t stride = sizeof(glm::vec3));
+	};
+
+	struct BoundingSphere
+	{
+		glm::vec3 center{ 0.0f };
+		float radius = 0.0f;
+
+		// Bounding sphere of this sphere after applying the transform.
+		BoundingSphere transformed(const glm::mat4& matrix) const;
+
+		bool intersectsRay(const Ray& ray, float maxDistance, float& hitDistance) const;
+	};
+
+	enum class Containment { Outside, Intersects, Inside };
+
+	// Frustum planes pointing inwards, xyz is the normal and w the distance.
+	struct Frustum
+	{
+		enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+		glm::vec4 planes[PlaneCount]{};
+
+		// Extracts the planes from a projection * view matrix (Vulkan clip space, depth zero to one).
+		static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+		bool intersectsSphere(const glm::vec3& center, float radius) const;
+		bool intersectsAABB(const AABB& box) const;
+		Containment classifyAABB(const AABB& box) const;
+	};
+
+	// Bounding spheres stored as structure of arrays, so they can be tested several at a time.
+	struct SphereBoundsSoA
+	{
+		std::vector<float> x{};
+		std::vector<float> y{};
+		std::vector<float> z{};
+		std::vector<float> radius{};
+
+		inline size_t size() const { return x.size(); };
+
+		void clear();
+		void push_back(const BoundingSphere& sphere);
+	};
+
+	// Writes 1 into visible[i] if sphere i intersects the frustum and 0 otherwise.
+	// Returns the number of visible spheres.
+	uint32_t cullSpheres(const Frustum& frustum, const SphereBoundsSoA& spheres, uint8_t* visible);
+}
+
+#endif /* PHM_BOUNDS_H */
@@ -48,18 +48,25 @@ namespace phm
 	{
 		unmap();
 		vkDestroyBuffer(device_.device(), buffer_, nullptr);
-		vkFreeMemory(device_.device(), memory_, nullptr);
+		device_.freeMemory(memory_);
 	}
 
 	/// <summary>
 	/// Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+	/// Host visible memory blocks are persistently mapped by the allocator, so this only hands out the pointer.
 	/// </summary>
 	/// <param name="size">(Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete</param>
 	/// <param name="offset">(Optional) Byte offset from beginning</param>
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
-		assert(buffer_ && memory_ && "Called map on buffer before create");
-		return vkMapMemory(device_.device(), memory_, offset, size, 0, &mapped_);
+		assert(buffer_ && memory_.isValid() && "Called map on buffer before create");
+		assert((size == VK_WHOLE_SIZE || offset + size <= bufferSize_) && "Mapped range is out of the buffer");
+
+		if (memory_.mapped == nullptr)
+			return VK_ERROR_MEMORY_MAP_FAILED;
+
+		mapped_ = static_cast<char*>(memory_.mapped) + offset;
+		return VK_SUCCESS;
 	}
 
 	/// <summary>
@@ -67,11 +74,7 @@ namespace phm
 	/// </summary>
 	void Buffer::unmap()
 	{
-		if (mapped_)
-		{
-			vkUnmapMemory(device_.device(), memory_);
-			mapped_ = nullptr;
-		}
+		mapped_ = nullptr;
 	}
 
 	/// <summary>
@@ -103,12 +106,7 @@ namespace phm
 	/// <param name="offset">(Optional) Byte offset from beginning</param>
 	VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory_;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
-		return vkFlushMappedMemoryRanges(device_.device(), 1, &mappedRange);
+		return device_.getAllocator().flush(memory_, size == VK_WHOLE_SIZE ? bufferSize_ - offset : size, offset);
 	}
 
 	/// <summary>
@@ -118,12 +116,7 @@ namespace phm
 	/// <param name="offset">(Optional) Byte offset from beginning</param>
 	VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory_;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
-		return vkInvalidateMappedMemoryRanges(device_.device(), 1, &mappedRange);
+		return device_.getAllocator().invalidate(memory_, size == VK_WHOLE_SIZE ? bufferSize_ - offset : size, offset);
 	}
 
 	/// <summary>
@@ -49,7 +49,7 @@ namespace phm
 		Device& device_;
 		void* mapped_ = nullptr;
 		VkBuffer buffer_ = VK_NULL_HANDLE;
-		VkDeviceMemory memory_ = VK_NULL_HANDLE;
+		MemoryAllocation memory_{};
 
 		VkDeviceSize bufferSize_;
 		uint32_t instanceCount_;
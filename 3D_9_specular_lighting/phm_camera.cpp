@@ -16,6 +16,8 @@ namespace phm
 		projectionMatrix_[3][0] = -(right + left) / (right - left);
 		projectionMatrix_[3][1] = -(bottom + top) / (bottom - top);
 		projectionMatrix_[3][2] = -near / (far - near);
+		near_ = near;
+		far_ = far;
 	}
 
 	void Camera::setPerspectiveProjection(float fovy, float aspect, float near, float far) {
@@ -27,6 +29,8 @@ namespace phm
 		projectionMatrix_[2][2] = far / (far - near);
 		projectionMatrix_[2][3] = 1.f;
 		projectionMatrix_[3][2] = -(far * near) / (far - near);
+		near_ = near;
+		far_ = far;
 	}
 
 	void Camera::setViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3 up) {
@@ -23,11 +23,16 @@ namespace phm
 		inline const glm::mat4& getProjection() const { return projectionMatrix_; };
 		inline const glm::mat4& getView() const { return viewMatrix_; };
 		inline const glm::mat4& getInverseView() const { return inverseViewMatrix_; };
+		inline float getNear() const { return near_; };
+		inline float getFar() const { return far_; };
+		inline bool isPerspective() const { return projectionMatrix_[3][3] == 0.0f; };
 
 	private:
 		glm::mat4 projectionMatrix_{ 1.0f };
 		glm::mat4 viewMatrix_{ 1.0f };
 		glm::mat4 inverseViewMatrix_{ 1.0f };
+		float near_ = 0.0f;
+		float far_ = 1.0f;
 	};
 }
 
@@ -4,6 +4,11 @@
 #include <array>
 #include <bitset>
 #include <cmath>
+#include <cassert>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 
 namespace phm
@@ -20,7 +25,34 @@ namespace phm
 		// Defining types
 		using ComponentTypeID = uint64_t;
 		using ComponentBitSet = std::bitset<maxComponents>;
-		using ComponentArray = std::array<Component*, maxComponents>;
+
+		// Handle to an entity. The index refers to a slot in the entity records, which are recycled once the entity is destroyed.
+		// The generation is bumped every time the slot is recycled, so stale handles can be detected.
+		struct EntityId
+		{
+			static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+			uint32_t index = INVALID_INDEX;
+			uint32_t generation = 0;
+
+			[[nodiscard]] inline bool isNull() const { return index == INVALID_INDEX; };
+
+			inline bool operator==(const EntityId& other) const { return index == other.index && generation == other.generation; };
+			inline bool operator!=(const EntityId& other) const { return !(*this == other); };
+		};
+
+		// Type erased description of a component type. 
+		// The archetype storage uses this to move and destroy components without knowing their type.
+		struct ComponentInfo
+		{
+			size_t size = 0;
+			size_t alignment = 0;
+
+			void (*moveConstruct)(void* dst, void* src) = nullptr;
+			void (*destroy)(void* ptr) = nullptr;
+			// Only set for components that override Component::update.
+			void (*update)(void* ptr, Entity& entity) = nullptr;
+		};
 
 		// Defining helper functions
 		inline ComponentTypeID getComponentTypeID()
@@ -29,10 +61,24 @@ namespace phm
 			return lastID++;
 		}
 
+		inline std::array<ComponentInfo, maxComponents>& getComponentInfoTable()
+		{
+			static std::array<ComponentInfo, maxComponents> table{};
+			return table;
+		}
+
+		inline const ComponentInfo& getComponentInfo(ComponentTypeID id)
+		{
+			return getComponentInfoTable()[id];
+		}
+
+		template<typename T>
+		ComponentTypeID registerComponentType();
+
 		template<typename T>
 		inline ComponentTypeID getComponentTypeID() noexcept
 		{
-			static ComponentTypeID typeID = getComponentTypeID();
+			static ComponentTypeID typeID = registerComponentType<T>();
 			return typeID;
 		}
 
@@ -45,13 +91,31 @@ namespace phm
 
 			//virtual void init() = 0;
 			virtual void update(Entity& entity) {};
+		};
 
-		protected:
-			// Non-owning pointer to the parent entity.
-			Entity* entityPtr_;
+		template<typename T>
+		ComponentTypeID registerComponentType()
+		{
+			static_assert(std::is_move_constructible_v<T>, "Components are stored by value and must be move constructible");
 
-			friend Entity;
-		};
+			const ComponentTypeID id = getComponentTypeID();
+			assert(id < maxComponents && "Too many component types!");
+
+			ComponentInfo& info = getComponentInfoTable()[id];
+			info.size = sizeof(T);
+			info.alignment = alignof(T);
+			info.moveConstruct = [](void* dst, void* src) { new (dst) T(std::move(*static_cast<T*>(src))); };
+			info.destroy = [](void* ptr) { static_cast<T*>(ptr)->~T(); };
+
+			// Components that don't override update are skipped entirely when updating the scene
+			if constexpr (std::is_base_of_v<Component, T>)
+			{
+				if constexpr (!std::is_same_v<decltype(&T::update), void (Component::*)(Entity&)>)
+					info.update = [](void* ptr, Entity& entity) { static_cast<T*>(ptr)->update(entity); };
+			}
+
+			return id;
+		}
 	}
 }
 
@@ -1,6 +1,8 @@
 #include "pch.h"
 
 #include "phm_device.h"
+#include "phm_uploadBatcher.h"
+#include "phm_geometryPool.h"
 
 #include <cstring>
 #include <iostream>
@@ -91,14 +93,23 @@ namespace phm
 		pickPhysicalDevice();
 		DebugPrint("Creating logical device");
 		createLogicalDevice();
+		DebugPrint("Creating memory allocator");
+		allocator_ = std::make_unique<MemoryAllocator>(device_, physicalDevice_);
 		DebugPrint("Creating command pool");
 		createCommandPool();
+		DebugPrint("Creating upload batcher");
+		uploadBatcher_ = std::make_unique<UploadBatcher>(*this);
+		DebugPrint("Creating geometry pool");
+		geometryPool_ = std::make_unique<GeometryPool>(*this);
 	}
 
 	Device::~Device()
 	{
 		// Do the cleanup in the right order.
 
+		geometryPool_.reset();
+		uploadBatcher_.reset();
+		allocator_.reset();
 		vkDestroyCommandPool(device_, commandPool_, nullptr);
 		vkDestroyDevice(device_, nullptr);
 
@@ -279,8 +290,20 @@ namespace phm
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
-		// Declare used device features
+		// Declare used device features. The indirect drawing features are optional, without them the objects are culled on the CPU.
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice_, &supportedFeatures);
+
 		VkPhysicalDeviceFeatures deviceFeatures{};
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+		features = deviceFeatures;
+
+		// Lets indirect draws read their draw count from a buffer
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		const bool drawIndirectCount = isDeviceExtensionSupported(physicalDevice_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		if (drawIndirectCount)
+			enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
 
 		// Declare the locial device create info
 		VkDeviceCreateInfo createInfo{};
@@ -293,9 +316,9 @@ namespace phm
 		// Give it the device feature information
 		createInfo.pEnabledFeatures = &deviceFeatures;
 		// Tell it how many extensions are enabled
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
 		// Tell it which extensions are enabled
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		// Enable seperate validation layers
 		if (enableValidationLayers)
@@ -318,6 +341,12 @@ namespace phm
 		vkGetDeviceQueue(device_, indices.graphicsFamily.value(), 0, &graphicsQueue_);
 		// Set the presentation queue
 		vkGetDeviceQueue(device_, indices.presentFamily.value(), 0, &presentQueue_);
+
+		if (drawIndirectCount)
+		{
+			drawIndexedIndirectCount_ = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+				vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+		}
 	}
 
 	/// <summary>
@@ -563,6 +592,25 @@ namespace phm
 		return requiredExtensions.empty();
 	}
 
+	/// <summary>
+	/// Checks if a physical device supports a single device extension.
+	/// </summary>
+	bool Device::isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions)
+		{
+			if (std::strcmp(extension.extensionName, extensionName) == 0)
+				return true;
+		}
+		return false;
+	}
+
 	/// <summary>
 	/// Find the queue families supported by a device.
 	/// </summary>
@@ -702,13 +750,13 @@ namespace phm
 	/// <param name="usage">: Usage bitmask of the buffer. </param>
 	/// <param name="properties">: The required properties of the memory visible to the physical device. </param>
 	/// <param name="buffer">: The buffer reference that will be written to. </param>
-	/// <param name="bufferMemory">: The buffer device memory that will be written to. </param>
+	/// <param name="bufferMemory">: The memory allocation that will be written to. Free it with freeMemory. </param>
 	void Device::createBuffer(
 		VkDeviceSize size,
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties,
 		VkBuffer& buffer,
-		VkDeviceMemory& bufferMemory)
+		MemoryAllocation& bufferMemory)
 	{
 		// Create the bufferinfo struct and populate it.
 		VkBufferCreateInfo bufferInfo{};
@@ -729,20 +777,17 @@ namespace phm
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-		// Create the allocation info struct.
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		// Sub-allocate the memory from a larger block of the right memory type.
+		bufferMemory = allocator_->allocate(
+			memRequirements, 
+			findMemoryType(memRequirements.memoryTypeBits, properties), 
+			MemoryAllocator::ResourceType::Linear);
 
-		// Attempt to allocate memory on the physical device.
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+		// Bind the created buffer to its range of the block.
+		if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS)
 		{
-			throw std::runtime_error("failed to allocate buffer memory!");
+			throw std::runtime_error("failed to bind buffer memory!");
 		}
-
-		// Bind the created buffer to the allocated memory without any offset. Memory management for creating offsets will be added later.
-		vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 	}
 
 	/// <summary>
@@ -860,12 +905,12 @@ namespace phm
 	/// <param name="imageInfo">: The create info of the image. </param>
 	/// <param name="properties">: The property bitmask for the memory used to store the image. </param>
 	/// <param name="image">: The reference the VkImage will be written to. </param>
-	/// <param name="imageMemory">: The reference the image memory will be written to. </param>
+	/// <param name="imageMemory">: The reference the image memory allocation will be written to. Free it with freeMemory. </param>
 	void Device::createImageWithInfo(
 		const VkImageCreateInfo& imageInfo,
 		VkMemoryPropertyFlags properties,
 		VkImage& image,
-		VkDeviceMemory& imageMemory)
+		MemoryAllocation& imageMemory)
 	{
 		// First. Attemt to create the image itself. 
 		if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS)
@@ -877,20 +922,14 @@ namespace phm
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-		// Create the memory allocation info and populate it.
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		// Get the index of the memory.
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		// Sub-allocate the memory. Linear and optimal tiling resources use separate blocks.
+		imageMemory = allocator_->allocate(
+			memRequirements,
+			findMemoryType(memRequirements.memoryTypeBits, properties),
+			imageInfo.tiling == VK_IMAGE_TILING_LINEAR ? MemoryAllocator::ResourceType::Linear : MemoryAllocator::ResourceType::Optimal);
 
-		// Attempt to allocate the memory.
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to allocate image memory!");
-		}
 		// Attempt to bind the memory to the image.
-		if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS)
+		if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to bind image memory!");
 		}
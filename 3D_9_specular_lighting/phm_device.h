@@ -5,12 +5,17 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <memory>
 
 #include "phm_window.h"
+#include "phm_memoryAllocator.h"
 
 
 namespace phm
 {
+	class UploadBatcher;
+	class GeometryPool;
+
 	/// <summary>
 	/// Struct for storing the support details of a swap chain.
 	/// </summary>
@@ -73,7 +78,7 @@ namespace phm
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags properties,
 			VkBuffer& buffer,
-			VkDeviceMemory& bufferMemory);
+			MemoryAllocation& bufferMemory);
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -84,9 +89,38 @@ namespace phm
 			const VkImageCreateInfo& imageInfo,
 			VkMemoryPropertyFlags properties,
 			VkImage& image,
-			VkDeviceMemory& imageMemory);
+			MemoryAllocation& imageMemory);
+
+		/// <summary>
+		/// Returns memory allocated by createBuffer or createImageWithInfo. The resource must be destroyed first.
+		/// </summary>
+		inline void freeMemory(MemoryAllocation& allocation) { allocator_->free(allocation); }
+		inline MemoryAllocator& getAllocator() { return *allocator_; }
+		inline MemoryStatistics getMemoryStatistics() { return allocator_->getStatistics(); }
+
+		/// <summary>
+		/// Batches buffer uploads, so loading doesn't wait for the queue after every copy.
+		/// </summary>
+		inline UploadBatcher& getUploadBatcher() { return *uploadBatcher_; }
+
+		/// <summary>
+		/// Shared vertex and index buffers the models are sub-allocated from.
+		/// </summary>
+		inline GeometryPool& getGeometryPool() { return *geometryPool_; }
+
+		/// <summary>
+		/// True if the features GPU driven rendering depends on are enabled: multiDrawIndirect and drawIndirectFirstInstance.
+		/// </summary>
+		inline bool supportsMultiDrawIndirect() const { return features.multiDrawIndirect && features.drawIndirectFirstInstance; }
+
+		/// <summary>
+		/// vkCmdDrawIndexedIndirectCountKHR, or nullptr if VK_KHR_draw_indirect_count is not supported.
+		/// </summary>
+		inline PFN_vkCmdDrawIndexedIndirectCountKHR getDrawIndexedIndirectCount() const { return drawIndexedIndirectCount_; }
 
 		VkPhysicalDeviceProperties properties;
+		// The optional features that were enabled on the logical device.
+		VkPhysicalDeviceFeatures features{};
 
 	private:
 		void createInstance();
@@ -105,6 +139,7 @@ namespace phm
 		void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 		void hasGflwRequiredInstanceExtensions();
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+		bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
 		SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
 		VkInstance instance_;
@@ -118,6 +153,12 @@ namespace phm
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
 
+		std::unique_ptr<MemoryAllocator> allocator_;
+		std::unique_ptr<UploadBatcher> uploadBatcher_;
+		std::unique_ptr<GeometryPool> geometryPool_;
+
+		PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount_ = nullptr;
+
 		const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
 		const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 	};
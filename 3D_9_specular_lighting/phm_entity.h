@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "phm_component.h"
+#include "phm_archetype.h"
 
 #include "phm_transform.h"
 
@@ -11,57 +12,70 @@ namespace phm
 {
 	namespace ecs
 	{
+		// Lightweight handle to an entity in an ArchetypeStorage. Cheap to copy and safe to keep around:
+		// once the entity is destroyed the handle becomes invalid instead of dangling.
 		class Entity
 		{
 		public:
-			// All entities have a transform
-			Transform transform{};
-
-		public:
+			Entity() = default;
+			Entity(ArchetypeStorage& storage, EntityId id) : storage_(&storage), id_(id) {};
 
+			[[nodiscard]] inline EntityId getId() const { return id_; };
 
-			void update();
+			// All entities have a transform
+			inline Transform& transform() const { return getComponent<Transform>(); };
 
-			[[nodiscard]] inline bool isAlive() const { return alive_; };
-			inline void destroy() { alive_ = false; };
+			// True as long as the handle refers to an entity that has not been removed yet.
+			[[nodiscard]] inline bool isValid() const { return storage_ != nullptr && storage_->isValid(id_); };
+			[[nodiscard]] inline bool isAlive() const { return isValid() && !storage_->isPendingDestroy(id_); };
+			// Entities that are destroyed will be cleaned by the manager
+			inline void destroy() { storage_->destroyEntity(id_); };
 
 			template<typename T>
 			inline bool hasComponent() const
 			{
-				return componentBitSet_[getComponentTypeID<T>()];
+				return storage_->hasComponent(id_, getComponentTypeID<T>());
 			}
 
 			template<typename T, typename... TArgs>
 			T& addComponent(TArgs&&... mArgs)
 			{
-				T* c(new T(std::forward<TArgs>(mArgs)...));
-				c->entityPtr_ = this;
-				std::unique_ptr<Component> uPtr{ c };
-				components_.emplace_back(std::move(uPtr));
+				const ComponentTypeID id = getComponentTypeID<T>();
 
-				componentArray_[getComponentTypeID<T>()] = c;
-				componentBitSet_[getComponentTypeID<T>()] = true;
+				// Construct the component before touching the storage, so a throwing constructor leaves the entity untouched.
+				T component(std::forward<TArgs>(mArgs)...);
 
-				return *c;
+				if (storage_->hasComponent(id_, id))
+				{
+					T& existing = getComponent<T>();
+					existing.~T();
+					return *new (&existing) T(std::move(component));
+				}
+
+				void* slot = storage_->addComponent(id_, id);
+				return *new (slot) T(std::move(component));
 			}
 
 			template<typename T>
-			inline T& getComponent() const
+			void removeComponent()
 			{
-				auto ptr = componentArray_[getComponentTypeID<T>()];
-				return *static_cast<T*>(ptr);
+				static_assert(!std::is_same_v<T, Transform>, "All entities have a transform");
+				storage_->removeComponent(id_, getComponentTypeID<T>());
 			}
 
-		private:
-
-
-			// Entities that are not alive will be cleaned by the manager
-			bool alive_ = true;
+			template<typename T>
+			inline T& getComponent() const
+			{
+				assert(hasComponent<T>() && "Entity does not have the component");
+				return *static_cast<T*>(storage_->getComponent(id_, getComponentTypeID<T>()));
+			}
 
-			std::vector<std::unique_ptr<Component>> components_;
+			inline bool operator==(const Entity& other) const { return storage_ == other.storage_ && id_ == other.id_; };
+			inline bool operator!=(const Entity& other) const { return !(*this == other); };
 
-			ComponentArray componentArray_{};
-			ComponentBitSet componentBitSet_{};
+		private:
+			ArchetypeStorage* storage_ = nullptr;
+			EntityId id_{};
 		};
 
 	}
@@ -69,4 +83,4 @@ namespace phm
 
 
 
-#endif /* PHM_ENTITY_H */
\ No newline at end of file
+#endif /* PHM_ENTITY_H */
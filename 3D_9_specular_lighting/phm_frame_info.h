@@ -8,8 +8,7 @@
 
 namespace phm
 {
-#define MAX_LIGHTS 20
-	
+	// The lights live in a storage buffer, see LightRegistry.
 	struct PointLight
 	{
 		glm::vec4 position; // w is RADIUS
@@ -22,8 +21,27 @@ namespace phm
 		glm::mat4 view{ 1.0f };
 		glm::mat4 inverseView{ 1.0f };
 		glm::vec4 ambientLightColor{ 1.0f, 1.0f, 1.0f, 0.02f };
-		PointLight pointLights[MAX_LIGHTS];
-		int activeLights = 0;
+		// x is the depth slice scale, y the depth slice bias, z the light cutoff
+		glm::vec4 clusterParameters{ 0.0f };
+		// xyz is the size of the cluster grid, w the number of lights
+		glm::uvec4 clusterGrid{ 0 };
+	};
+
+	// Counters collected while recording a frame.
+	struct RenderStats
+	{
+		uint32_t visibleObjects = 0;
+		uint32_t culledObjects = 0;
+		uint32_t drawCalls = 0;
+		uint32_t triangles = 0;
+		// Objects whose per object data was written this frame, the others were unchanged.
+		uint32_t uploadedObjects = 0;
+		// Point light billboards that passed the frustum test.
+		uint32_t lightSprites = 0;
+		// Lights whose data was written to the light buffer this frame, the others were unchanged.
+		uint32_t uploadedLights = 0;
+		// CPU time spent culling and recording the draws of the scene.
+		float cpuMilliseconds = 0.0f;
 	};
 
 	struct FrameInfo
@@ -0,0 +1,277 @@
+#include "pch.h"
+
+#include "phm_geometryPool.h"
+
+#include "phm_swapchain.h"
+
+#include <algorithm>
+
+namespace phm
+{
+	GeometryPool::GeometryPool(Device& device, uint32_t vertexCapacity, uint32_t indexCapacity)
+		: device_(device), vertexCapacity_(vertexCapacity), indexCapacity_(indexCapacity)
+	{
+		// Compaction copies between the buffers, so they are transfer sources as well.
+		for (Pool& pool : vertexPools_)
+			pool.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		indexPool_.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		indexPool_.elementSize = sizeof(uint16_t);
+	}
+
+	GeometryPool::~GeometryPool()
+	{
+		assert(ranges_.size() == pendingFrees_.size() && "Geometry pool destroyed while models still use it");
+	}
+
+	GeometryPool::Range* GeometryPool::allocate(VertexFormat format, uint32_t vertexStride, const void* vertices, uint32_t vertexCount,
+		const uint16_t* indices, uint32_t indexCount, UploadBatcher::BatchId& uploadBatch)
+	{
+		assert(vertexCount > 0 && "Cannot allocate an empty range");
+
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		Pool& vertexPool = vertexPools_[static_cast<uint32_t>(format)];
+		assert((vertexPool.elementSize == 0 || vertexPool.elementSize == vertexStride) && "All vertices of a format must have the same stride");
+		vertexPool.elementSize = vertexStride;
+
+		auto range = std::make_unique<Range>();
+		range->format = format;
+		range->vertexCount = vertexCount;
+		range->indexCount = indexCount;
+
+		range->vertexHandle = allocateElements(vertexPool, vertexCount, vertexCapacity_, range->firstVertex);
+		if (indexCount > 0)
+			range->indexHandle = allocateElements(indexPool_, indexCount, indexCapacity_, range->firstIndex);
+
+		// The demand of the pool that was full is recorded, the next update grows it.
+		if (range->vertexHandle == RangeAllocator::INVALID_HANDLE || (indexCount > 0 && range->indexHandle == RangeAllocator::INVALID_HANDLE))
+		{
+			if (range->vertexHandle != RangeAllocator::INVALID_HANDLE)
+				vertexPool.ranges->free(range->vertexHandle);
+			if (range->indexHandle != RangeAllocator::INVALID_HANDLE)
+				indexPool_.ranges->free(range->indexHandle);
+
+			compactionRequested_ = true;
+			return nullptr;
+		}
+
+		UploadBatcher& uploadBatcher = device_.getUploadBatcher();
+		uploadBatch = uploadBatcher.upload(vertexPool.buffer->getBuffer(), vertices,
+			static_cast<VkDeviceSize>(vertexCount) * vertexStride, static_cast<VkDeviceSize>(range->firstVertex) * vertexStride);
+
+		if (indexCount > 0)
+		{
+			uploadBatch = uploadBatcher.upload(indexPool_.buffer->getBuffer(), indices,
+				static_cast<VkDeviceSize>(indexCount) * sizeof(uint16_t), static_cast<VkDeviceSize>(range->firstIndex) * sizeof(uint16_t));
+		}
+
+		range->slot = static_cast<uint32_t>(ranges_.size());
+		ranges_.push_back(std::move(range));
+		return ranges_.back().get();
+	}
+
+	void GeometryPool::free(Range* range)
+	{
+		if (range == nullptr)
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		pendingFrees_.push_back({ range, frame_ });
+	}
+
+	void GeometryPool::update()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		frame_++;
+
+		// A range freed during frame f may be read until the fence of frame f has been waited on,
+		// which happens at the latest when frame f + MAX_FRAMES_IN_FLIGHT begins.
+		size_t kept = 0;
+		for (const PendingFree& pendingFree : pendingFrees_)
+		{
+			if (frame_ - pendingFree.frame > Swapchain::MAX_FRAMES_IN_FLIGHT)
+				releaseLocked(pendingFree.range);
+			else
+				pendingFrees_[kept++] = pendingFree;
+		}
+		pendingFrees_.resize(kept);
+
+		if (compactionRequested_)
+			compactLocked();
+	}
+
+	void GeometryPool::compact()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		compactLocked();
+	}
+
+	void GeometryPool::bind(VkCommandBuffer commandBuffer, VertexFormat format) const
+	{
+		const Pool& vertexPool = vertexPools_[static_cast<uint32_t>(format)];
+		assert(vertexPool.buffer && "No geometry of this format in the pool");
+
+		VkBuffer buffers[] = { vertexPool.buffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+
+		if (indexPool_.buffer)
+			vkCmdBindIndexBuffer(commandBuffer, indexPool_.buffer->getBuffer(), 0, VK_INDEX_TYPE_UINT16);
+	}
+
+	GeometryPool::Statistics GeometryPool::getStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		Statistics statistics{};
+		statistics.rangeCount = static_cast<uint32_t>(ranges_.size() - pendingFrees_.size());
+		statistics.compactions = compactions_;
+
+		auto addPool = [&statistics](const Pool& pool)
+		{
+			if (!pool.buffer)
+				return;
+
+			statistics.freeRangeCount += pool.ranges->getFreeRangeCount();
+			statistics.capacityBytes += pool.capacity * pool.elementSize;
+			statistics.usedBytes += (pool.capacity - pool.ranges->getFreeSize()) * pool.elementSize;
+		};
+
+		for (const Pool& pool : vertexPools_)
+			addPool(pool);
+		addPool(indexPool_);
+
+		return statistics;
+	}
+
+	void GeometryPool::createBuffer(Pool& pool, uint32_t capacity)
+	{
+		pool.buffer = std::make_unique<Buffer>(
+			device_,
+			pool.elementSize,
+			capacity,
+			pool.usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			);
+		pool.ranges = std::make_unique<RangeAllocator>(capacity);
+		pool.capacity = capacity;
+	}
+
+	uint32_t GeometryPool::allocateElements(Pool& pool, uint32_t count, uint32_t defaultCapacity, uint32_t& first)
+	{
+		if (!pool.buffer)
+			createBuffer(pool, std::max(defaultCapacity, count));
+
+		const RangeAllocator::Allocation allocation = pool.ranges->allocate(count);
+		if (!allocation.isValid())
+		{
+			pool.missingElements += count;
+			return RangeAllocator::INVALID_HANDLE;
+		}
+
+		first = static_cast<uint32_t>(allocation.offset);
+		return allocation.handle;
+	}
+
+	void GeometryPool::releaseLocked(Range* range)
+	{
+		if (range->vertexHandle != RangeAllocator::INVALID_HANDLE)
+			vertexPools_[static_cast<uint32_t>(range->format)].ranges->free(range->vertexHandle);
+		if (range->indexHandle != RangeAllocator::INVALID_HANDLE)
+			indexPool_.ranges->free(range->indexHandle);
+
+		// Swap with the last range, which takes over the slot
+		const uint32_t slot = range->slot;
+		std::swap(ranges_[slot], ranges_.back());
+		ranges_[slot]->slot = slot;
+		ranges_.pop_back();
+	}
+
+	void GeometryPool::compactLocked()
+	{
+		// Queued uploads into the old buffers have to land before they are copied, and no frame may still read the old buffers.
+		device_.getUploadBatcher().waitIdle();
+		vkDeviceWaitIdle(device_.device());
+
+		// Nothing reads the freed ranges anymore.
+		for (const PendingFree& pendingFree : pendingFrees_)
+			releaseLocked(pendingFree.range);
+		pendingFrees_.clear();
+
+		std::vector<std::unique_ptr<Buffer>> oldBuffers{};
+		VkCommandBuffer commandBuffer = device_.beginSingleTimeCommands();
+
+		for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++)
+			oldBuffers.push_back(compactPool(vertexPools_[format], commandBuffer, false, static_cast<VertexFormat>(format)));
+		oldBuffers.push_back(compactPool(indexPool_, commandBuffer, true, VertexFormat::Full));
+
+		// Make the copies visible to the draws of the next frames
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		// Waits for the copies, after which the old buffers can go.
+		device_.endSingleTimeCommands(commandBuffer);
+
+		compactionRequested_ = false;
+		compactions_++;
+
+		DebugPrint("Compacted geometry pool, " << ranges_.size() << " ranges");
+	}
+
+	std::unique_ptr<Buffer> GeometryPool::compactPool(Pool& pool, VkCommandBuffer commandBuffer, bool indices, VertexFormat format)
+	{
+		if (!pool.buffer)
+			return nullptr;
+
+		// Nothing to gain if everything fit and the free space is already in one piece.
+		if (pool.missingElements == 0 && pool.ranges->getFreeRangeCount() <= 1)
+			return nullptr;
+
+		const uint64_t required = pool.capacity - pool.ranges->getFreeSize() + pool.missingElements;
+		uint64_t capacity = pool.capacity;
+		while (capacity < required)
+			capacity *= 2;
+
+		if (capacity > UINT32_MAX)
+			throw std::runtime_error("Geometry pool exceeds the maximum size");
+
+		std::unique_ptr<Buffer> oldBuffer = std::move(pool.buffer);
+		createBuffer(pool, static_cast<uint32_t>(capacity));
+		pool.missingElements = 0;
+
+		// The fresh allocator hands out the ranges back to back.
+		std::vector<VkBufferCopy> regions{};
+		for (const std::unique_ptr<Range>& range : ranges_)
+		{
+			uint32_t& handle = indices ? range->indexHandle : range->vertexHandle;
+			uint32_t& first = indices ? range->firstIndex : range->firstVertex;
+			const uint32_t count = indices ? range->indexCount : range->vertexCount;
+
+			if (handle == RangeAllocator::INVALID_HANDLE || (!indices && range->format != format))
+				continue;
+
+			const RangeAllocator::Allocation allocation = pool.ranges->allocate(count);
+			assert(allocation.isValid() && "Compacted pool too small");
+
+			regions.push_back({ first * pool.elementSize, allocation.offset * pool.elementSize, count * pool.elementSize });
+			handle = allocation.handle;
+			first = static_cast<uint32_t>(allocation.offset);
+		}
+
+		if (!regions.empty())
+			vkCmdCopyBuffer(commandBuffer, oldBuffer->getBuffer(), pool.buffer->getBuffer(), static_cast<uint32_t>(regions.size()), regions.data());
+
+		return oldBuffer;
+	}
+}
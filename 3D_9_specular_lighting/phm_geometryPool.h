@@ -0,0 +1,143 @@
+#ifndef PHM_GEOMETRY_POOL_H
+#define PHM_GEOMETRY_POOL_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "phm_device.h"
+#include "phm_buffer.h"
+#include "phm_rangeAllocator.h"
+#include "phm_uploadBatcher.h"
+#include "phm_vertexFormat.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Shared device local vertex and index buffers that the geometry of the models is sub-allocated from,
+	/// so the buffers are bound once per frame (once per vertex format) instead of once per model.
+	/// Vertices are allocated in units of the stride of their format and indices in units of 16 bit indices,
+	/// so draws address the geometry through vertexOffset and firstIndex.
+	/// Freed ranges are only reused once the frames in flight that may still read them have finished.
+	/// Compaction moves the live ranges to the front of new buffers sized for the current demand, which closes the holes left by freed ranges and grows the pool.
+	/// </summary>
+	class GeometryPool
+	{
+	public:
+		static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 1 << 20;
+		static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 1 << 22;
+
+		// Where the geometry of one model lives in the pool. The offsets change when the pool is compacted.
+		struct Range
+		{
+			VertexFormat format = VertexFormat::Full;
+			uint32_t firstVertex = 0;
+			uint32_t vertexCount = 0;
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+
+		private:
+			friend class GeometryPool;
+
+			uint32_t vertexHandle = RangeAllocator::INVALID_HANDLE;
+			uint32_t indexHandle = RangeAllocator::INVALID_HANDLE;
+			// Position in ranges_
+			uint32_t slot = 0;
+		};
+
+		struct Statistics
+		{
+			uint32_t rangeCount = 0;
+			uint32_t freeRangeCount = 0;
+			VkDeviceSize capacityBytes = 0;
+			VkDeviceSize usedBytes = 0;
+			uint32_t compactions = 0;
+		};
+
+		GeometryPool(Device& device, uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY, uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY);
+		~GeometryPool();
+
+		GeometryPool(const GeometryPool&) = delete;
+		GeometryPool& operator=(const GeometryPool&) = delete;
+
+		/// <summary>
+		/// Allocates a range and queues the upload of the vertices and indices into it. Thread safe.
+		/// Returns nullptr if the pool is full, the next call to update grows the pool so later allocations fit.
+		/// </summary>
+		/// <param name="vertices">Vertices in the given format, vertexStride bytes each. All vertices of a format must have the same stride.</param>
+		/// <param name="uploadBatch">Receives the upload batch of the copies.</param>
+		Range* allocate(VertexFormat format, uint32_t vertexStride, const void* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount,
+			UploadBatcher::BatchId& uploadBatch);
+
+		/// <summary>
+		/// Returns the range to the pool once the frames in flight have finished with it. Thread safe.
+		/// </summary>
+		void free(Range* range);
+
+		/// <summary>
+		/// Releases the ranges freed MAX_FRAMES_IN_FLIGHT frames ago and compacts the pool if an allocation didn't fit.
+		/// Call once per frame from the thread that submits to the graphics queue, outside of command buffer recording.
+		/// Compaction waits for the device to be idle, so it causes a hitch.
+		/// </summary>
+		void update();
+
+		/// <summary>
+		/// Moves the live ranges to the front of new buffers with room for the pending demand. Waits for the device to be idle.
+		/// Must not be called while a command buffer that binds the pool is being recorded.
+		/// </summary>
+		void compact();
+
+		// Binds the vertex buffer of the format to binding 0, and the index buffer.
+		void bind(VkCommandBuffer commandBuffer, VertexFormat format) const;
+
+		Statistics getStatistics();
+
+	private:
+		struct Pool
+		{
+			std::unique_ptr<Buffer> buffer{};
+			std::unique_ptr<RangeAllocator> ranges{};
+			VkBufferUsageFlags usage = 0;
+			VkDeviceSize elementSize = 0;
+			uint32_t capacity = 0;
+			// Elements that didn't fit since the last compaction
+			uint64_t missingElements = 0;
+		};
+
+		struct PendingFree
+		{
+			Range* range;
+			uint64_t frame;
+		};
+
+		Device& device_;
+
+		std::array<Pool, VERTEX_FORMAT_COUNT> vertexPools_{};
+		Pool indexPool_{};
+
+		std::vector<std::unique_ptr<Range>> ranges_{};
+		std::vector<PendingFree> pendingFrees_{};
+
+		uint64_t frame_ = 0;
+		bool compactionRequested_ = false;
+		uint32_t compactions_ = 0;
+
+		std::mutex mutex_;
+
+		uint32_t vertexCapacity_;
+		uint32_t indexCapacity_;
+
+		void createBuffer(Pool& pool, uint32_t capacity);
+		// Allocates from the pool, creating its buffer on first use. Returns INVALID_HANDLE and records the demand if it doesn't fit.
+		uint32_t allocateElements(Pool& pool, uint32_t count, uint32_t defaultCapacity, uint32_t& first);
+
+		void releaseLocked(Range* range);
+		void compactLocked();
+		// Moves the live ranges of one pool to the front of a new buffer, recording the copies. Returns the old buffer, which has to outlive the copies.
+		std::unique_ptr<Buffer> compactPool(Pool& pool, VkCommandBuffer commandBuffer, bool indices, VertexFormat format);
+	};
+}
+
+#endif /* PHM_GEOMETRY_POOL_H */
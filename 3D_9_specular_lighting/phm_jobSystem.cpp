@@ -0,0 +1,197 @@
+#include "pch.h"
+
+#include "phm_jobSystem.h"
+
+namespace phm
+{
+	// Index of the queue owned by the current thread. Threads that aren't workers share the last queue.
+	static thread_local const JobSystem* tlsJobSystem = nullptr;
+	static thread_local uint32_t tlsQueueIndex = 0;
+
+	JobSystem::JobSystem(uint32_t workerCount)
+	{
+		for (uint32_t i = 0; i < workerCount + 1; i++)
+			queues_.push_back(std::make_unique<JobQueue>());
+
+		workers_.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++)
+			workers_.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex_);
+			stopping_ = true;
+		}
+		sleepCondition_.notify_all();
+
+		for (auto& worker : workers_)
+			worker.join();
+	}
+
+	void JobSystem::run(Counter& counter, std::function<void()> job)
+	{
+		counter.pending_.fetch_add(1, std::memory_order_relaxed);
+
+		if (workers_.empty())
+		{
+			Job inlineJob{ std::move(job), &counter };
+			execute(inlineJob);
+			return;
+		}
+
+		push({ std::move(job), &counter });
+	}
+
+	void JobSystem::runAfter(Counter& dependency, Counter& counter, std::function<void()> job)
+	{
+		counter.pending_.fetch_add(1, std::memory_order_relaxed);
+
+		{
+			std::lock_guard<std::mutex> lock(dependency.continuationMutex_);
+			if (!dependency.isDone())
+			{
+				dependency.continuations_.emplace_back(std::move(job), &counter);
+				return;
+			}
+		}
+
+		// The dependency is already done. The counter was incremented above, so hand it over as is.
+		Job readyJob{ std::move(job), &counter };
+		if (workers_.empty())
+			execute(readyJob);
+		else
+			push(std::move(readyJob));
+	}
+
+	void JobSystem::wait(Counter& counter)
+	{
+		while (!counter.isDone())
+		{
+			if (!tryRunJob())
+				std::this_thread::yield();
+		}
+
+		// Wait for the thread that finished the last job to release the counter
+		std::lock_guard<std::mutex> lock(counter.continuationMutex_);
+	}
+
+	uint32_t JobSystem::defaultWorkerCount()
+	{
+		// Leave one hardware thread for the main thread.
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	void JobSystem::workerLoop(uint32_t index)
+	{
+		tlsJobSystem = this;
+		tlsQueueIndex = index;
+
+		while (true)
+		{
+			if (tryRunJob())
+				continue;
+
+			std::unique_lock<std::mutex> lock(sleepMutex_);
+			sleepCondition_.wait(lock, [this]() { return stopping_ || queuedJobs_.load(std::memory_order_acquire) > 0; });
+
+			if (stopping_ && queuedJobs_.load(std::memory_order_acquire) == 0)
+				return;
+		}
+	}
+
+	void JobSystem::push(Job job)
+	{
+		JobQueue& queue = *queues_[getQueueIndex()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(std::move(job));
+		}
+
+		queuedJobs_.fetch_add(1, std::memory_order_release);
+		{
+			// Taking the lock prevents the wakeup from being lost between a worker's check and its wait
+			std::lock_guard<std::mutex> lock(sleepMutex_);
+		}
+		sleepCondition_.notify_one();
+	}
+
+	bool JobSystem::tryPop(uint32_t queueIndex, Job& job)
+	{
+		JobQueue& queue = *queues_[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			return false;
+
+		job = std::move(queue.jobs.back());
+		queue.jobs.pop_back();
+		return true;
+	}
+
+	bool JobSystem::trySteal(uint32_t thiefIndex, Job& job)
+	{
+		const uint32_t queueCount = static_cast<uint32_t>(queues_.size());
+		for (uint32_t i = 1; i < queueCount; i++)
+		{
+			JobQueue& queue = *queues_[(thiefIndex + i) % queueCount];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.jobs.empty())
+				continue;
+
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			return true;
+		}
+
+		return false;
+	}
+
+	bool JobSystem::tryRunJob()
+	{
+		const uint32_t queueIndex = getQueueIndex();
+
+		Job job;
+		if (!tryPop(queueIndex, job) && !trySteal(queueIndex, job))
+			return false;
+
+		queuedJobs_.fetch_sub(1, std::memory_order_relaxed);
+		execute(job);
+		return true;
+	}
+
+	void JobSystem::execute(Job& job)
+	{
+		job.function();
+
+		// The decrement happens under the lock, so a thread returning from wait can't destroy the counter while it is still in use here.
+		std::vector<std::pair<std::function<void()>, Counter*>> continuations;
+		{
+			Counter& counter = *job.counter;
+			std::lock_guard<std::mutex> lock(counter.continuationMutex_);
+			if (counter.pending_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+
+			// The counter reached zero, release the jobs waiting for it
+			continuations.swap(counter.continuations_);
+		}
+
+		for (auto& [function, continuationCounter] : continuations)
+		{
+			Job continuation{ std::move(function), continuationCounter };
+			if (workers_.empty())
+				execute(continuation);
+			else
+				push(std::move(continuation));
+		}
+	}
+
+	uint32_t JobSystem::getQueueIndex() const
+	{
+		if (tlsJobSystem == this)
+			return tlsQueueIndex;
+
+		return static_cast<uint32_t>(queues_.size() - 1);
+	}
+}
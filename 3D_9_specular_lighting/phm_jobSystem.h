@@ -0,0 +1,127 @@
+#ifndef PHM_JOBSYSTEM_H
+#define PHM_JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace phm
+{
+	// Work stealing job system shared by the engine subsystems.
+	// Every worker owns a deque of jobs. A worker pushes and pops jobs at the back of its own deque (so recently spawned, 
+	// cache warm jobs run first) and steals from the front of the other deques when it runs out of work.
+	class JobSystem
+	{
+	public:
+		// Counts the outstanding jobs submitted with it. Jobs can be made to wait for a counter, which is how dependencies are expressed.
+		class Counter
+		{
+		public:
+			Counter() = default;
+			Counter(const Counter&) = delete;
+			Counter& operator=(const Counter&) = delete;
+
+			// Use JobSystem::wait before destroying a counter, isDone is only meant for polling.
+			[[nodiscard]] inline bool isDone() const { return pending_.load(std::memory_order_acquire) == 0; };
+
+		private:
+			std::atomic<uint32_t> pending_{ 0 };
+
+			// Jobs waiting for this counter to reach zero
+			std::mutex continuationMutex_;
+			std::vector<std::pair<std::function<void()>, Counter*>> continuations_;
+
+			friend JobSystem;
+		};
+
+		explicit JobSystem(uint32_t workerCount = defaultWorkerCount());
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// Number of threads that execute jobs, including a thread waiting on a counter.
+		[[nodiscard]] inline uint32_t getThreadCount() const { return static_cast<uint32_t>(workers_.size()) + 1; };
+
+		// Spawns a job. The counter is decremented when the job has finished.
+		void run(Counter& counter, std::function<void()> job);
+		// Spawns a job once the dependency has reached zero. The counter is incremented immediately.
+		void runAfter(Counter& dependency, Counter& counter, std::function<void()> job);
+		// Blocks until the counter reaches zero. The calling thread executes jobs while it waits, 
+		// so it is safe (and efficient) to wait from within a job.
+		void wait(Counter& counter);
+
+		// Splits [0, count) into batches and calls func(begin, end) for each of them in parallel.
+		template<typename Func>
+		void parallelFor(uint32_t count, uint32_t batchSize, Func&& func)
+		{
+			if (count == 0)
+				return;
+
+			batchSize = std::max(batchSize, 1u);
+			if (workers_.empty() || count <= batchSize)
+			{
+				func(0u, count);
+				return;
+			}
+
+			Counter counter;
+			for (uint32_t begin = batchSize; begin < count; begin += batchSize)
+			{
+				const uint32_t end = std::min(begin + batchSize, count);
+				run(counter, [&func, begin, end]() { func(begin, end); });
+			}
+
+			// The calling thread takes the first batch
+			func(0u, std::min(batchSize, count));
+			wait(counter);
+		}
+
+		// Picks a batch size that gives every thread a few batches to balance the load.
+		[[nodiscard]] inline uint32_t getBatchSize(uint32_t count, uint32_t minBatchSize = 1) const
+		{
+			const uint32_t batches = getThreadCount() * 4;
+			return std::max(minBatchSize, (count + batches - 1) / batches);
+		};
+
+		static uint32_t defaultWorkerCount();
+
+	private:
+		struct Job
+		{
+			std::function<void()> function;
+			Counter* counter;
+		};
+
+		struct alignas(64) JobQueue
+		{
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		std::vector<std::thread> workers_;
+		// One queue per worker, plus a shared queue for threads that aren't workers.
+		std::vector<std::unique_ptr<JobQueue>> queues_;
+
+		std::atomic<uint32_t> queuedJobs_{ 0 };
+		std::mutex sleepMutex_;
+		std::condition_variable sleepCondition_;
+		bool stopping_ = false;
+
+		void workerLoop(uint32_t index);
+		void push(Job job);
+		bool tryPop(uint32_t queueIndex, Job& job);
+		bool trySteal(uint32_t thiefIndex, Job& job);
+		bool tryRunJob();
+		void execute(Job& job);
+		uint32_t getQueueIndex() const;
+	};
+}
+
+#endif /* PHM_JOBSYSTEM_H */
@@ -18,14 +18,17 @@ namespace phm
 		if (glfwGetKey(window, keys.lookDown) == GLFW_PRESS)
 			rotate.x -= 1.0f;
 
+		Transform& transform = entity.transform();
+		glm::vec3 rotation = transform.getRotation();
 		if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon())
-			entity.transform.rotation += lookSpeed * dt * glm::normalize(rotate);
+			rotation += lookSpeed * dt * glm::normalize(rotate);
 
-		entity.transform.rotation.x = glm::clamp(entity.transform.rotation.x, -1.5f, 1.5f);
-		entity.transform.rotation.y = glm::mod(entity.transform.rotation.y, glm::two_pi<float>());
+		rotation.x = glm::clamp(rotation.x, -1.5f, 1.5f);
+		rotation.y = glm::mod(rotation.y, glm::two_pi<float>());
+		transform.setRotation(rotation);
 
 		// MOVEMENT
-		float yaw = entity.transform.rotation.y;
+		float yaw = rotation.y;
 		const glm::vec3 forward{ sin(yaw), 0.0f, cos(yaw) };
 		const glm::vec3 right{ forward.z, 0.0f, -forward.x };
 		const glm::vec3 up{ 0.0f, -1.0f, 0.0f };
@@ -45,7 +48,7 @@ namespace phm
 			move -= up;
 
 		if (glm::dot(move, move) > std::numeric_limits<float>::epsilon())
-			entity.transform.translation += moveSpeed * dt * glm::normalize(move);
+			transform.setTranslation(transform.getTranslation() + moveSpeed * dt * glm::normalize(move));
 
 	}
 }
@@ -0,0 +1,288 @@
+#include "pch.h"
+
+#include "phm_lightClusters.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PHM_CLUSTERS_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace phm
+{
+	namespace
+	{
+		// Range of the normalized device coordinate scale * v / z over v in [center - radius, center + radius] and z in [zMin, zMax].
+		void projectedRange(float center, float radius, float scale, float zMin, float zMax, float& low, float& high)
+		{
+			const float a = scale * (center - radius);
+			const float b = scale * (center + radius);
+			low = std::min({ a / zMin, a / zMax, b / zMin, b / zMax });
+			high = std::max({ a / zMin, a / zMax, b / zMin, b / zMax });
+		}
+
+		// Same mapping as simple_shader.frag.
+		uint32_t tileIndex(float ndc, uint32_t tiles)
+		{
+			const float tile = std::floor((ndc * 0.5f + 0.5f) * static_cast<float>(tiles));
+			return static_cast<uint32_t>(std::clamp(tile, 0.0f, static_cast<float>(tiles - 1)));
+		}
+	}
+
+	LightClusters::LightClusters(Device& device, JobSystem& jobSystem) :
+		device_(device),
+		jobSystem_(jobSystem),
+		frames_(Swapchain::MAX_FRAMES_IN_FLIGHT)
+	{
+		// The descriptors need valid buffers before the first update.
+		for (FrameResources& frame : frames_)
+		{
+			reserve(frame.clusterBuffer, sizeof(Cluster), CLUSTER_COUNT, CLUSTER_COUNT);
+			reserve(frame.indexBuffer, sizeof(uint32_t), 0, 4096);
+			std::memset(frame.clusterBuffer->getMappedMemory(), 0, CLUSTER_COUNT * sizeof(Cluster));
+		}
+
+		const size_t paddedCount = CLUSTER_COUNT + 3;
+		for (std::vector<float>* values : { &bounds_.minX, &bounds_.minY, &bounds_.minZ, &bounds_.maxX, &bounds_.maxY, &bounds_.maxZ })
+			values->assign(paddedCount, 0.0f);
+
+		clusterCursors_.resize(CLUSTER_COUNT);
+	}
+
+	bool LightClusters::update(uint32_t frameIndex, const Camera& camera, const std::vector<PointLight>& lights)
+	{
+		assert(camera.isPerspective() && "Light clusters need a perspective projection!");
+
+		const glm::mat4& projection = camera.getProjection();
+		const glm::vec4 boundsProjection{ camera.getNear(), camera.getFar(), projection[0][0], projection[1][1] };
+		if (boundsProjection != boundsProjection_)
+		{
+			boundsProjection_ = boundsProjection;
+			buildBounds(camera);
+		}
+
+		FrameResources& frame = frames_[frameIndex];
+		const uint32_t lightCount = static_cast<uint32_t>(lights.size());
+
+		// Every batch writes its own list, which keeps the lights of a cluster in light order without any synchronization.
+		const uint32_t batchCount = (lightCount + BATCH_SIZE - 1) / BATCH_SIZE;
+		if (batchAssignments_.size() < batchCount)
+			batchAssignments_.resize(batchCount);
+
+		const glm::mat4& view = camera.getView();
+		jobSystem_.parallelFor(lightCount, BATCH_SIZE, [&](uint32_t begin, uint32_t end)
+			{
+				// The range can span several batches, when the job system runs it inline it gets all the lights at once.
+				for (uint32_t first = begin; first < end; first += BATCH_SIZE)
+				{
+					std::vector<Assignment>& assignments = batchAssignments_[first / BATCH_SIZE];
+					assignments.clear();
+					assignLights(view, projection, lights, first, std::min(first + BATCH_SIZE, end), assignments);
+				}
+			});
+
+		// Counting sort of the assignments by cluster.
+		std::fill(clusterCursors_.begin(), clusterCursors_.end(), 0u);
+		for (uint32_t batch = 0; batch < batchCount; batch++)
+		{
+			for (const Assignment& assignment : batchAssignments_[batch])
+				clusterCursors_[assignment.cluster]++;
+		}
+
+		auto* clusters = static_cast<Cluster*>(frame.clusterBuffer->getMappedMemory());
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i < CLUSTER_COUNT; i++)
+		{
+			const uint32_t count = clusterCursors_[i];
+			clusters[i] = { offset, count };
+			clusterCursors_[i] = offset;
+			offset += count;
+		}
+		assignmentCount_ = offset;
+
+		// Built in host memory first, scattered writes into the mapped buffer would be slow.
+		lightIndices_.resize(assignmentCount_);
+		for (uint32_t batch = 0; batch < batchCount; batch++)
+		{
+			for (const Assignment& assignment : batchAssignments_[batch])
+				lightIndices_[clusterCursors_[assignment.cluster]++] = assignment.light;
+		}
+
+		const bool reallocated = reserve(frame.indexBuffer, sizeof(uint32_t), assignmentCount_, 4096);
+		if (assignmentCount_ > 0)
+			std::memcpy(frame.indexBuffer->getMappedMemory(), lightIndices_.data(), assignmentCount_ * sizeof(uint32_t));
+
+		return reallocated;
+	}
+
+	float LightClusters::lightRange(const PointLight& light)
+	{
+		// intensity / range^2 = LIGHT_CUTOFF
+		return light.color.w > 0.0f ? std::sqrt(light.color.w / LIGHT_CUTOFF) : 0.0f;
+	}
+
+	void LightClusters::buildBounds(const Camera& camera)
+	{
+		const float near = camera.getNear();
+		const float far = camera.getFar();
+		const float scaleX = camera.getProjection()[0][0];
+		const float scaleY = camera.getProjection()[1][1];
+
+		// slice = log(z) * scale + bias puts near at slice 0 and far at slice GRID_Z.
+		const float logDepthRatio = std::log(far / near);
+		parameters_.x = static_cast<float>(GRID_Z) / logDepthRatio;
+		parameters_.y = -static_cast<float>(GRID_Z) * std::log(near) / logDepthRatio;
+
+		for (uint32_t z = 0; z < GRID_Z; z++)
+		{
+			const float sliceNear = near * std::pow(far / near, static_cast<float>(z) / GRID_Z);
+			const float sliceFar = near * std::pow(far / near, static_cast<float>(z + 1) / GRID_Z);
+
+			for (uint32_t y = 0; y < GRID_Y; y++)
+			{
+				const float ndcY0 = -1.0f + 2.0f * static_cast<float>(y) / GRID_Y;
+				const float ndcY1 = -1.0f + 2.0f * static_cast<float>(y + 1) / GRID_Y;
+				const float minY = std::min({ ndcY0 * sliceNear, ndcY0 * sliceFar, ndcY1 * sliceNear, ndcY1 * sliceFar }) / scaleY;
+				const float maxY = std::max({ ndcY0 * sliceNear, ndcY0 * sliceFar, ndcY1 * sliceNear, ndcY1 * sliceFar }) / scaleY;
+
+				for (uint32_t x = 0; x < GRID_X; x++)
+				{
+					const float ndcX0 = -1.0f + 2.0f * static_cast<float>(x) / GRID_X;
+					const float ndcX1 = -1.0f + 2.0f * static_cast<float>(x + 1) / GRID_X;
+					const uint32_t index = (z * GRID_Y + y) * GRID_X + x;
+
+					bounds_.minX[index] = std::min({ ndcX0 * sliceNear, ndcX0 * sliceFar, ndcX1 * sliceNear, ndcX1 * sliceFar }) / scaleX;
+					bounds_.maxX[index] = std::max({ ndcX0 * sliceNear, ndcX0 * sliceFar, ndcX1 * sliceNear, ndcX1 * sliceFar }) / scaleX;
+					bounds_.minY[index] = std::min(minY, maxY);
+					bounds_.maxY[index] = std::max(minY, maxY);
+					bounds_.minZ[index] = sliceNear;
+					bounds_.maxZ[index] = sliceFar;
+				}
+			}
+		}
+	}
+
+	void LightClusters::assignLights(const glm::mat4& view, const glm::mat4& projection, const std::vector<PointLight>& lights,
+		uint32_t begin, uint32_t end, std::vector<Assignment>& assignments) const
+	{
+		const float near = boundsProjection_.x;
+		const float far = boundsProjection_.y;
+
+		auto slice = [this](float depth)
+			{
+				const float slice = std::floor(std::log(depth) * parameters_.x + parameters_.y);
+				return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(GRID_Z - 1)));
+			};
+
+		for (uint32_t light = begin; light < end; light++)
+		{
+			const float radius = lightRange(lights[light]);
+			if (radius <= 0.0f)
+				continue;
+
+			const glm::vec4 center = view * glm::vec4{ lights[light].position.x, lights[light].position.y, lights[light].position.z, 1.0f };
+			if (center.z + radius <= near || center.z - radius >= far)
+				continue;
+
+			const uint32_t z0 = slice(std::max(center.z - radius, near));
+			const uint32_t z1 = slice(std::min(center.z + radius, far));
+
+			// Screen space bounds of the light's view space box, the whole screen if the box reaches behind the near plane.
+			uint32_t x0 = 0, x1 = GRID_X - 1, y0 = 0, y1 = GRID_Y - 1;
+			if (center.z - radius > near)
+			{
+				float low, high;
+				projectedRange(center.x, radius, projection[0][0], center.z - radius, center.z + radius, low, high);
+				if (high < -1.0f || low > 1.0f)
+					continue;
+				x0 = tileIndex(low, GRID_X);
+				x1 = tileIndex(high, GRID_X);
+
+				projectedRange(center.y, radius, projection[1][1], center.z - radius, center.z + radius, low, high);
+				if (high < -1.0f || low > 1.0f)
+					continue;
+				y0 = tileIndex(low, GRID_Y);
+				y1 = tileIndex(high, GRID_Y);
+			}
+
+			// The screen space bounds are conservative, so the clusters are refined with a sphere against box test.
+			const float radiusSquared = radius * radius;
+#ifdef PHM_CLUSTERS_SSE
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 centerX = _mm_set1_ps(center.x);
+			const __m128 centerY = _mm_set1_ps(center.y);
+			const __m128 centerZ = _mm_set1_ps(center.z);
+			const __m128 radius2 = _mm_set1_ps(radiusSquared);
+#endif
+
+			for (uint32_t z = z0; z <= z1; z++)
+			{
+				for (uint32_t y = y0; y <= y1; y++)
+				{
+					const uint32_t row = (z * GRID_Y + y) * GRID_X;
+#ifdef PHM_CLUSTERS_SSE
+					for (uint32_t x = x0; x <= x1; x += 4)
+					{
+						const uint32_t index = row + x;
+
+						__m128 dx = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&bounds_.minX[index]), centerX), _mm_sub_ps(centerX, _mm_loadu_ps(&bounds_.maxX[index])));
+						__m128 dy = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&bounds_.minY[index]), centerY), _mm_sub_ps(centerY, _mm_loadu_ps(&bounds_.maxY[index])));
+						__m128 dz = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&bounds_.minZ[index]), centerZ), _mm_sub_ps(centerZ, _mm_loadu_ps(&bounds_.maxZ[index])));
+						dx = _mm_max_ps(dx, zero);
+						dy = _mm_max_ps(dy, zero);
+						dz = _mm_max_ps(dz, zero);
+
+						const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+						int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radius2));
+						// Drop the lanes past the end of the tile range.
+						const uint32_t lanes = std::min(4u, x1 - x + 1);
+						mask &= (1 << lanes) - 1;
+
+						for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1)
+						{
+							if (mask & 1)
+								assignments.push_back({ index + lane, light });
+						}
+					}
+#else
+					for (uint32_t x = x0; x <= x1; x++)
+					{
+						const uint32_t index = row + x;
+
+						const float dx = std::max({ bounds_.minX[index] - center.x, center.x - bounds_.maxX[index], 0.0f });
+						const float dy = std::max({ bounds_.minY[index] - center.y, center.y - bounds_.maxY[index], 0.0f });
+						const float dz = std::max({ bounds_.minZ[index] - center.z, center.z - bounds_.maxZ[index], 0.0f });
+						if (dx * dx + dy * dy + dz * dz <= radiusSquared)
+							assignments.push_back({ index, light });
+					}
+#endif
+				}
+			}
+		}
+	}
+
+	bool LightClusters::reserve(std::unique_ptr<Buffer>& buffer, VkDeviceSize instanceSize, uint32_t instanceCount, uint32_t minCapacity)
+	{
+		if (buffer && buffer->getInstanceCount() >= instanceCount)
+			return false;
+
+		// Grow geometrically so a slowly growing scene does not reallocate every frame.
+		uint32_t capacity = buffer ? buffer->getInstanceCount() : minCapacity;
+		while (capacity < instanceCount)
+			capacity *= 2;
+
+		buffer = std::make_unique<Buffer>(
+			device_,
+			instanceSize,
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			);
+		buffer->map();
+		return true;
+	}
+}
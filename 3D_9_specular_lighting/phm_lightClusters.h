@@ -0,0 +1,114 @@
+#ifndef PHM_LIGHT_CLUSTERS_H
+#define PHM_LIGHT_CLUSTERS_H
+
+#include <memory>
+#include <vector>
+
+#include "phm_device.h"
+#include "phm_buffer.h"
+#include "phm_swapchain.h"
+#include "phm_camera.h"
+#include "phm_frame_info.h"
+#include "phm_jobSystem.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Clustered forward shading: the view frustum is split into a grid of clusters, GRID_X by GRID_Y screen tiles
+	/// and GRID_Z depth slices that grow exponentially with the distance, and every light is assigned to the clusters its range touches.
+	/// The fragment shader finds the cluster of the fragment and only loops over the lights of that cluster.
+	/// The offset and count of every cluster and the light index lists are written to storage buffers, one set per frame in flight,
+	/// that grow with the number of lights. The lights themselves are uploaded by the LightRegistry.
+	/// </summary>
+	class LightClusters
+	{
+	public:
+		static constexpr uint32_t GRID_X = 16;
+		static constexpr uint32_t GRID_Y = 9;
+		static constexpr uint32_t GRID_Z = 24;
+		static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+		// The light falls off as intensity / distance^2 - LIGHT_CUTOFF, which makes its range finite.
+		static constexpr float LIGHT_CUTOFF = 0.005f;
+		// Lights assigned per job.
+		static constexpr uint32_t BATCH_SIZE = 256;
+
+		// Offset into the light index list and number of lights of one cluster.
+		struct Cluster
+		{
+			uint32_t offset = 0;
+			uint32_t count = 0;
+		};
+
+		LightClusters(Device& device, JobSystem& jobSystem);
+
+		LightClusters(const LightClusters&) = delete;
+		LightClusters& operator=(const LightClusters&) = delete;
+
+		/// <summary>
+		/// Assigns the lights to the clusters of the camera frustum and writes the cluster lists into the buffers of the frame.
+		/// The camera needs a perspective projection.
+		/// Returns true if a buffer of the frame was reallocated, in which case the descriptors pointing at them have to be rewritten.
+		/// </summary>
+		bool update(uint32_t frameIndex, const Camera& camera, const std::vector<PointLight>& lights);
+
+		// Distance at which the light reaches zero.
+		static float lightRange(const PointLight& light);
+
+		// x is the depth slice scale, y the depth slice bias, so that slice = log(viewDepth) * x + y. z is LIGHT_CUTOFF.
+		inline const glm::vec4& getParameters() const { return parameters_; };
+		// Light indices written by the last update, a light counts once for every cluster it was assigned to.
+		inline uint32_t getAssignmentCount() const { return assignmentCount_; };
+
+		inline VkDescriptorBufferInfo clustersInfo(uint32_t frameIndex) const { return frames_[frameIndex].clusterBuffer->descriptorInfo(); };
+		inline VkDescriptorBufferInfo indicesInfo(uint32_t frameIndex) const { return frames_[frameIndex].indexBuffer->descriptorInfo(); };
+
+	private:
+		struct Assignment
+		{
+			uint32_t cluster;
+			uint32_t light;
+		};
+
+		// Persistently mapped buffers of one frame in flight.
+		struct FrameResources
+		{
+			std::unique_ptr<Buffer> clusterBuffer{};
+			std::unique_ptr<Buffer> indexBuffer{};
+		};
+
+		// View space bounding boxes of the clusters, stored as structure of arrays so several clusters of a row can be tested at a time.
+		// Padded by three clusters so the last row can be read four at a time.
+		struct ClusterBounds
+		{
+			std::vector<float> minX{};
+			std::vector<float> minY{};
+			std::vector<float> minZ{};
+			std::vector<float> maxX{};
+			std::vector<float> maxY{};
+			std::vector<float> maxZ{};
+		};
+
+		Device& device_;
+		JobSystem& jobSystem_;
+
+		std::vector<FrameResources> frames_;
+
+		ClusterBounds bounds_{};
+		// Projection the bounds were built for: near, far and the x and y projection scales.
+		glm::vec4 boundsProjection_{ 0.0f };
+		glm::vec4 parameters_{ 0.0f, 0.0f, LIGHT_CUTOFF, 0.0f };
+		uint32_t assignmentCount_ = 0;
+
+		// Scratch storage reused between frames to avoid reallocating every frame.
+		std::vector<std::vector<Assignment>> batchAssignments_{};
+		std::vector<uint32_t> clusterCursors_{};
+		std::vector<uint32_t> lightIndices_{};
+
+		void buildBounds(const Camera& camera);
+		void assignLights(const glm::mat4& view, const glm::mat4& projection, const std::vector<PointLight>& lights, uint32_t begin, uint32_t end, std::vector<Assignment>& assignments) const;
+		// Recreates the buffer with at least instanceCount instances if it is too small. Returns true if it did.
+		bool reserve(std::unique_ptr<Buffer>& buffer, VkDeviceSize instanceSize, uint32_t instanceCount, uint32_t minCapacity);
+	};
+}
+
+#endif /* PHM_LIGHT_CLUSTERS_H */
@@ -0,0 +1,97 @@
+#include "pch.h"
+
+#include "phm_lightRegistry.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace phm
+{
+	LightRegistry::LightRegistry(Device& device) :
+		device_(device),
+		frames_(Swapchain::MAX_FRAMES_IN_FLIGHT)
+	{
+		// The descriptors need valid buffers before the first upload.
+		for (uint32_t i = 0; i < frames_.size(); i++)
+			upload(i);
+	}
+
+	void LightRegistry::beginRegion(Region region)
+	{
+		assert((region == Region::Static || region_ == Region::Static) && "The static lights have to be submitted before the dynamic ones!");
+
+		region_ = region;
+		cursor_ = region == Region::Static ? 0 : staticCount_;
+	}
+
+	void LightRegistry::endRegion()
+	{
+		if (region_ == Region::Static)
+		{
+			staticCount_ = cursor_;
+			return;
+		}
+
+		// Lights past the cursor were removed, there is nothing to upload for them.
+		lights_.resize(cursor_);
+		states_.resize(cursor_);
+	}
+
+	void LightRegistry::markDirty(uint32_t slot)
+	{
+		// Every buffer has to receive the change, each one when its frame comes around.
+		for (FrameResources& frame : frames_)
+		{
+			DirtyRange& range = frame.dirty[static_cast<size_t>(region_)];
+			range.begin = std::min(range.begin, slot);
+			range.end = std::max(range.end, slot + 1);
+		}
+	}
+
+	bool LightRegistry::upload(uint32_t frameIndex)
+	{
+		FrameResources& frame = frames_[frameIndex];
+		const uint32_t lightCount = static_cast<uint32_t>(lights_.size());
+
+		bool reallocated = false;
+		if (!frame.lightBuffer || frame.lightBuffer->getInstanceCount() < lightCount)
+		{
+			// Grow geometrically so a slowly growing scene does not reallocate every frame.
+			uint32_t capacity = frame.lightBuffer ? frame.lightBuffer->getInstanceCount() : 256;
+			while (capacity < lightCount)
+				capacity *= 2;
+
+			frame.lightBuffer = std::make_unique<Buffer>(
+				device_,
+				sizeof(PointLight),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+				);
+			frame.lightBuffer->map();
+
+			// Nothing of the new buffer has been written yet.
+			frame.dirty[static_cast<size_t>(Region::Static)] = { 0, staticCount_ };
+			frame.dirty[static_cast<size_t>(Region::Dynamic)] = { staticCount_, lightCount };
+			reallocated = true;
+		}
+
+		uploadedCount_ = 0;
+		for (DirtyRange& range : frame.dirty)
+		{
+			const uint32_t end = std::min(range.end, lightCount);
+			if (range.begin < end)
+			{
+				const VkDeviceSize size = (end - range.begin) * sizeof(PointLight);
+				const VkDeviceSize offset = range.begin * sizeof(PointLight);
+				frame.lightBuffer->writeToBuffer(&lights_[range.begin], size, offset);
+				frame.lightBuffer->flush(size, offset);
+				uploadedCount_ += end - range.begin;
+			}
+
+			range = DirtyRange{};
+		}
+
+		return reallocated;
+	}
+}
@@ -0,0 +1,117 @@
+#ifndef PHM_LIGHT_REGISTRY_H
+#define PHM_LIGHT_REGISTRY_H
+
+#include <memory>
+#include <vector>
+
+#include "phm_device.h"
+#include "phm_buffer.h"
+#include "phm_swapchain.h"
+#include "phm_frame_info.h"
+#include "phm_entity.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Keeps the point lights of the scene in a host side list and in one light storage buffer per frame in flight,
+	/// and only uploads the lights that changed since a buffer was last written.
+	/// The lights are submitted in two passes every frame, static lights first, so the static lights fill the front of the list
+	/// and adding, removing or moving dynamic lights never shifts them.
+	/// A light is dirty if its entity, transform version or light version differs from what its slot was last written with.
+	/// Each buffer tracks one dirty range per region, which is written and flushed on its own.
+	/// </summary>
+	class LightRegistry
+	{
+	public:
+		enum class Region { Static, Dynamic, Count };
+
+		LightRegistry(Device& device);
+
+		LightRegistry(const LightRegistry&) = delete;
+		LightRegistry& operator=(const LightRegistry&) = delete;
+
+		/// <summary>
+		/// Starts a new pass over the lights of the region. The static region has to be submitted before the dynamic one.
+		/// </summary>
+		void beginRegion(Region region);
+		/// <summary>
+		/// Submits the next light of the current region, the data is only read if the light is dirty.
+		/// </summary>
+		template<typename GetLight>
+		void submit(ecs::EntityId entity, uint32_t transformVersion, uint32_t lightVersion, GetLight&& getLight)
+		{
+			const uint32_t slot = cursor_++;
+			const LightState state{ entity, transformVersion, lightVersion };
+			if (slot < states_.size())
+			{
+				LightState& written = states_[slot];
+				if (written.entity == state.entity && written.transformVersion == state.transformVersion && written.lightVersion == state.lightVersion)
+					return;
+
+				written = state;
+				lights_[slot] = getLight();
+			}
+			else
+			{
+				states_.push_back(state);
+				lights_.push_back(getLight());
+			}
+			markDirty(slot);
+		}
+		/// <summary>
+		/// Ends the pass over the current region. Ending the dynamic region drops the lights that were not submitted again.
+		/// </summary>
+		void endRegion();
+
+		/// <summary>
+		/// Writes the dirty ranges of the frame's light buffer. The fence of the frame has to have been waited on.
+		/// Returns true if the buffer was reallocated, in which case the descriptors pointing at it have to be rewritten.
+		/// </summary>
+		bool upload(uint32_t frameIndex);
+
+		inline const std::vector<PointLight>& getLights() const { return lights_; };
+		inline uint32_t getStaticCount() const { return staticCount_; };
+		// Lights written by the last upload.
+		inline uint32_t getUploadedCount() const { return uploadedCount_; };
+
+		inline VkDescriptorBufferInfo lightsInfo(uint32_t frameIndex) const { return frames_[frameIndex].lightBuffer->descriptorInfo(); };
+
+	private:
+		// What a slot of the light list was last written with.
+		struct LightState
+		{
+			ecs::EntityId entity{};
+			uint32_t transformVersion = 0;
+			uint32_t lightVersion = 0;
+		};
+
+		// Slots [begin, end) that changed since the buffer was last written.
+		struct DirtyRange
+		{
+			uint32_t begin = UINT32_MAX;
+			uint32_t end = 0;
+		};
+
+		struct FrameResources
+		{
+			std::unique_ptr<Buffer> lightBuffer{};
+			DirtyRange dirty[static_cast<size_t>(Region::Count)]{};
+		};
+
+		Device& device_;
+
+		std::vector<FrameResources> frames_;
+
+		std::vector<PointLight> lights_{};
+		std::vector<LightState> states_{};
+		uint32_t staticCount_ = 0;
+
+		Region region_ = Region::Static;
+		uint32_t cursor_ = 0;
+		uint32_t uploadedCount_ = 0;
+
+		void markDirty(uint32_t slot);
+	};
+}
+
+#endif /* PHM_LIGHT_REGISTRY_H */
@@ -4,17 +4,100 @@
 #include "phm_pointLightComponent.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
 
 namespace phm
 {
 	namespace ecs
 	{
-		Manager::Manager(Device& device, VkRenderPass renderPass, DescriptorPool* descriptorPool) :
+		// Submits the point lights of the scene to the light registry, which picks out the ones that changed.
+		class LightGatherSystem : public System
+		{
+		public:
+			LightGatherSystem(LightRegistry& registry) : System("Light gather"), registry_(registry)
+			{
+				readsComponents<Transform, PointlightComponent>();
+			}
+
+			void update(const SystemContext& context) override
+			{
+				// Static lights first, so they keep their place at the front of the light buffer.
+				for (const bool staticPass : { true, false })
+				{
+					registry_.beginRegion(staticPass ? LightRegistry::Region::Static : LightRegistry::Region::Dynamic);
+
+					context.view<Transform, PointlightComponent>().each([this, staticPass](Entity entity, const Transform& transform, const PointlightComponent& pointLight)
+						{
+							if (pointLight.isStatic() != staticPass)
+								return;
+
+							registry_.submit(entity.getId(), transform.getVersion(), pointLight.getVersion(), [&]()
+								{
+									return PointLight{ { transform.getTranslation(), pointLight.getRadius() }, pointLight.getColorIntensity() };
+								});
+						});
+
+					registry_.endRegion();
+				}
+			}
+
+		private:
+			LightRegistry& registry_;
+		};
+
+
+		// Keeps the spatial index in sync with the bounds of the renderable entities.
+		class SpatialIndexSystem : public System
+		{
+		public:
+			SpatialIndexSystem(SpatialIndex& index) : System("Spatial index"), index_(index)
+			{
+				readsComponents<Transform, ModelComponent>();
+			}
+
+			void update(const SystemContext& context) override
+			{
+				index_.beginUpdate();
+
+				context.view<Transform, ModelComponent>().each([this](Entity entity, const Transform& transform, const ModelComponent& modelComponent)
+					{
+						if (modelComponent.model == nullptr)
+							return;
+
+						const glm::mat4 modelMatrix = transform.mat4();
+						index_.update(
+							entity.getId(),
+							modelComponent.model->getBoundingBox().transformed(modelMatrix),
+							modelComponent.model->getBoundingSphere().transformed(modelMatrix));
+					});
+
+				// Removes the entities that were destroyed or lost their model.
+				index_.endUpdate();
+			}
+
+		private:
+			SpatialIndex& index_;
+		};
+
+
+		Manager::Manager(Device& device, VkRenderPass renderPass, DescriptorPool* descriptorPool, JobSystem& jobSystem) :
+			scheduler_(jobSystem),
+			lightRegistry_(device),
+			gpuDriven_(IndirectRenderSystem::isSupported(device)),
 			device_(device),
+			lightClusters_(device, jobSystem),
+			descriptorPool_(descriptorPool),
 			globalSetLayout_{ DescriptorSetLayout::Builder(device_)
 				.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+				.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+				.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+				.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
 				.build() },
 			simpleRenderSystem_{ device, renderPass, globalSetLayout_->getDescriptorSetLayout() },
+			indirectRenderSystem_{ device, renderPass, globalSetLayout_->getDescriptorSetLayout() },
 			pointLightSystem_{ device, renderPass, globalSetLayout_->getDescriptorSetLayout() }
 		{
 			// Initialize uniform buffers
@@ -29,83 +112,162 @@ namespace phm
 				bufferPtr->map();
 			}
 
+			frameUbo_.clusterGrid = { LightClusters::GRID_X, LightClusters::GRID_Y, LightClusters::GRID_Z, 0 };
+			for (uint32_t i = 0; i < uniformBuffers.size(); i++)
+			{
+				// Written whole once, after that only the parts that change.
+				uniformBuffers[i]->writeToBuffer(&frameUbo_, sizeof(GlobalUbo));
+				uniformBuffers[i]->flush(sizeof(GlobalUbo));
+				uploadedUbos_[i] = frameUbo_;
+			}
+
 			// initialize descriptor sets
-			for (size_t i = 0; i < globalDescriptorSets_.size(); i++)
+			for (uint32_t i = 0; i < globalDescriptorSets_.size(); i++)
 			{
-				auto bufferInfo = uniformBuffers[i]->descriptorInfo();
-				DescriptorWriter(*globalSetLayout_, *descriptorPool)
-					.writeBuffer(0, &bufferInfo)
-					.build(globalDescriptorSets_[i]);
+				writeGlobalDescriptorSet(i, false);
 			}
+
+			scheduler_.addSystem<LightGatherSystem>(SystemStage::PostUpdate, lightRegistry_);
+			scheduler_.addSystem<SpatialIndexSystem>(SystemStage::PostUpdate, spatialIndex_);
 		}
 
 		void Manager::update(const FrameInfo& frameInfo, const Renderer& renderer, GLFWwindow* window)
 		{
-			cameraController_.moveInPlaneXZ(window, frameInfo.deltaTime, *viewerEntity_);
-			activeCamera_->setViewYXZ(viewerEntity_->transform.translation, viewerEntity_->transform.rotation);
+			cameraController_.moveInPlaneXZ(window, frameInfo.deltaTime, viewerEntity_);
+			activeCamera_->setViewYXZ(viewerEntity_.transform().getTranslation(), viewerEntity_.transform().getRotation());
 
 			float aspect = renderer.getAspectRatio();
 			activeCamera_->setPerspectiveProjection(glm::radians(50.0f), aspect, 0.1f, 100.0f);
 
-			for (auto& e : entities_)
-				e->update();
+			// Run the scene systems
+			registerComponentUpdateSystems();
+			scheduler_.run(frameInfo, storage_);
 
 			// Update global uniform buffer 
 			// (THIS SHOULD ALWAYS BE DONE LAST, AS ENTITIES CAN CHANGE THE STATE OF THE UPDATED DATA, MAKING THE UBO BE OUT OF DATE FOR THE FRAME IN QUESTION)
-			GlobalUbo ubo{};
-			
-			// Update the lights in the scene
-			for (const auto& entity : entities_)
-			{
-				if (entity->hasComponent<PointlightComponent>())
-				{
-					assert(activeLights_ != MAX_LIGHTS && "Too many lights in the scene!");
+			GlobalUbo& ubo = frameUbo_;
+			activeLights_ = static_cast<uint32_t>(lightRegistry_.getLights().size());
 
-					const auto& pointLight = entity->getComponent<PointlightComponent>();
-					ubo.pointLights[ubo.activeLights].color = pointLight.getColorIntensity();
-					ubo.pointLights[ubo.activeLights].position = { entity->transform.translation, pointLight.getRadius() };
-					ubo.activeLights++;
-				}
-			}
-			activeLights_ = static_cast<uint32_t>(ubo.activeLights);
+			// The frame's fence has been waited on, so its buffers and descriptor set are free to be replaced.
+			bool reallocated = lightRegistry_.upload(frameInfo.frameIndex);
+			reallocated |= lightClusters_.update(frameInfo.frameIndex, *activeCamera_, lightRegistry_.getLights());
+			if (reallocated)
+				writeGlobalDescriptorSet(frameInfo.frameIndex, true);
+			renderStats_.uploadedLights = lightRegistry_.getUploadedCount();
 			
 			ubo.projection = activeCamera_->getProjection();
 			ubo.view = activeCamera_->getView();
 			ubo.inverseView = activeCamera_->getInverseView();
-			uniformBuffers[frameInfo.frameIndex]->writeToBuffer(&ubo);
-			uniformBuffers[frameInfo.frameIndex]->flush();
+			ubo.clusterParameters = lightClusters_.getParameters();
+			ubo.clusterGrid.w = activeLights_;
+			writeGlobalUbo(frameInfo.frameIndex);
 		}
 
-		void Manager::render(const FrameInfo& frameInfo, const Renderer& renderer) const
+		void Manager::prepareRender(const FrameInfo& frameInfo)
 		{
-			std::vector<Entity*> simpleEntities;
-			for (const auto& entity : entities_)
+			const auto start = std::chrono::steady_clock::now();
+
+			// On the GPU driven path only the entities the indirect draws can't handle are left to the instanced draws.
+			visibleEntities_.clear();
+			if (gpuDriven_)
 			{
-				if (entity->hasComponent<ModelComponent>())
-					simpleEntities.push_back(entity.get());
+				indirectRenderSystem_.cull(frameInfo, storage_, visibleEntities_);
+			}
+			else
+			{
+				const Frustum frustum = Frustum::fromMatrix(frameInfo.camera.getProjection() * frameInfo.camera.getView());
+				spatialIndex_.queryFrustum(frustum, visibleEntities_);
 			}
 
-			simpleRenderSystem_.renderObjects(frameInfo, simpleEntities, &globalDescriptorSets_[frameInfo.frameIndex]);
-			pointLightSystem_.renderObjects(frameInfo, &globalDescriptorSets_[frameInfo.frameIndex], activeLights_);
+			renderStats_.cpuMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
 		}
 
-		void Manager::refresh()
+		void Manager::render(const FrameInfo& frameInfo, const Renderer& renderer)
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			simpleRenderSystem_.renderObjects(frameInfo, storage_, visibleEntities_, &globalDescriptorSets_[frameInfo.frameIndex], renderStats_);
+			renderStats_.visibleObjects = static_cast<uint32_t>(visibleEntities_.size());
+			if (gpuDriven_)
+				indirectRenderSystem_.renderObjects(frameInfo, &globalDescriptorSets_[frameInfo.frameIndex], renderStats_);
+
+			// The GPU counts lag a few frames behind, so they can exceed the current number of objects.
+			renderStats_.culledObjects = spatialIndex_.size() - std::min(renderStats_.visibleObjects, spatialIndex_.size());
+
+			pointLightSystem_.renderObjects(frameInfo, &globalDescriptorSets_[frameInfo.frameIndex], lightRegistry_.getLights(), renderStats_);
+
+			renderStats_.cpuMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		void Manager::registerComponentUpdateSystems()
+		{
+			// Component types are registered lazily, so new types with an update can show up at any time.
+			for (ComponentTypeID id = 0; id < maxComponents; id++)
+			{
+				if (componentUpdateSystems_[id] || getComponentInfo(id).update == nullptr)
+					continue;
+
+				scheduler_.addSystem<ComponentUpdateSystem>(SystemStage::Update, id);
+				componentUpdateSystems_.set(id);
+			}
+		}
+
+		void Manager::writeGlobalUbo(uint32_t frameIndex)
 		{
-			entities_.erase(std::remove_if(entities_.begin(), entities_.end(),
-				[](const std::unique_ptr<Entity>& e)
+			GlobalUbo& uploaded = uploadedUbos_[frameIndex];
+
+			// The camera changes whenever the viewer moves, the rest of the ubo hardly ever.
+			auto writeRange = [&](size_t offset, size_t size)
 				{
-					return e->isAlive();
-				}),
-				entities_.end());
+					char* source = reinterpret_cast<char*>(&frameUbo_) + offset;
+					char* written = reinterpret_cast<char*>(&uploaded) + offset;
+					if (std::memcmp(source, written, size) == 0)
+						return;
+
+					uniformBuffers[frameIndex]->writeToBuffer(source, size, offset);
+					uniformBuffers[frameIndex]->flush(size, offset);
+					std::memcpy(written, source, size);
+				};
+
+			writeRange(offsetof(GlobalUbo, projection), offsetof(GlobalUbo, ambientLightColor) - offsetof(GlobalUbo, projection));
+			writeRange(offsetof(GlobalUbo, ambientLightColor), sizeof(GlobalUbo) - offsetof(GlobalUbo, ambientLightColor));
 		}
 
-		Entity& Manager::addEntity()
+		void Manager::writeGlobalDescriptorSet(uint32_t frameIndex, bool overwrite)
 		{
-			Entity* e = new Entity();
-			std::unique_ptr<Entity> uPtr{ e };
-			entities_.emplace_back(std::move(uPtr));
-			return *e;
+			auto bufferInfo = uniformBuffers[frameIndex]->descriptorInfo();
+			auto lightsInfo = lightRegistry_.lightsInfo(frameIndex);
+			auto clustersInfo = lightClusters_.clustersInfo(frameIndex);
+			auto indicesInfo = lightClusters_.indicesInfo(frameIndex);
+
+			DescriptorWriter writer(*globalSetLayout_, *descriptorPool_);
+			writer.writeBuffer(0, &bufferInfo)
+				.writeBuffer(1, &lightsInfo)
+				.writeBuffer(2, &clustersInfo)
+				.writeBuffer(3, &indicesInfo);
+
+			if (overwrite)
+				writer.overwrite(globalDescriptorSets_[frameIndex]);
+			else
+				writer.build(globalDescriptorSets_[frameIndex]);
+		}
+
+		void Manager::refresh()
+		{
+			storage_.flushDestroyed();
+		}
+
+		Entity Manager::pick(const Ray& ray, float maxDistance)
+		{
+			const EntityId hit = spatialIndex_.raycast(ray, maxDistance);
+			return hit.isNull() ? Entity{} : Entity{ storage_, hit };
+		}
+
+		Entity Manager::addEntity()
+		{
+			Entity entity{ storage_, storage_.createEntity() };
+			entity.addComponent<Transform>();
+			return entity;
 		}
 	}
 }
-
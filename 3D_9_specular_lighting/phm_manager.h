@@ -4,6 +4,13 @@
 #include <memory>
 
 #include "phm_entity.h"
+#include "phm_archetype.h"
+#include "phm_view.h"
+#include "phm_scheduler.h"
+#include "phm_jobSystem.h"
+#include "phm_spatialIndex.h"
+#include "phm_lightClusters.h"
+#include "phm_lightRegistry.h"
 
 #include "phm_device.h"
 #include "phm_frame_info.h"
@@ -12,6 +19,7 @@
 #include "phm_buffer.h"
 
 #include "simple_render_system.h"
+#include "indirect_render_system.h"
 #include "point_light_system.h"
 
 #include "phm_keyboardController.h"
@@ -24,52 +32,92 @@ namespace phm
 		class Manager
 		{
 		public:
-			Manager(Device& device, VkRenderPass renderPass, DescriptorPool* descriptorPool);
+			Manager(Device& device, VkRenderPass renderPass, DescriptorPool* descriptorPool, JobSystem& jobSystem);
 
 			void update(const FrameInfo& frameInfo, const Renderer& renderer, GLFWwindow* window);
-			void render(const FrameInfo& frameInfo, const Renderer& renderer) const;
+			// Culls the scene. Records the GPU culling pass, so it has to be called outside of the render pass, before render.
+			void prepareRender(const FrameInfo& frameInfo);
+			void render(const FrameInfo& frameInfo, const Renderer& renderer);
 
 			void refresh();
 
-			Entity& addEntity();
+			Entity addEntity();
+
+			// Returns a view over all entities that have the components Ts.
+			template<typename... Ts>
+			inline View<Ts...> view() { return View<Ts...>(storage_); };
+
+			inline const RenderStats& getRenderStats() const { return renderStats_; };
+
+			// Culls and draws the objects on the GPU with indirect draws, or walks them on the CPU with instanced draws.
+			// Enabled by default if the device supports it.
+			inline bool isGpuDriven() const { return gpuDriven_; };
+			inline void setGpuDriven(bool enabled) { gpuDriven_ = enabled && IndirectRenderSystem::isSupported(device_); };
+			inline const SpatialIndex& getSpatialIndex() const { return spatialIndex_; };
+
+			// Returns the renderable entity hit first by the ray, or an invalid entity.
+			Entity pick(const Ray& ray, float maxDistance = 1000.0f);
 
 			inline void setCamera(Camera* camera)
 			{
 				assert(camera != nullptr && "Camera is nullptr!");
 				activeCamera_ = camera;
 			};
-			inline void setViewerEntity(Entity* entity)
+			inline void setViewerEntity(Entity entity)
 			{
-				assert(entity != nullptr && "Viewer entity is nullptr!");
+				assert(entity.isValid() && "Viewer entity is not a valid entity!");
 				viewerEntity_ = entity;
 			};
 
 		private:
-			std::vector<std::unique_ptr<Entity>> entities_{};
+			// Component data of all entities.
+			ArchetypeStorage storage_{};
+
+			// Systems
+			SystemScheduler scheduler_;
+			ComponentBitSet componentUpdateSystems_{};
+			// Written by the systems during the update
+			GlobalUbo frameUbo_{};
+			LightRegistry lightRegistry_;
+			SpatialIndex spatialIndex_{};
 
 			// Scene information
 			Camera* activeCamera_;
-			Entity* viewerEntity_;
+			Entity viewerEntity_{};
 
 			uint32_t activeLights_ = 0;
+			std::vector<EntityId> visibleEntities_{};
+			RenderStats renderStats_{};
+			bool gpuDriven_;
 
 			// Vulkan references
 			Device& device_;
 
-			// Uniform buffers
+			// Uniform buffers, and what each of them was last written with
 			std::vector<std::unique_ptr<Buffer>> uniformBuffers{ Swapchain::MAX_FRAMES_IN_FLIGHT };
+			std::vector<GlobalUbo> uploadedUbos_{ Swapchain::MAX_FRAMES_IN_FLIGHT };
+			// Light storage buffers, bound to the global set next to the uniform buffer
+			LightClusters lightClusters_;
 
 			// Descriptor sets
+			DescriptorPool* descriptorPool_;
 			std::unique_ptr<DescriptorSetLayout> globalSetLayout_;
 
 			std::vector<VkDescriptorSet> globalDescriptorSets_{ Swapchain::MAX_FRAMES_IN_FLIGHT };
 
 			// Render Systems
 			SimpleRenderSystem simpleRenderSystem_;
+			IndirectRenderSystem indirectRenderSystem_;
 			PointLightSystem pointLightSystem_;
 
 			// Scene update members
 			KeyboardController cameraController_{};
+
+			void registerComponentUpdateSystems();
+			// Writes the parts of the frame's uniform buffer that differ from frameUbo_.
+			void writeGlobalUbo(uint32_t frameIndex);
+			// Points the global descriptor set of the frame at the uniform buffer and the light buffers of the frame.
+			void writeGlobalDescriptorSet(uint32_t frameIndex, bool overwrite);
 		};
 	}
 }
@@ -0,0 +1,44 @@
+#ifndef PHM_MAPPED_FILE_H
+#define PHM_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace phm
+{
+	/// <summary>
+	/// Read only memory mapping of a whole file. The data stays valid for the lifetime of the object.
+	/// </summary>
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		/// <summary>
+		/// Maps the file. Returns false if it doesn't exist or can't be mapped.
+		/// </summary>
+		bool open(const std::string& path);
+		void close();
+
+		inline bool isOpen() const { return data_ != nullptr; };
+		inline const std::byte* data() const { return data_; };
+		inline size_t size() const { return size_; };
+
+	private:
+		const std::byte* data_ = nullptr;
+		size_t size_ = 0;
+
+#ifdef _WIN32
+		void* file_ = nullptr;
+		void* mapping_ = nullptr;
+#endif
+	};
+}
+
+#endif /* PHM_MAPPED_FILE_H */
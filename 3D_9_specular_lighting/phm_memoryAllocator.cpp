@@ -0,0 +1,251 @@
+#include "pch.h"
+
+#include "phm_memoryAllocator.h"
+
+#include <algorithm>
+
+namespace phm
+{
+	MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize)
+		: device_(device), preferredBlockSize_(preferredBlockSize)
+	{
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties_);
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		nonCoherentAtomSize_ = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+	}
+
+	MemoryAllocator::~MemoryAllocator()
+	{
+		for (Pool& pool : pools_)
+		{
+			for (auto& block : pool.blocks)
+			{
+				assert(block->ranges.isEmpty() && "Device memory is still in use while destroying the allocator!");
+				freeDeviceMemory(block->memory, block->mapped);
+			}
+		}
+
+		assert(dedicatedAllocationCount_ == 0 && "Dedicated device memory is still in use while destroying the allocator!");
+	}
+
+	/// <summary>
+	/// Allocates memory for a resource. Large resources get their own VkDeviceMemory, the rest is sub-allocated from a block.
+	/// </summary>
+	/// <param name="requirements">: The memory requirements of the buffer or image. </param>
+	/// <param name="memoryTypeIndex">: The memory type to allocate from. </param>
+	/// <param name="resourceType">: Whether the resource is linear (buffers) or optimal (images). </param>
+	/// <returns>The allocation. Throws if the device is out of memory. </returns>
+	MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, ResourceType resourceType)
+	{
+		assert(memoryTypeIndex < memoryProperties_.memoryTypeCount && "Invalid memory type index!");
+
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		MemoryAllocation allocation{};
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.size = requirements.size;
+
+		// Resources larger than half a block would waste most of it.
+		const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+		if (requirements.size > blockSize / 2)
+		{
+			allocation.memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, &allocation.mapped);
+			dedicatedAllocationCount_++;
+			dedicatedBytes_ += requirements.size;
+			return allocation;
+		}
+
+		Pool& pool = pools_[memoryTypeIndex * 2 + static_cast<uint32_t>(resourceType)];
+
+		// Try the newest blocks first, the older ones tend to be fuller.
+		for (auto it = pool.blocks.rbegin(); it != pool.blocks.rend(); ++it)
+		{
+			MemoryBlock& block = **it;
+			const RangeAllocator::Allocation range = block.ranges.allocate(requirements.size, requirements.alignment);
+			if (!range.isValid())
+				continue;
+
+			allocation.memory = block.memory;
+			allocation.offset = range.offset;
+			allocation.block = &block;
+			allocation.rangeHandle = range.handle;
+			if (block.mapped != nullptr)
+				allocation.mapped = static_cast<char*>(block.mapped) + range.offset;
+			return allocation;
+		}
+
+		// No block has room left, create a new one.
+		auto block = std::make_unique<MemoryBlock>(blockSize);
+		block->memory = allocateDeviceMemory(blockSize, memoryTypeIndex, &block->mapped);
+
+		const RangeAllocator::Allocation range = block->ranges.allocate(requirements.size, requirements.alignment);
+		assert(range.isValid() && "A new block must fit the allocation!");
+
+		allocation.memory = block->memory;
+		allocation.offset = range.offset;
+		allocation.block = block.get();
+		allocation.rangeHandle = range.handle;
+		if (block->mapped != nullptr)
+			allocation.mapped = static_cast<char*>(block->mapped) + range.offset;
+
+		DebugPrint("Allocated device memory block of " << blockSize << " bytes for memory type " << memoryTypeIndex);
+
+		pool.blocks.push_back(std::move(block));
+		return allocation;
+	}
+
+	/// <summary>
+	/// Returns the memory of an allocation. The allocation is reset afterwards.
+	/// </summary>
+	void MemoryAllocator::free(MemoryAllocation& allocation)
+	{
+		if (!allocation.isValid())
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (allocation.block == nullptr)
+		{
+			freeDeviceMemory(allocation.memory, allocation.mapped);
+			dedicatedAllocationCount_--;
+			dedicatedBytes_ -= allocation.size;
+			allocation = {};
+			return;
+		}
+
+		MemoryBlock* block = allocation.block;
+		block->ranges.free(allocation.rangeHandle);
+
+		// Keep one empty block around, so a resource that is recreated every frame doesn't allocate a block every time.
+		if (block->ranges.isEmpty())
+		{
+			for (Pool& pool : pools_)
+			{
+				auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const auto& b) { return b.get() == block; });
+				if (it == pool.blocks.end())
+					continue;
+
+				const bool hasOtherEmptyBlock = std::any_of(pool.blocks.begin(), pool.blocks.end(),
+					[block](const auto& b) { return b.get() != block && b->ranges.isEmpty(); });
+
+				if (hasOtherEmptyBlock)
+				{
+					freeDeviceMemory(block->memory, block->mapped);
+					pool.blocks.erase(it);
+				}
+				break;
+			}
+		}
+
+		allocation = {};
+	}
+
+	VkResult MemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (memoryProperties_.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+			return VK_SUCCESS;
+
+		const VkMappedMemoryRange range = getMappedRange(allocation, size, offset);
+		return vkFlushMappedMemoryRanges(device_, 1, &range);
+	}
+
+	VkResult MemoryAllocator::invalidate(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (memoryProperties_.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+			return VK_SUCCESS;
+
+		const VkMappedMemoryRange range = getMappedRange(allocation, size, offset);
+		return vkInvalidateMappedMemoryRanges(device_, 1, &range);
+	}
+
+	MemoryStatistics MemoryAllocator::getStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		MemoryStatistics statistics{};
+		statistics.dedicatedAllocationCount = dedicatedAllocationCount_;
+		statistics.allocationCount = dedicatedAllocationCount_;
+		statistics.blockBytes = dedicatedBytes_;
+		statistics.usedBytes = dedicatedBytes_;
+
+		for (const Pool& pool : pools_)
+		{
+			for (const auto& block : pool.blocks)
+			{
+				const RangeAllocator& ranges = block->ranges;
+
+				statistics.blockCount++;
+				statistics.allocationCount += ranges.getAllocationCount();
+				statistics.freeRangeCount += ranges.getFreeRangeCount();
+				statistics.blockBytes += ranges.getSize();
+				statistics.usedBytes += ranges.getSize() - ranges.getFreeSize();
+				statistics.largestFreeRange = std::max(statistics.largestFreeRange, ranges.getLargestFreeRange());
+			}
+		}
+
+		return statistics;
+	}
+
+	VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const
+	{
+		// Small heaps (like the 256MB device local host visible heap) get smaller blocks, so a few blocks can't fill them.
+		const uint32_t heapIndex = memoryProperties_.memoryTypes[memoryTypeIndex].heapIndex;
+		const VkDeviceSize heapSize = memoryProperties_.memoryHeaps[heapIndex].size;
+		return std::min(preferredBlockSize_, heapSize / 8);
+	}
+
+	bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const
+	{
+		return memoryProperties_.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	}
+
+	VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped)
+	{
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(device_, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate device memory!");
+		}
+
+		*mapped = nullptr;
+		if (isHostVisible(memoryTypeIndex) && vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS)
+		{
+			vkFreeMemory(device_, memory, nullptr);
+			throw std::runtime_error("failed to map device memory!");
+		}
+
+		return memory;
+	}
+
+	void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, void* mapped)
+	{
+		if (mapped != nullptr)
+			vkUnmapMemory(device_, memory);
+
+		vkFreeMemory(device_, memory, nullptr);
+	}
+
+	VkMappedMemoryRange MemoryAllocator::getMappedRange(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const
+	{
+		// Ranges of non coherent memory have to be aligned to nonCoherentAtomSize.
+		const VkDeviceSize memorySize = allocation.block != nullptr ? allocation.block->ranges.getSize() : allocation.size;
+		const VkDeviceSize begin = allocation.offset + offset;
+		const VkDeviceSize end = allocation.offset + (size == VK_WHOLE_SIZE ? allocation.size : offset + size);
+
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = allocation.memory;
+		range.offset = begin / nonCoherentAtomSize_ * nonCoherentAtomSize_;
+
+		const VkDeviceSize alignedEnd = (end + nonCoherentAtomSize_ - 1) / nonCoherentAtomSize_ * nonCoherentAtomSize_;
+		range.size = alignedEnd >= memorySize ? VK_WHOLE_SIZE : alignedEnd - range.offset;
+		return range;
+	}
+}
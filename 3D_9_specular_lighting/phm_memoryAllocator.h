@@ -0,0 +1,121 @@
+#ifndef PHM_MEMORY_ALLOCATOR_H
+#define PHM_MEMORY_ALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "phm_rangeAllocator.h"
+
+namespace phm
+{
+	/// <summary>
+	/// A large VkDeviceMemory that resources are sub-allocated from.
+	/// </summary>
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		RangeAllocator ranges;
+
+		MemoryBlock(VkDeviceSize size) : ranges(size) {};
+	};
+
+	/// <summary>
+	/// A range of device memory handed out by the MemoryAllocator.
+	/// </summary>
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+
+		// Start of the allocation in host memory, if the memory is host visible.
+		void* mapped = nullptr;
+
+		// Owning block, nullptr for dedicated allocations.
+		MemoryBlock* block = nullptr;
+		uint32_t rangeHandle = RangeAllocator::INVALID_HANDLE;
+		uint32_t memoryTypeIndex = 0;
+
+		inline bool isValid() const { return memory != VK_NULL_HANDLE; };
+	};
+
+	/// <summary>
+	/// Allocation statistics, summed over all memory types.
+	/// </summary>
+	struct MemoryStatistics
+	{
+		uint32_t blockCount = 0;
+		uint32_t dedicatedAllocationCount = 0;
+		uint32_t allocationCount = 0;
+		uint32_t freeRangeCount = 0;
+
+		VkDeviceSize blockBytes = 0;		// Memory allocated from the driver
+		VkDeviceSize usedBytes = 0;			// Memory handed out to resources
+		VkDeviceSize largestFreeRange = 0;
+	};
+
+	/// <summary>
+	/// Sub-allocates buffers and images from large blocks of device memory, instead of calling vkAllocateMemory for each resource.
+	/// Every memory type has separate pools for linear (buffer) and optimal (image) resources, so bufferImageGranularity never has to be respected inside a block.
+	/// Host visible blocks stay mapped for their whole lifetime, since a VkDeviceMemory can only be mapped once.
+	/// </summary>
+	class MemoryAllocator
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+		enum class ResourceType { Linear, Optimal };
+
+		MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+		~MemoryAllocator();
+
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+		MemoryAllocation allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, ResourceType resourceType);
+		void free(MemoryAllocation& allocation);
+
+		/// <summary>
+		/// Flush or invalidate a range of the allocation. Offset is relative to the allocation, VK_WHOLE_SIZE covers the rest of it.
+		/// Does nothing for host coherent memory.
+		/// </summary>
+		VkResult flush(const MemoryAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult invalidate(const MemoryAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+		MemoryStatistics getStatistics();
+
+	private:
+		struct Pool
+		{
+			std::vector<std::unique_ptr<MemoryBlock>> blocks{};
+		};
+
+		VkDevice device_;
+		VkPhysicalDeviceMemoryProperties memoryProperties_{};
+		VkDeviceSize nonCoherentAtomSize_ = 1;
+		VkDeviceSize preferredBlockSize_;
+
+		// Indexed by memoryTypeIndex * 2 + resource type
+		Pool pools_[VK_MAX_MEMORY_TYPES * 2]{};
+
+		uint32_t dedicatedAllocationCount_ = 0;
+		VkDeviceSize dedicatedBytes_ = 0;
+
+		std::mutex mutex_;
+
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+		bool isHostVisible(uint32_t memoryTypeIndex) const;
+
+		// Allocates and maps (if host visible) a VkDeviceMemory.
+		VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped);
+		void freeDeviceMemory(VkDeviceMemory memory, void* mapped);
+
+		VkMappedMemoryRange getMappedRange(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const;
+	};
+}
+
+#endif /* PHM_MEMORY_ALLOCATOR_H */
@@ -0,0 +1,164 @@
+#include "pch.h"
+
+#include "phm_meshCache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace phm
+{
+	// FNV-1a
+	static uint64_t hashPath(const std::string& path)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : path)
+		{
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static std::string normalizePath(std::string_view path)
+	{
+		return fs::path(path).lexically_normal().generic_string();
+	}
+
+	static bool getSourceKey(std::string_view sourcePath, uint64_t& size, int64_t& time)
+	{
+		std::error_code error;
+		const fs::path path(sourcePath);
+
+		size = static_cast<uint64_t>(fs::file_size(path, error));
+		if (error)
+			return false;
+
+		time = static_cast<int64_t>(fs::last_write_time(path, error).time_since_epoch().count());
+		return !error;
+	}
+
+	static inline uint64_t alignStream(uint64_t offset)
+	{
+		return (offset + MeshCache::STREAM_ALIGNMENT - 1) / MeshCache::STREAM_ALIGNMENT * MeshCache::STREAM_ALIGNMENT;
+	}
+
+
+	MeshCache::MappedMesh::MappedMesh(MappedFile&& file)
+		: file_(std::move(file)), header_(reinterpret_cast<const Header*>(file_.data()))
+	{
+	}
+
+	std::unique_ptr<MeshCache::MappedMesh> MeshCache::load(std::string_view sourcePath)
+	{
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		if (!getSourceKey(sourcePath, sourceSize, sourceTime))
+			return nullptr;
+
+		MappedFile file{};
+		if (!file.open(getCachePath(sourcePath)) || file.size() < sizeof(Header))
+			return nullptr;
+
+		// Reject stale entries and files written by a different version or vertex layout.
+		const Header& header = *reinterpret_cast<const Header*>(file.data());
+		if (header.magic != MAGIC ||
+			header.version != VERSION ||
+			header.vertexStride != sizeof(Model::Vertex) ||
+			header.pathHash != hashPath(normalizePath(sourcePath)) ||
+			header.sourceSize != sourceSize ||
+			header.sourceTime != sourceTime)
+		{
+			return nullptr;
+		}
+
+		const uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * sizeof(Model::Vertex);
+		const uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t);
+		const uint64_t lodBytes = static_cast<uint64_t>(header.lodCount) * sizeof(Model::LodRange);
+		if (header.vertexOffset % STREAM_ALIGNMENT != 0 || header.indexOffset % STREAM_ALIGNMENT != 0 || header.lodOffset % STREAM_ALIGNMENT != 0 ||
+			header.vertexOffset + vertexBytes > file.size() || header.indexOffset + indexBytes > file.size() || header.lodOffset + lodBytes > file.size())
+		{
+			return nullptr;
+		}
+
+		// Every level of detail has to lie within the index stream.
+		const Model::LodRange* lods = reinterpret_cast<const Model::LodRange*>(file.data() + header.lodOffset);
+		for (uint32_t i = 0; i < header.lodCount; i++)
+		{
+			if (static_cast<uint64_t>(lods[i].firstIndex) + lods[i].indexCount > header.indexCount)
+				return nullptr;
+		}
+
+		return std::make_unique<MappedMesh>(std::move(file));
+	}
+
+	bool MeshCache::store(std::string_view sourcePath, const Model::Builder& builder)
+	{
+		Header header{};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.vertexStride = sizeof(Model::Vertex);
+		header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+		header.indexCount = static_cast<uint32_t>(builder.indices.size());
+		header.lodCount = static_cast<uint32_t>(builder.lods.size());
+		header.pathHash = hashPath(normalizePath(sourcePath));
+
+		if (!getSourceKey(sourcePath, header.sourceSize, header.sourceTime))
+			return false;
+
+		const uint64_t vertexBytes = builder.vertices.size() * sizeof(Model::Vertex);
+		header.vertexOffset = alignStream(sizeof(Header));
+		const uint64_t indexBytes = builder.indices.size() * sizeof(uint32_t);
+		header.indexOffset = alignStream(header.vertexOffset + vertexBytes);
+		header.lodOffset = alignStream(header.indexOffset + indexBytes);
+
+		const fs::path cachePath = getCachePath(sourcePath);
+		std::error_code error;
+		fs::create_directories(cachePath.parent_path(), error);
+
+		// Write to a temporary file first, so a crash never leaves a half written cache entry behind.
+		fs::path temporaryPath = cachePath;
+		temporaryPath += ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file)
+				return false;
+
+			const char padding[STREAM_ALIGNMENT]{};
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			file.write(padding, header.vertexOffset - sizeof(Header));
+			file.write(reinterpret_cast<const char*>(builder.vertices.data()), vertexBytes);
+			file.write(padding, header.indexOffset - header.vertexOffset - vertexBytes);
+			file.write(reinterpret_cast<const char*>(builder.indices.data()), indexBytes);
+			file.write(padding, header.lodOffset - header.indexOffset - indexBytes);
+			file.write(reinterpret_cast<const char*>(builder.lods.data()), builder.lods.size() * sizeof(Model::LodRange));
+
+			if (!file)
+				return false;
+		}
+
+		fs::rename(temporaryPath, cachePath, error);
+		if (error)
+		{
+			fs::remove(temporaryPath, error);
+			return false;
+		}
+
+		DebugPrint("Wrote mesh cache: " << cachePath.generic_string());
+		return true;
+	}
+
+	std::string MeshCache::getCachePath(std::string_view sourcePath)
+	{
+		const std::string normalized = normalizePath(sourcePath);
+
+		std::stringstream name;
+		name << fs::path(normalized).stem().string() << "_" << std::hex << std::setw(16) << std::setfill('0') << hashPath(normalized) << ".mesh";
+
+		return (fs::path(CACHE_DIRECTORY) / name.str()).generic_string();
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef PHM_MESH_CACHE_H
+#define PHM_MESH_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "phm_model.h"
+#include "phm_mappedFile.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Binary cache of parsed meshes, so model files only have to be parsed once.
+	/// A cache file is a header followed by the vertex, index and level of detail streams, each aligned to STREAM_ALIGNMENT,
+	/// so the streams can be used straight from the memory mapped file.
+	/// Cache files are keyed by the source path and invalidated when the size or modification time of the source changes.
+	/// </summary>
+	class MeshCache
+	{
+	public:
+		static constexpr uint32_t MAGIC = 0x4D4D4850; // "PHMM"
+		// Version 2: the meshes are stored optimized by MeshOptimizer.
+		// Version 3: levels of detail generated by MeshSimplifier.
+		static constexpr uint32_t VERSION = 3;
+		static constexpr uint64_t STREAM_ALIGNMENT = 64;
+		static constexpr const char* CACHE_DIRECTORY = "cache/meshes";
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vertexStride;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t lodCount;
+
+			// Key of the source file
+			uint64_t pathHash;
+			uint64_t sourceSize;
+			int64_t sourceTime;
+
+			uint64_t vertexOffset;
+			uint64_t indexOffset;
+			uint64_t lodOffset;
+		};
+
+		/// <summary>
+		/// A cached mesh mapped into memory.
+		/// </summary>
+		class MappedMesh
+		{
+		public:
+			MappedMesh(MappedFile&& file);
+
+			inline const Model::Vertex* getVertices() const { return reinterpret_cast<const Model::Vertex*>(file_.data() + header_->vertexOffset); };
+			inline const uint32_t* getIndices() const { return reinterpret_cast<const uint32_t*>(file_.data() + header_->indexOffset); };
+			inline uint32_t getVertexCount() const { return header_->vertexCount; };
+			inline uint32_t getIndexCount() const { return header_->indexCount; };
+			inline const Model::LodRange* getLods() const { return reinterpret_cast<const Model::LodRange*>(file_.data() + header_->lodOffset); };
+			inline uint32_t getLodCount() const { return header_->lodCount; };
+
+		private:
+			MappedFile file_;
+			const Header* header_;
+		};
+
+		/// <summary>
+		/// Maps the cached mesh of the source file. Returns nullptr if there is no up to date cache entry.
+		/// </summary>
+		static std::unique_ptr<MappedMesh> load(std::string_view sourcePath);
+
+		/// <summary>
+		/// Writes the mesh of the source file to the cache. Failing to write the cache is not an error.
+		/// </summary>
+		static bool store(std::string_view sourcePath, const Model::Builder& builder);
+
+		static std::string getCachePath(std::string_view sourcePath);
+	};
+}
+
+#endif /* PHM_MESH_CACHE_H */
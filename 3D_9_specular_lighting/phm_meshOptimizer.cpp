@@ -0,0 +1,274 @@
+#include "pch.h"
+
+#include "phm_meshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace phm
+{
+	void MeshOptimizer::optimize(Model::Builder& builder)
+	{
+		std::vector<Model::Vertex>& vertices = builder.vertices;
+		std::vector<uint32_t>& indices = builder.indices;
+
+		if (indices.size() < 3 || indices.size() % 3 != 0)
+			return;
+
+#ifdef DEBUGADDITIONAL
+		// The analysis is only worth its cost when it is printed.
+		const CacheStatistics before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+#endif // DEBUGADDITIONAL
+
+		const std::vector<uint32_t> clusters = optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+		optimizeOverdraw(indices.data(), indices.size(), vertices.data(), clusters);
+		optimizeVertexFetch(vertices, indices);
+
+#ifdef DEBUGADDITIONAL
+		const CacheStatistics after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+		DebugPrint("Optimized mesh: ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr
+			<< ", " << clusters.size() << " clusters");
+#endif // DEBUGADDITIONAL
+	}
+
+	MeshOptimizer::CacheStatistics MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		CacheStatistics statistics{};
+		if (indexCount < 3 || vertexCount == 0)
+			return statistics;
+
+		// A vertex is in the cache if it entered the FIFO less than cacheSize misses ago.
+		std::vector<uint64_t> cacheTime(vertexCount, 0);
+		std::vector<bool> used(vertexCount, false);
+		uint64_t misses = 0;
+		size_t usedVertices = 0;
+
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			const uint32_t vertex = indices[i];
+			if (cacheTime[vertex] == 0 || misses - cacheTime[vertex] >= cacheSize)
+			{
+				misses++;
+				cacheTime[vertex] = misses;
+			}
+
+			if (!used[vertex])
+			{
+				used[vertex] = true;
+				usedVertices++;
+			}
+		}
+
+		statistics.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+		statistics.atvr = static_cast<float>(misses) / static_cast<float>(usedVertices);
+		return statistics;
+	}
+
+	std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		const size_t triangleCount = indexCount / 3;
+
+		// Triangles of every vertex, as offsets into one adjacency array
+		std::vector<uint32_t> liveTriangles(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; i++)
+			liveTriangles[indices[i]]++;
+
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+		std::vector<uint32_t> adjacency(indexCount);
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < indexCount; i++)
+				adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<uint32_t> output{};
+		output.reserve(indexCount);
+
+		std::vector<uint32_t> clusters{ 0 };
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnds{};
+		std::vector<uint32_t> candidates{};
+
+		uint32_t time = cacheSize + 1;
+		size_t cursor = 0;
+
+		// Restarts from a recently used vertex that still has triangles, or the next such vertex in input order.
+		auto skipDeadEnd = [&]() -> int64_t
+		{
+			while (!deadEnds.empty())
+			{
+				const uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0)
+					return vertex;
+			}
+
+			for (; cursor < vertexCount; cursor++)
+			{
+				if (liveTriangles[cursor] > 0)
+					return static_cast<int64_t>(cursor);
+			}
+
+			return -1;
+		};
+
+		int64_t fanningVertex = vertexCount > 0 ? skipDeadEnd() : -1;
+		while (fanningVertex >= 0)
+		{
+			// Clusters end at dead ends, and are capped in size so a connected mesh still gives the overdraw pass something to sort
+			const size_t clusterSize = output.size() - clusters.back();
+			if (clusterSize > 0 && (candidates.empty() || clusterSize >= CLUSTER_TRIANGLES * 3))
+				clusters.push_back(static_cast<uint32_t>(output.size()));
+
+			candidates.clear();
+
+			// Emit all remaining triangles around the fanning vertex
+			for (uint32_t a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[fanningVertex + 1]; a++)
+			{
+				const uint32_t triangle = adjacency[a];
+				if (emitted[triangle])
+					continue;
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const uint32_t vertex = indices[triangle * 3 + corner];
+					output.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					liveTriangles[vertex]--;
+
+					if (time - cacheTime[vertex] > cacheSize)
+						cacheTime[vertex] = time++;
+				}
+
+				emitted[triangle] = true;
+			}
+
+			// Continue with the candidate that will still be in the cache after its remaining triangles are emitted, preferring the oldest
+			int64_t next = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (liveTriangles[vertex] == 0)
+					continue;
+
+				int64_t priority = 0;
+				if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+					priority = time - cacheTime[vertex];
+
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = vertex;
+				}
+			}
+
+			// A dead end breaks the locality, so a new cluster starts
+			if (next == -1)
+			{
+				next = skipDeadEnd();
+				candidates.clear();
+			}
+
+			fanningVertex = next;
+		}
+
+		std::copy(output.begin(), output.end(), indices);
+		return clusters;
+	}
+
+	void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const Model::Vertex* vertices, const std::vector<uint32_t>& clusters)
+	{
+		if (clusters.size() < 2)
+			return;
+
+		struct Cluster
+		{
+			uint32_t begin;
+			uint32_t end;
+			float sortKey;
+		};
+
+		// Area weighted centroid and normal of every cluster
+		std::vector<Cluster> sorted(clusters.size());
+		std::vector<glm::vec3> centroids(clusters.size());
+		std::vector<glm::vec3> normals(clusters.size());
+
+		glm::vec3 meshCentroid{ 0.0f };
+		float meshArea = 0.0f;
+
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			const uint32_t begin = clusters[c];
+			const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(indexCount);
+
+			glm::vec3 centroid{ 0.0f };
+			glm::vec3 normal{ 0.0f };
+			float area = 0.0f;
+
+			for (uint32_t i = begin; i < end; i += 3)
+			{
+				const glm::vec3& p0 = vertices[indices[i]].position;
+				const glm::vec3& p1 = vertices[indices[i + 1]].position;
+				const glm::vec3& p2 = vertices[indices[i + 2]].position;
+
+				const glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+				const float triangleArea = glm::length(triangleNormal);
+
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+				normal += triangleNormal;
+				area += triangleArea;
+			}
+
+			meshCentroid += centroid;
+			meshArea += area;
+
+			centroids[c] = area > 0.0f ? centroid / area : vertices[indices[begin]].position;
+			const float normalLength = glm::length(normal);
+			normals[c] = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f);
+			sorted[c] = { begin, end, 0.0f };
+		}
+
+		if (meshArea > 0.0f)
+			meshCentroid /= meshArea;
+
+		for (size_t c = 0; c < clusters.size(); c++)
+			sorted[c].sortKey = glm::dot(centroids[c] - meshCentroid, normals[c]);
+
+		// Stable, so clusters with equal keys keep their cache friendly order
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<uint32_t> output{};
+		output.reserve(indexCount);
+		for (const Cluster& cluster : sorted)
+			output.insert(output.end(), indices + cluster.begin, indices + cluster.end);
+
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	void MeshOptimizer::optimizeVertexFetch(std::vector<Model::Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+		std::vector<Model::Vertex> reordered{};
+		reordered.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == UINT32_MAX)
+			{
+				remap[index] = static_cast<uint32_t>(reordered.size());
+				reordered.push_back(vertices[index]);
+			}
+
+			index = remap[index];
+		}
+
+		vertices = std::move(reordered);
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef PHM_MESH_OPTIMIZER_H
+#define PHM_MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "phm_model.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Reorders indexed triangle lists for faster rendering, after vertex deduplication.
+	/// 1. Vertex cache: Tipsify (Sander et al. 2007) reorders the triangles so recently transformed vertices are reused.
+	/// 2. Overdraw: the clusters found by Tipsify are sorted so outward facing clusters, which tend to occlude the rest, are drawn first.
+	/// 3. Vertex fetch: the vertices are reordered to the order they are first referenced in.
+	/// </summary>
+	class MeshOptimizer
+	{
+	public:
+		// Post transform cache size assumed when reordering.
+		static constexpr uint32_t CACHE_SIZE = 16;
+		// Triangles after which the vertex cache pass starts a new cluster. Every cluster boundary costs a few cache misses.
+		static constexpr uint32_t CLUSTER_TRIANGLES = 512;
+
+		struct CacheStatistics
+		{
+			// Average cache miss ratio, transformed vertices per triangle. 0.5 is the ideal for large regular meshes, 3 is the worst case.
+			float acmr = 0.0f;
+			// Average transform to vertex ratio, transformed vertices per vertex. 1 is the ideal.
+			float atvr = 0.0f;
+		};
+
+		/// <summary>
+		/// Runs all passes on the mesh and reports the statistics before and after.
+		/// </summary>
+		static void optimize(Model::Builder& builder);
+
+		/// <summary>
+		/// Simulates a FIFO post transform cache of the given size.
+		/// </summary>
+		static CacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+		/// <summary>
+		/// Reorders the triangles for the post transform cache.
+		/// </summary>
+		/// <returns>The first index of every cluster, a run of triangles with good locality that can be moved as a whole.</returns>
+		static std::vector<uint32_t> optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+		/// <summary>
+		/// Sorts the clusters so the ones facing away from the center of the mesh are drawn first.
+		/// </summary>
+		static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Model::Vertex* vertices, const std::vector<uint32_t>& clusters);
+
+		/// <summary>
+		/// Reorders the vertices to the order they are first used by the indices, and drops unused vertices.
+		/// </summary>
+		static void optimizeVertexFetch(std::vector<Model::Vertex>& vertices, std::vector<uint32_t>& indices);
+	};
+}
+
+#endif /* PHM_MESH_OPTIMIZER_H */
@@ -0,0 +1,349 @@
+#include "pch.h"
+
+#include "phm_meshSimplifier.h"
+
+#include "phm_meshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace phm
+{
+	namespace
+	{
+		// Sum of squared distances to a set of planes, weighted by the area of the triangles they came from.
+		struct Quadric
+		{
+			double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+			double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+			double c = 0.0;
+			double weight = 0.0;
+
+			void addPlane(const glm::vec3& normal, double distance, double area)
+			{
+				const double x = normal.x, y = normal.y, z = normal.z;
+
+				a00 += area * x * x;
+				a01 += area * x * y;
+				a02 += area * x * z;
+				a11 += area * y * y;
+				a12 += area * y * z;
+				a22 += area * z * z;
+				b0 += area * x * distance;
+				b1 += area * y * distance;
+				b2 += area * z * distance;
+				c += area * distance * distance;
+				weight += area;
+			}
+
+			void add(const Quadric& other)
+			{
+				a00 += other.a00;
+				a01 += other.a01;
+				a02 += other.a02;
+				a11 += other.a11;
+				a12 += other.a12;
+				a22 += other.a22;
+				b0 += other.b0;
+				b1 += other.b1;
+				b2 += other.b2;
+				c += other.c;
+				weight += other.weight;
+			}
+
+			double evaluate(const glm::vec3& point) const
+			{
+				const double x = point.x, y = point.y, z = point.z;
+
+				return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z
+					+ a11 * y * y + 2.0 * a12 * y * z + a22 * z * z
+					+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			}
+		};
+
+		struct Collapse
+		{
+			uint32_t from;
+			uint32_t to;
+			// Mean squared distance to the planes of both vertices
+			double error;
+		};
+
+		inline bool positionLess(const glm::vec3& a, const glm::vec3& b)
+		{
+			if (a.x != b.x)
+				return a.x < b.x;
+			if (a.y != b.y)
+				return a.y < b.y;
+			return a.z < b.z;
+		}
+
+		inline bool positionEqual(const glm::vec3& a, const glm::vec3& b)
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+
+		// Marks the vertices that must not move: attribute seams, open borders and non manifold edges.
+		std::vector<uint8_t> findLockedVertices(const Model::Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+		{
+			// Vertices at the same position share a position id, the lowest vertex index among them
+			std::vector<uint32_t> order(vertexCount);
+			std::iota(order.begin(), order.end(), 0u);
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return positionLess(vertices[a].position, vertices[b].position); });
+
+			std::vector<uint32_t> positionIds(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++)
+			{
+				const bool sameAsPrevious = i > 0 && positionEqual(vertices[order[i]].position, vertices[order[i - 1]].position);
+				positionIds[order[i]] = sameAsPrevious ? positionIds[order[i - 1]] : order[i];
+			}
+
+			std::vector<uint8_t> used(vertexCount, 0);
+			for (size_t i = 0; i < indexCount; i++)
+				used[indices[i]] = 1;
+
+			std::vector<uint32_t> verticesAtPosition(vertexCount, 0);
+			for (size_t v = 0; v < vertexCount; v++)
+				verticesAtPosition[positionIds[v]] += used[v];
+
+			std::vector<uint8_t> lockedPositions(vertexCount, 0);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				if (verticesAtPosition[positionIds[v]] > 1)
+					lockedPositions[positionIds[v]] = 1;
+			}
+
+			// An edge is on a border if one triangle uses it, and non manifold if more than two do
+			std::vector<uint64_t> edges{};
+			edges.reserve(indexCount);
+			for (size_t i = 0; i < indexCount; i += 3)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint64_t a = positionIds[indices[i + k]];
+					const uint64_t b = positionIds[indices[i + (k + 1) % 3]];
+					edges.push_back(a < b ? (a << 32 | b) : (b << 32 | a));
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+
+			for (size_t i = 0; i < edges.size();)
+			{
+				size_t end = i + 1;
+				while (end < edges.size() && edges[end] == edges[i])
+					end++;
+
+				if (end - i != 2)
+				{
+					lockedPositions[edges[i] >> 32] = 1;
+					lockedPositions[edges[i] & 0xFFFFFFFF] = 1;
+				}
+				i = end;
+			}
+
+			std::vector<uint8_t> locked(vertexCount, 0);
+			for (size_t v = 0; v < vertexCount; v++)
+				locked[v] = lockedPositions[positionIds[v]];
+
+			return locked;
+		}
+	}
+
+	std::vector<uint32_t> MeshSimplifier::simplify(const Model::Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+		size_t targetIndexCount, float& error)
+	{
+		std::vector<uint32_t> result(indices, indices + indexCount);
+		error = 0.0f;
+
+		if (indexCount <= targetIndexCount || indexCount % 3 != 0 || vertexCount == 0)
+			return result;
+
+		const std::vector<uint8_t> locked = findLockedVertices(vertices, vertexCount, indices, indexCount);
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			const glm::vec3& p0 = vertices[indices[i]].position;
+			const glm::vec3& p1 = vertices[indices[i + 1]].position;
+			const glm::vec3& p2 = vertices[indices[i + 2]].position;
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float length = glm::length(normal);
+			if (length == 0.0f)
+				continue;
+
+			normal /= length;
+			const double distance = -glm::dot(normal, p0);
+			for (uint32_t k = 0; k < 3; k++)
+				quadrics[indices[i + k]].addPlane(normal, distance, length * 0.5);
+		}
+
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint8_t> touched(vertexCount);
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjacency{};
+		std::vector<Collapse> collapses{};
+		double maxError = 0.0;
+
+		// Collapsing must not turn any of the remaining triangles around the vertex over
+		auto flipsTriangles = [&](uint32_t from, uint32_t to)
+		{
+			const glm::vec3& target = vertices[to].position;
+			for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++)
+			{
+				const uint32_t* triangle = &result[adjacency[a] * 3];
+				if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+					continue;
+
+				glm::vec3 before[3];
+				glm::vec3 after[3];
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					before[k] = vertices[triangle[k]].position;
+					after[k] = triangle[k] == from ? target : before[k];
+				}
+
+				const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+					return true;
+			}
+			return false;
+		};
+
+		// Every pass applies the cheapest independent collapses, then rebuilds the triangles
+		while (result.size() > targetIndexCount)
+		{
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t index : result)
+				adjacencyOffsets[index + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+			adjacency.resize(result.size());
+			{
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < result.size(); i++)
+					adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t a = result[i + k];
+					const uint32_t b = result[i + (k + 1) % 3];
+
+					for (const auto& [from, to] : { std::pair{ a, b }, std::pair{ b, a } })
+					{
+						if (locked[from])
+							continue;
+
+						const Quadric& fromQuadric = quadrics[from];
+						const Quadric& toQuadric = quadrics[to];
+						const glm::vec3& target = vertices[to].position;
+
+						const double weight = fromQuadric.weight + toQuadric.weight;
+						const double cost = fromQuadric.evaluate(target) + toQuadric.evaluate(target);
+						collapses.push_back({ from, to, weight > 0.0 ? std::max(cost, 0.0) / weight : 0.0 });
+					}
+				}
+			}
+
+			if (collapses.empty())
+				break;
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+			std::iota(remap.begin(), remap.end(), 0u);
+			std::fill(touched.begin(), touched.end(), 0);
+
+			// A collapse removes about two triangles
+			const size_t budget = std::max<size_t>(1, (result.size() - targetIndexCount) / 6);
+			size_t applied = 0;
+
+			for (const Collapse& collapse : collapses)
+			{
+				if (touched[collapse.from] || touched[collapse.to] || flipsTriangles(collapse.from, collapse.to))
+					continue;
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				maxError = std::max(maxError, collapse.error);
+
+				// The triangles around the collapsed vertex change shape, so none of their vertices can collapse again this pass
+				for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++)
+				{
+					const uint32_t* triangle = &result[adjacency[a] * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+				}
+
+				if (++applied >= budget)
+					break;
+			}
+
+			if (applied == 0)
+				break;
+
+			// Drop the triangles that collapsed into lines
+			size_t write = 0;
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				const uint32_t a = remap[result[i]];
+				const uint32_t b = remap[result[i + 1]];
+				const uint32_t c = remap[result[i + 2]];
+				if (a == b || b == c || a == c)
+					continue;
+
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+		}
+
+		error = static_cast<float>(std::sqrt(maxError));
+		return result;
+	}
+
+	void MeshSimplifier::generateLods(Model::Builder& builder, uint32_t maxLods)
+	{
+		const uint32_t baseIndexCount = static_cast<uint32_t>(builder.indices.size());
+
+		builder.lods.clear();
+		builder.lods.push_back({ 0, baseIndexCount, 0.0f });
+
+		if (baseIndexCount % 3 != 0)
+			return;
+
+		// Every level is simplified from the full mesh, so its error is measured against the original surface
+		uint32_t previousIndexCount = baseIndexCount;
+		float previousError = 0.0f;
+		for (uint32_t lod = 1; lod < maxLods; lod++)
+		{
+			const size_t targetIndexCount = static_cast<size_t>(previousIndexCount / 3 * LOD_REDUCTION) * 3;
+			if (targetIndexCount / 3 < MIN_LOD_TRIANGLES)
+				break;
+
+			float error;
+			std::vector<uint32_t> lodIndices = simplify(builder.vertices.data(), builder.vertices.size(), builder.indices.data(), baseIndexCount,
+				targetIndexCount, error);
+
+			// Stop once the borders and seams keep the mesh from getting meaningfully smaller
+			if (lodIndices.size() > previousIndexCount * 0.9f)
+				break;
+
+			MeshOptimizer::optimizeVertexCache(lodIndices.data(), lodIndices.size(), builder.vertices.size());
+
+			previousIndexCount = static_cast<uint32_t>(lodIndices.size());
+			previousError = std::max(previousError, error);
+
+			builder.lods.push_back({ static_cast<uint32_t>(builder.indices.size()), previousIndexCount, previousError });
+			builder.indices.insert(builder.indices.end(), lodIndices.begin(), lodIndices.end());
+		}
+
+		DebugPrint("Generated " << builder.lods.size() << " levels of detail, coarsest has " << previousIndexCount / 3 << " of " << baseIndexCount / 3 << " triangles");
+	}
+}
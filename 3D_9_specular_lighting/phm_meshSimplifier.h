@@ -0,0 +1,43 @@
+#ifndef PHM_MESH_SIMPLIFIER_H
+#define PHM_MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "phm_model.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Quadric error edge collapse simplification (Garland and Heckbert 1997), used to build the levels of detail of a model.
+	/// Vertices are only collapsed onto other existing vertices, so every level of detail shares the vertex buffer and only needs its own indices.
+	/// Vertices on open borders and attribute seams (one position with several normals or uvs) never move, which keeps the silhouette and the texturing intact.
+	/// </summary>
+	class MeshSimplifier
+	{
+	public:
+		// Levels of detail per model, including the full resolution one.
+		static constexpr uint32_t MAX_LODS = 5;
+		// Triangle count of every level relative to the previous one.
+		static constexpr float LOD_REDUCTION = 0.5f;
+		// Meshes aren't simplified below this many triangles.
+		static constexpr uint32_t MIN_LOD_TRIANGLES = 32;
+
+		/// <summary>
+		/// Simplifies the triangle list until it has at most targetIndexCount indices, or no collapse is possible anymore.
+		/// </summary>
+		/// <param name="error">Receives the largest distance of a collapsed vertex to the surface it was collapsed onto, in model units.</param>
+		/// <returns>The simplified indices.</returns>
+		static std::vector<uint32_t> simplify(const Model::Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+			size_t targetIndexCount, float& error);
+
+		/// <summary>
+		/// Appends the indices of the coarser levels of detail to the builder and fills in its level of detail ranges.
+		/// The chain stops early when a level doesn't remove enough triangles.
+		/// </summary>
+		static void generateLods(Model::Builder& builder, uint32_t maxLods = MAX_LODS);
+	};
+}
+
+#endif /* PHM_MESH_SIMPLIFIER_H */
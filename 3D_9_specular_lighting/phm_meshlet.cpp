@@ -0,0 +1,286 @@
+#include "pch.h"
+
+#include "phm_meshlet.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PHM_MESHLET_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace phm
+{
+	void MeshletBounds::clear()
+	{
+		spheres.clear();
+		coneX.clear();
+		coneY.clear();
+		coneZ.clear();
+		coneCutoff.clear();
+	}
+
+	void MeshletBounds::push_back(const BoundingSphere& sphere, const glm::vec3& coneAxis, float cutoff)
+	{
+		spheres.push_back(sphere);
+		coneX.push_back(coneAxis.x);
+		coneY.push_back(coneAxis.y);
+		coneZ.push_back(coneAxis.z);
+		coneCutoff.push_back(cutoff);
+	}
+
+	void MeshletBuilder::build(const glm::vec3* positions, size_t positionStride, uint16_t* indices, uint32_t indexCount,
+		uint32_t firstIndex, int32_t vertexOffset, std::vector<Meshlet>& meshlets, MeshletBounds& bounds)
+	{
+		assert(indexCount % 3 == 0 && "Meshlets can only be built from triangle lists");
+
+		const uint32_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		const auto* bytes = reinterpret_cast<const unsigned char*>(positions);
+		auto position = [&](uint32_t vertex) -> const glm::vec3& { return *reinterpret_cast<const glm::vec3*>(bytes + vertex * positionStride); };
+
+		const uint32_t vertexCount = *std::max_element(indices, indices + indexCount) + 1u;
+
+		// Triangles around every vertex
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32_t i = 0; i < indexCount; i++)
+			adjacencyOffsets[indices[i] + 1]++;
+		for (uint32_t v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+		std::vector<uint32_t> adjacency(indexCount);
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t i = 0; i < indexCount; i++)
+				adjacency[fill[indices[i]]++] = i / 3;
+		}
+
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		// Id of the last meshlet that used the vertex
+		std::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX);
+		std::vector<uint16_t> output{};
+		output.reserve(indexCount);
+
+		std::vector<uint32_t> meshletVertices{};
+		std::vector<uint32_t> meshletTriangles{};
+		uint32_t meshletId = 0;
+		uint32_t seed = 0;
+
+		while (true)
+		{
+			// Seeding in input order keeps the meshlets in roughly the vertex cache optimized order.
+			while (seed < triangleCount && emitted[seed])
+				seed++;
+			if (seed == triangleCount)
+				break;
+
+			meshletVertices.clear();
+			meshletTriangles.clear();
+			glm::vec3 positionSum{ 0.0f };
+
+			uint32_t next = seed;
+			while (next != UINT32_MAX)
+			{
+				emitted[next] = 1;
+				meshletTriangles.push_back(next);
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t vertex = indices[next * 3 + k];
+					if (vertexMeshlet[vertex] != meshletId)
+					{
+						vertexMeshlet[vertex] = meshletId;
+						meshletVertices.push_back(vertex);
+						positionSum += position(vertex);
+					}
+				}
+
+				if (meshletTriangles.size() == MAX_TRIANGLES)
+					break;
+
+				// Grow into the neighbouring triangle that adds the fewest vertices, then the one closest to the meshlet.
+				const glm::vec3 center = positionSum / static_cast<float>(meshletVertices.size());
+				uint32_t bestNewVertices = 4;
+				float bestDistance = FLT_MAX;
+				next = UINT32_MAX;
+
+				for (uint32_t vertex : meshletVertices)
+				{
+					for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+					{
+						const uint32_t triangle = adjacency[a];
+						if (emitted[triangle])
+							continue;
+
+						const uint16_t* corners = &indices[triangle * 3];
+						const uint32_t newVertices = (vertexMeshlet[corners[0]] != meshletId) + (vertexMeshlet[corners[1]] != meshletId && corners[1] != corners[0]) +
+							(vertexMeshlet[corners[2]] != meshletId && corners[2] != corners[0] && corners[2] != corners[1]);
+						if (meshletVertices.size() + newVertices > MAX_VERTICES || newVertices > bestNewVertices)
+							continue;
+
+						const glm::vec3 offset = (position(corners[0]) + position(corners[1]) + position(corners[2])) / 3.0f - center;
+						const float distance = glm::dot(offset, offset);
+						if (newVertices < bestNewVertices || distance < bestDistance)
+						{
+							bestNewVertices = newVertices;
+							bestDistance = distance;
+							next = triangle;
+						}
+					}
+				}
+			}
+
+			// Bounding sphere around the center of the box of the vertices, like the bounds of the models
+			glm::vec3 minimum{ FLT_MAX };
+			glm::vec3 maximum{ -FLT_MAX };
+			for (uint32_t vertex : meshletVertices)
+			{
+				minimum = glm::min(minimum, position(vertex));
+				maximum = glm::max(maximum, position(vertex));
+			}
+
+			const glm::vec3 center = (minimum + maximum) * 0.5f;
+			float radiusSquared = 0.0f;
+			for (uint32_t vertex : meshletVertices)
+			{
+				const glm::vec3 offset = position(vertex) - center;
+				radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+			}
+
+			// The cone axis is the average normal, the cutoff is the sine of the widest angle between the axis and a normal.
+			std::vector<glm::vec3> normals{};
+			normals.reserve(meshletTriangles.size());
+			glm::vec3 normalSum{ 0.0f };
+			for (uint32_t triangle : meshletTriangles)
+			{
+				const glm::vec3& p0 = position(indices[triangle * 3]);
+				const glm::vec3 normal = glm::cross(position(indices[triangle * 3 + 1]) - p0, position(indices[triangle * 3 + 2]) - p0);
+				const float length = glm::length(normal);
+				if (length == 0.0f)
+					continue;
+
+				normals.push_back(normal / length);
+				normalSum += normals.back();
+			}
+
+			glm::vec3 coneAxis{ 0.0f };
+			float coneCutoff = 1.0f;
+			const float normalSumLength = glm::length(normalSum);
+			if (normalSumLength > 0.0f)
+			{
+				coneAxis = normalSum / normalSumLength;
+
+				float minimumDot = 1.0f;
+				for (const glm::vec3& normal : normals)
+					minimumDot = std::min(minimumDot, glm::dot(normal, coneAxis));
+
+				// Cones wider than a hemisphere face every point, a cutoff of one never culls.
+				if (minimumDot > 0.0f)
+					coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+			}
+
+			meshlets.push_back({ firstIndex + static_cast<uint32_t>(output.size()), static_cast<uint32_t>(meshletTriangles.size()) * 3, vertexOffset });
+			bounds.push_back({ center, std::sqrt(radiusSquared) }, coneAxis, coneCutoff);
+
+			for (uint32_t triangle : meshletTriangles)
+				output.insert(output.end(), indices + triangle * 3, indices + triangle * 3 + 3);
+
+			meshletId++;
+		}
+
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	uint32_t cullMeshlets(const MeshletBounds& bounds, size_t first, size_t count, const Frustum& frustum,
+		const glm::vec3& cameraPosition, bool coneCulling, uint8_t* visible)
+	{
+		assert(first + count <= bounds.size() && "Meshlet range out of bounds");
+
+		const SphereBoundsSoA& spheres = bounds.spheres;
+		uint32_t visibleCount = 0;
+		size_t i = 0;
+
+#ifdef PHM_MESHLET_SSE
+		// Test four meshlets against one plane at a time, then against the camera.
+		__m128 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount], planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+		for (int p = 0; p < Frustum::PlaneCount; p++)
+		{
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m128 cameraX = _mm_set1_ps(cameraPosition.x);
+		const __m128 cameraY = _mm_set1_ps(cameraPosition.y);
+		const __m128 cameraZ = _mm_set1_ps(cameraPosition.z);
+
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			const size_t m = first + i;
+			const __m128 x = _mm_loadu_ps(&spheres.x[m]);
+			const __m128 y = _mm_loadu_ps(&spheres.y[m]);
+			const __m128 z = _mm_loadu_ps(&spheres.z[m]);
+			const __m128 radius = _mm_loadu_ps(&spheres.radius[m]);
+			const __m128 negativeRadius = _mm_sub_ps(zero, radius);
+
+			__m128 inside = _mm_cmpeq_ps(zero, zero);
+			for (int p = 0; p < Frustum::PlaneCount; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], x), planeW[p]);
+				distance = _mm_add_ps(distance, _mm_mul_ps(planeY[p], y));
+				distance = _mm_add_ps(distance, _mm_mul_ps(planeZ[p], z));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			if (coneCulling)
+			{
+				const __m128 dx = _mm_sub_ps(x, cameraX);
+				const __m128 dy = _mm_sub_ps(y, cameraY);
+				const __m128 dz = _mm_sub_ps(z, cameraZ);
+
+				__m128 alongAxis = _mm_mul_ps(dx, _mm_loadu_ps(&bounds.coneX[m]));
+				alongAxis = _mm_add_ps(alongAxis, _mm_mul_ps(dy, _mm_loadu_ps(&bounds.coneY[m])));
+				alongAxis = _mm_add_ps(alongAxis, _mm_mul_ps(dz, _mm_loadu_ps(&bounds.coneZ[m])));
+
+				__m128 distanceSquared = _mm_mul_ps(dx, dx);
+				distanceSquared = _mm_add_ps(distanceSquared, _mm_mul_ps(dy, dy));
+				distanceSquared = _mm_add_ps(distanceSquared, _mm_mul_ps(dz, dz));
+
+				const __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&bounds.coneCutoff[m]), _mm_sqrt_ps(distanceSquared)), radius);
+				inside = _mm_and_ps(inside, _mm_cmplt_ps(alongAxis, limit));
+			}
+
+			const int mask = _mm_movemask_ps(inside);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+				visibleCount += visible[i + lane];
+			}
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			const size_t m = first + i;
+			const glm::vec3 center{ spheres.x[m], spheres.y[m], spheres.z[m] };
+
+			bool isVisible = frustum.intersectsSphere(center, spheres.radius[m]);
+			if (isVisible && coneCulling)
+			{
+				const glm::vec3 offset = center - cameraPosition;
+				const glm::vec3 axis{ bounds.coneX[m], bounds.coneY[m], bounds.coneZ[m] };
+				isVisible = glm::dot(offset, axis) < bounds.coneCutoff[m] * glm::length(offset) + spheres.radius[m];
+			}
+
+			visible[i] = isVisible ? 1 : 0;
+			visibleCount += visible[i];
+		}
+
+		return visibleCount;
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef PHM_MESHLET_H
+#define PHM_MESHLET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "phm_bounds.h"
+
+namespace phm
+{
+	// Small cluster of neighbouring triangles, stored as a contiguous range of the index buffer so it can be drawn on its own.
+	struct Meshlet
+	{
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		int32_t vertexOffset = 0;
+	};
+
+	// Culling data of the meshlets, stored as structure of arrays so several meshlets can be tested at a time.
+	// The cone bounds the normals of the triangles: the meshlet faces away from every point p
+	// for which dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius.
+	struct MeshletBounds
+	{
+		SphereBoundsSoA spheres{};
+		std::vector<float> coneX{};
+		std::vector<float> coneY{};
+		std::vector<float> coneZ{};
+		std::vector<float> coneCutoff{};
+
+		inline size_t size() const { return spheres.size(); };
+
+		void clear();
+		void push_back(const BoundingSphere& sphere, const glm::vec3& coneAxis, float coneCutoff);
+	};
+
+	/// <summary>
+	/// Partitions triangle lists into meshlets of at most MAX_VERTICES vertices and MAX_TRIANGLES triangles.
+	/// Meshlets are grown greedily from a seed triangle, preferring the neighbouring triangle that adds the fewest new vertices
+	/// and then the one closest to the meshlet, which keeps the meshlets compact and their normal cones narrow.
+	/// </summary>
+	class MeshletBuilder
+	{
+	public:
+		static constexpr uint32_t MAX_VERTICES = 64;
+		static constexpr uint32_t MAX_TRIANGLES = 124;
+
+		/// <summary>
+		/// Reorders the triangles of the range so every meshlet is contiguous, and appends the meshlets and their bounds.
+		/// </summary>
+		/// <param name="positions">Position of the vertex the indices start at, with positionStride bytes between vertices.</param>
+		/// <param name="firstIndex">Offset of the range in the index buffer, added to the meshlet ranges.</param>
+		/// <param name="vertexOffset">Vertex offset of the range, copied into the meshlets.</param>
+		static void build(const glm::vec3* positions, size_t positionStride, uint16_t* indices, uint32_t indexCount,
+			uint32_t firstIndex, int32_t vertexOffset, std::vector<Meshlet>& meshlets, MeshletBounds& bounds);
+	};
+
+	// Writes 1 into visible[i] if meshlet first + i intersects the frustum and, with cone culling, faces the camera at least partially.
+	// The frustum and the camera position have to be in the space of the meshlet bounds. Returns the number of visible meshlets.
+	uint32_t cullMeshlets(const MeshletBounds& bounds, size_t first, size_t count, const Frustum& frustum,
+		const glm::vec3& cameraPosition, bool coneCulling, uint8_t* visible);
+}
+
+#endif /* PHM_MESHLET_H */
@@ -2,30 +2,11 @@
 
 #include "phm_model.h"
 
-#include "phm_utils.h"
-
-// Libraries
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
-
-#include <unordered_map>
-
-
-namespace std
-{
-	template<>
-	struct hash<phm::Model::Vertex>
-	{
-		size_t operator()(const phm::Model::Vertex& vertex) const
-		{
-			size_t seed = 0;
-			phm::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-			return seed;
-		}
-	};
-}
+#include "phm_meshCache.h"
+#include "phm_objLoader.h"
+#include "phm_meshOptimizer.h"
+#include "phm_meshSimplifier.h"
+#include "phm_assetCache.h"
 
 namespace phm
 {
@@ -59,70 +40,224 @@ namespace phm
 	}
 
 
-	Model::Model(Device& device, const Model::Builder& builder)
-		: device_(device)
+	Model::Model(Device& device, const Model::Builder& builder, VertexFormat format)
+		: Model(device, builder.vertices.data(), static_cast<uint32_t>(builder.vertices.size()), builder.indices.data(), static_cast<uint32_t>(builder.indices.size()),
+			builder.lods.data(), static_cast<uint32_t>(builder.lods.size()), format)
 	{
-		createVertexBuffers(builder.vertices);
-		createIndexBuffers(builder.indices);
+	}
+
+	Model::Model(Device& device, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+		const LodRange* lods, uint32_t lodCount, VertexFormat format)
+		: device_(device), vertexFormat_(format)
+	{
+		computeBounds(vertices, vertexCount);
+
+		std::vector<Vertex> splitVertices{};
+		std::vector<uint16_t> splitIndices{};
+		vertices = buildSubMeshes(vertices, vertexCount, indices, indexCount, lods, lodCount, splitVertices, splitIndices);
+		buildMeshlets(vertices, splitIndices);
+
+		createBuffers(vertices, vertexCount, splitIndices.data(), static_cast<uint32_t>(splitIndices.size()));
 	}
 
 	Model::~Model()
 	{
+		// The buffers have to outlive the copies into them.
+		device_.getUploadBatcher().wait(uploadBatch_);
+
+		// The pool keeps the range alive until the frames in flight are done with it.
+		device_.getGeometryPool().free(geometry_);
 	}
 
-	std::unique_ptr<Model> Model::createModelFromFile(Device& device, std::string_view filePath)
+	std::unique_ptr<Model> Model::createModelFromFile(Device& device, std::string_view filePath, JobSystem* jobSystem, VertexFormat format)
 	{
+		DebugPrint("Loading model: " << filePath);
+
+		// The cached streams are uploaded straight from the mapped file.
+		if (auto mesh = MeshCache::load(filePath))
+		{
+			DebugPrint("Loaded from cache: " << MeshCache::getCachePath(filePath));
+			DebugPrint("Vertex count: " << mesh->getVertexCount());
+			DebugPrint("Index buffer length: " << mesh->getIndexCount());
+
+			return std::make_unique<Model>(device, mesh->getVertices(), mesh->getVertexCount(), mesh->getIndices(), mesh->getIndexCount(),
+				mesh->getLods(), mesh->getLodCount(), format);
+		}
+
 		Builder builder{};
-		builder.loadModel(filePath);
+		builder.loadModel(filePath, jobSystem);
+
+		// Optimized and simplified once before caching, so cached loads get the optimized order and the levels of detail for free.
+		MeshOptimizer::optimize(builder);
+		MeshSimplifier::generateLods(builder);
+		MeshCache::store(filePath, builder);
 
-		DebugPrint("Loading model: " << filePath);
 		DebugPrint("Vertex count: " << builder.vertices.size());
 		DebugPrint("Index buffer length: " << builder.indices.size());
 
-		return std::make_unique<Model>(device, builder);
+		return std::make_unique<Model>(device, builder, format);
+	}
+
+	std::vector<VkVertexInputBindingDescription> Model::getBindingDescriptions(VertexFormat format)
+	{
+		if (format == VertexFormat::Quantized)
+			return QuantizedVertex::getBindingDescriptions();
+		return Vertex::getBindingDescriptions();
+	}
+
+	std::vector<VkVertexInputAttributeDescription> Model::getAttributeDescriptions(VertexFormat format)
+	{
+		if (format == VertexFormat::Quantized)
+			return QuantizedVertex::getAttributeDescriptions();
+		return Vertex::getAttributeDescriptions();
 	}
 
 	void Model::bind(VkCommandBuffer commandBuffer)
 	{
+		if (geometry_ != nullptr)
+		{
+			device_.getGeometryPool().bind(commandBuffer, vertexFormat_);
+			return;
+		}
+
 		VkBuffer buffers[] = { vertexBuffer_->getBuffer() };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
 
 		if (hasIndexBuffer)
 		{
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer_->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer_->getBuffer(), 0, VK_INDEX_TYPE_UINT16);
 		}
 	}
 
-	void Model::draw(VkCommandBuffer commandBuffer)
+	void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod)
 	{
-		if (hasIndexBuffer)
-			vkCmdDrawIndexed(commandBuffer, indexCount_, 1, 0, 0, 0);
-		else
-			vkCmdDraw(commandBuffer, vertexCount_, 1, 0, 0);
+		if (!hasIndexBuffer)
+		{
+			vkCmdDraw(commandBuffer, vertexCount_, instanceCount, getBaseVertex(), firstInstance);
+			return;
+		}
+
+		assert(lod < lods_.size() && "Level of detail out of range");
+
+		const Lod& range = lods_[lod];
+		for (uint32_t i = range.firstSubMesh; i < range.firstSubMesh + range.subMeshCount; i++)
+		{
+			const SubMesh& subMesh = subMeshes_[i];
+			vkCmdDrawIndexed(commandBuffer, subMesh.indexCount, instanceCount, getBaseIndex() + subMesh.firstIndex, getBaseVertex() + subMesh.vertexOffset, firstInstance);
+		}
+	}
+
+	uint32_t Model::drawMeshlets(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t lod,
+		const Frustum& frustum, const glm::vec3& cameraPosition, bool coneCulling, uint32_t& triangles)
+	{
+		assert(hasMeshlets(lod) && "Level of detail has no meshlets");
+
+		const Lod& range = lods_[lod];
+		meshletVisibility_.resize(range.meshletCount);
+		cullMeshlets(meshletBounds_, range.firstMeshlet, range.meshletCount, frustum, cameraPosition, coneCulling, meshletVisibility_.data());
+
+		// The meshlets of a sub-mesh are contiguous in the index buffer, so runs of visible meshlets are drawn together.
+		uint32_t drawCalls = 0;
+		triangles = 0;
+		for (uint32_t i = 0; i < range.meshletCount;)
+		{
+			if (!meshletVisibility_[i])
+			{
+				i++;
+				continue;
+			}
+
+			const Meshlet& start = meshlets_[range.firstMeshlet + i];
+			uint32_t indexCount = start.indexCount;
+			for (i++; i < range.meshletCount && meshletVisibility_[i] && meshlets_[range.firstMeshlet + i].vertexOffset == start.vertexOffset; i++)
+				indexCount += meshlets_[range.firstMeshlet + i].indexCount;
+
+			vkCmdDrawIndexed(commandBuffer, indexCount, 1, getBaseIndex() + start.firstIndex, getBaseVertex() + start.vertexOffset, firstInstance);
+			triangles += indexCount / 3;
+			drawCalls++;
+		}
+
+		return drawCalls;
+	}
+
+	uint32_t Model::selectLod(float projectedRadius, uint32_t currentLod) const
+	{
+		if (lods_.size() <= 1 || boundingSphere_.radius <= 0.0f)
+			return 0;
+
+		// Fraction of the screen height covered by one model unit
+		const float screenScale = projectedRadius * 0.5f / boundingSphere_.radius;
+
+		// The errors grow with the level, so the coarsest level within a threshold is the last one within it
+		auto coarsestWithin = [&](float threshold)
+		{
+			uint32_t lod = 0;
+			for (uint32_t i = 1; i < lods_.size() && lods_[i].error * screenScale <= threshold; i++)
+				lod = i;
+			return lod;
+		};
+
+		const uint32_t finest = coarsestWithin(LOD_ERROR_THRESHOLD * (1.0f - LOD_HYSTERESIS));
+		const uint32_t coarsest = coarsestWithin(LOD_ERROR_THRESHOLD * (1.0f + LOD_HYSTERESIS));
+
+		return std::clamp(currentLod, finest, coarsest);
+	}
+
+	void Model::computeBounds(const Vertex* vertices, uint32_t vertexCount)
+	{
+		if (vertexCount == 0)
+			return;
+
+		boundingBox_ = AABB::fromPoints(&vertices[0].position, vertexCount, sizeof(Vertex));
+
+		// Centering the sphere on the box gives a tighter radius than the half diagonal.
+		float radiusSquared = 0.0f;
+		const glm::vec3 center = boundingBox_.center();
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			const glm::vec3 offset = vertices[i].position - center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		boundingSphere_ = { center, std::sqrt(radiusSquared) };
 	}
 
-	void Model::createVertexBuffers(const std::vector<Vertex>& vertices)
+	void Model::createBuffers(const Vertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount)
 	{
-		vertexCount_ = static_cast<uint32_t>(vertices.size());
+		vertexCount_ = vertexCount;
 		assert(vertexCount_ > 2 && "Vertex Count must be at least 3");
 
-		//VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount_;
+		indexCount_ = indexCount;
+		hasIndexBuffer = indexCount_ > 0;
 
+		// Quantized vertices are packed relative to the bounds, which are computed from the full vertices.
+		std::vector<QuantizedVertex> quantizedVertices{};
+		const void* vertexData = vertices;
 		uint32_t vertexSize = sizeof(vertices[0]);
 
-		// Create staging buffer for transfer to the GPU
-		Buffer stagingBuffer{
-			device_,
-			vertexSize,
-			vertexCount_,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
+		if (vertexFormat_ == VertexFormat::Quantized)
+		{
+			quantizedVertices.resize(vertexCount_);
+			for (uint32_t i = 0; i < vertexCount_; i++)
+			{
+				const Vertex& vertex = vertices[i];
+				quantizedVertices[i] = QuantizedVertex::encode(vertex.position, vertex.color, vertex.normal, vertex.uv, boundingBox_);
+			}
+
+			vertexData = quantizedVertices.data();
+			vertexSize = sizeof(QuantizedVertex);
+			dequantizationMatrix_ = QuantizedVertex::getDequantizationMatrix(boundingBox_);
+		}
 
-		// Map the memory to the host and copy the data into the mapped region. 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
+		memorySize_ = static_cast<VkDeviceSize>(vertexCount_) * vertexSize + static_cast<VkDeviceSize>(indexCount_) * sizeof(uint16_t);
+
+		// Sub-allocate from the shared geometry pool, which queues the uploads itself.
+		geometry_ = device_.getGeometryPool().allocate(vertexFormat_, vertexSize, vertexData, vertexCount_, indices, indexCount_, uploadBatch_);
+		if (geometry_ != nullptr)
+			return;
+
+		// The pool is full until it grows at the next frame, so this model gets buffers of its own.
+		DebugPrint("Geometry pool full, creating dedicated buffers");
 
 		// Create the actual memory buffer on the GPU
 		vertexBuffer_ = std::make_unique<Buffer>(
@@ -133,114 +268,210 @@ namespace phm
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 			);
 
-		// Copy the data from the staging buffer to the vertex buffer.
-		device_.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer_->getBuffer(), stagingBuffer.getBufferSize());
-	}
-
-	void Model::createIndexBuffers(const std::vector<uint32_t>& indices)
-	{
-		indexCount_ = static_cast<uint32_t>(indices.size());
-		hasIndexBuffer = indexCount_ > 0;
+		// Queue the copy through the staging ring of the upload batcher.
+		uploadBatch_ = device_.getUploadBatcher().upload(vertexBuffer_->getBuffer(), vertexData, vertexBuffer_->getBufferSize());
 
 		if (!hasIndexBuffer)
 			return;
 
-		uint32_t indexSize = sizeof(indices[0]);
-
-		// Create staging buffer for transfer to the GPU
-		Buffer stagingBuffer{
-			device_,
-			indexSize,
-			indexCount_,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
-		
-		// Map the memory to the host and copy the data into the mapped region.
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
-
-		// Create the actual memory buffer on the GPU
 		indexBuffer_ = std::make_unique<Buffer>(
 			device_,
-			indexSize,
+			sizeof(indices[0]),
 			indexCount_,
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 			);
 
-		// Copy the data from the staging buffer to the index buffer.
-		device_.copyBuffer(stagingBuffer.getBuffer(), indexBuffer_->getBuffer(), stagingBuffer.getBufferSize());
+		uploadBatch_ = device_.getUploadBatcher().upload(indexBuffer_->getBuffer(), indices, indexBuffer_->getBufferSize());
 	}
 
-	void Model::Builder::loadModel(std::string_view filePath)
+	const Model::Vertex* Model::buildSubMeshes(const Vertex* vertices, uint32_t& vertexCount, const uint32_t* indices, uint32_t indexCount,
+		const LodRange* lods, uint32_t lodCount, std::vector<Vertex>& splitVertices, std::vector<uint16_t>& splitIndices)
 	{
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string warn, err;
+		subMeshes_.clear();
+		lods_.clear();
+		if (indexCount == 0)
+			return vertices;
+
+		// Without a level of detail chain all indices make up a single level
+		const LodRange fullRange{ 0, indexCount, 0.0f };
+		if (lodCount == 0)
+		{
+			lods = &fullRange;
+			lodCount = 1;
+		}
+
+		splitIndices.reserve(indexCount);
 
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.data()))
+		if (vertexCount <= MAX_SUBMESH_VERTICES)
 		{
-			throw std::runtime_error(warn + err);
+			splitIndices.assign(indices, indices + indexCount);
+			for (uint32_t lod = 0; lod < lodCount; lod++)
+			{
+				const LodRange& range = lods[lod];
+				assert(range.firstIndex + range.indexCount <= indexCount && "Level of detail out of range");
+
+				lods_.push_back({ static_cast<uint32_t>(subMeshes_.size()), 1, range.indexCount / 3, range.error });
+				subMeshes_.push_back({ range.firstIndex, range.indexCount, 0 });
+			}
+			return vertices;
 		}
 
-		vertices.clear();
-		indices.clear();
+		assert(indexCount % 3 == 0 && "Only triangle lists can be split into sub-meshes");
+
+		// The vertices are copied into ranges of at most MAX_SUBMESH_VERTICES vertices, and every sub-mesh draws from one of them.
+		// A triangle is drawn from a range that already holds all three of its vertices if there is one. The coarser levels of detail only
+		// reference vertices of the finest level, so they mostly reuse its ranges, and only triangles across the seams get new copies.
+		// Only the last range is open for new vertices.
+		struct VertexRange
+		{
+			int32_t vertexOffset;
+			uint32_t vertexCount;
+		};
 
-		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-		for (const auto& shape : shapes)
+		// Copy of a vertex in a range, linked to the other copies of the same vertex
+		struct Placement
 		{
-			for (const auto& index : shape.mesh.indices)
+			uint32_t range;
+			uint16_t localIndex;
+			uint32_t next;
+		};
+
+		std::vector<VertexRange> ranges{ { 0, 0 } };
+		std::vector<uint32_t> firstPlacement(vertexCount, UINT32_MAX);
+		std::vector<Placement> placements{};
+		placements.reserve(vertexCount);
+
+		// Returns the index of the vertex in the range, or -1 if it wasn't copied to it.
+		const auto findLocalIndex = [&](uint32_t vertex, uint32_t range) -> int32_t
+		{
+			for (uint32_t placement = firstPlacement[vertex]; placement != UINT32_MAX; placement = placements[placement].next)
 			{
-				Vertex vertex{};
+				if (placements[placement].range == range)
+					return placements[placement].localIndex;
+			}
+			return -1;
+		};
 
-				if (index.vertex_index >= 0)
-				{
-					vertex.position = {
-						attrib.vertices[3 * index.vertex_index],
-						attrib.vertices[3 * index.vertex_index + 1],
-						attrib.vertices[3 * index.vertex_index + 2]
-					};
-
-					vertex.color = {
-						attrib.colors[3 * index.vertex_index],
-						attrib.colors[3 * index.vertex_index + 1],
-						attrib.colors[3 * index.vertex_index + 2]
-					};
-				}
+		std::vector<uint32_t> triangleRanges{};
+		std::vector<uint32_t> rangeIndexCounts{};
+		std::vector<uint32_t> rangeWriteOffsets{};
 
-				if (index.normal_index >= 0)
-				{
-					vertex.normal = {
-						attrib.normals[3 * index.normal_index],
-						attrib.normals[3 * index.normal_index + 1],
-						attrib.normals[3 * index.normal_index + 2]
-					};
-				}
+		for (uint32_t lod = 0; lod < lodCount; lod++)
+		{
+			const LodRange& range = lods[lod];
+			assert(range.firstIndex + range.indexCount <= indexCount && range.indexCount % 3 == 0 && "Level of detail out of range");
+
+			const uint32_t* levelIndices = indices + range.firstIndex;
+			const uint32_t triangleCount = range.indexCount / 3;
+			triangleRanges.resize(triangleCount);
 
-				if (index.texcoord_index >= 0)
+			for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+			{
+				const uint32_t a = levelIndices[triangle * 3];
+				const uint32_t b = levelIndices[triangle * 3 + 1];
+				const uint32_t c = levelIndices[triangle * 3 + 2];
+
+				uint32_t target = UINT32_MAX;
+				for (uint32_t placement = firstPlacement[a]; placement != UINT32_MAX && target == UINT32_MAX; placement = placements[placement].next)
 				{
-					vertex.uv = {
-						attrib.texcoords[2 * index.texcoord_index],
-						attrib.texcoords[2 * index.texcoord_index + 1],
-					};
+					const uint32_t candidate = placements[placement].range;
+					if (findLocalIndex(b, candidate) >= 0 && findLocalIndex(c, candidate) >= 0)
+						target = candidate;
 				}
 
-				// Check if the vertex already exists
-				if (uniqueVertices.count(vertex) == 0)
+				if (target == UINT32_MAX)
 				{
-					// If it doesn't exist, set the value (index) of the vertex in the uniqueVertices map to be the current size of the map.
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					// Push back the vertex.
-					vertices.push_back(vertex);
+					// Copy the missing vertices into the open range, or start a new one if they don't fit
+					target = static_cast<uint32_t>(ranges.size()) - 1;
+					const uint32_t missingVertices = (findLocalIndex(a, target) < 0) + (b != a && findLocalIndex(b, target) < 0)
+						+ (c != a && c != b && findLocalIndex(c, target) < 0);
+					if (ranges[target].vertexCount + missingVertices > MAX_SUBMESH_VERTICES)
+					{
+						ranges.push_back({ static_cast<int32_t>(splitVertices.size()), 0 });
+						target++;
+					}
+
+					for (uint32_t vertex : { a, b, c })
+					{
+						if (findLocalIndex(vertex, target) >= 0)
+							continue;
+
+						placements.push_back({ target, static_cast<uint16_t>(ranges[target].vertexCount++), firstPlacement[vertex] });
+						firstPlacement[vertex] = static_cast<uint32_t>(placements.size()) - 1;
+						splitVertices.push_back(vertices[vertex]);
+					}
 				}
 
-				// In all cases, push back the index of the vertex.
-				indices.push_back(uniqueVertices[vertex]);
+				triangleRanges[triangle] = target;
+			}
+
+			// One sub-mesh per range the level draws from. The triangles keep their order within a sub-mesh.
+			rangeIndexCounts.assign(ranges.size(), 0);
+			for (uint32_t target : triangleRanges)
+				rangeIndexCounts[target] += 3;
+
+			Lod level{ static_cast<uint32_t>(subMeshes_.size()), 0, triangleCount, range.error };
+			uint32_t firstIndex = static_cast<uint32_t>(splitIndices.size());
+			rangeWriteOffsets.resize(ranges.size());
+			for (uint32_t target = 0; target < ranges.size(); target++)
+			{
+				if (rangeIndexCounts[target] == 0)
+					continue;
+
+				rangeWriteOffsets[target] = firstIndex;
+				subMeshes_.push_back({ firstIndex, rangeIndexCounts[target], ranges[target].vertexOffset });
+				firstIndex += rangeIndexCounts[target];
+			}
+
+			splitIndices.resize(firstIndex);
+			for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+			{
+				const uint32_t target = triangleRanges[triangle];
+				for (uint32_t corner = 0; corner < 3; corner++)
+					splitIndices[rangeWriteOffsets[target]++] = static_cast<uint16_t>(findLocalIndex(levelIndices[triangle * 3 + corner], target));
+			}
+
+			level.subMeshCount = static_cast<uint32_t>(subMeshes_.size()) - level.firstSubMesh;
+			lods_.push_back(level);
+		}
+
+		DebugPrint("Split into " << subMeshes_.size() << " sub-meshes, " << splitVertices.size() - vertexCount << " vertices duplicated");
+
+		vertexCount = static_cast<uint32_t>(splitVertices.size());
+		return splitVertices.data();
+	}
+
+	void Model::buildMeshlets(const Vertex* vertices, std::vector<uint16_t>& indices)
+	{
+		meshlets_.clear();
+		meshletBounds_.clear();
+
+		for (Lod& lod : lods_)
+		{
+			lod.firstMeshlet = static_cast<uint32_t>(meshlets_.size());
+			if (lod.triangleCount < MESHLET_MIN_TRIANGLES)
+				continue;
+
+			for (uint32_t i = lod.firstSubMesh; i < lod.firstSubMesh + lod.subMeshCount; i++)
+			{
+				const SubMesh& subMesh = subMeshes_[i];
+				MeshletBuilder::build(&vertices[subMesh.vertexOffset].position, sizeof(Vertex), &indices[subMesh.firstIndex], subMesh.indexCount,
+					subMesh.firstIndex, subMesh.vertexOffset, meshlets_, meshletBounds_);
 			}
+			lod.meshletCount = static_cast<uint32_t>(meshlets_.size()) - lod.firstMeshlet;
+		}
+
+		if (!meshlets_.empty())
+		{
+			DebugPrint("Built " << meshlets_.size() << " meshlets");
 		}
 	}
+
+	void Model::Builder::loadModel(std::string_view filePath, JobSystem* jobSystem)
+	{
+		ObjLoader::load(filePath, *this, jobSystem);
+	}
 }
 
 phm::ecs::ModelComponent::ModelComponent(std::shared_ptr<Model>& modelPtr)
@@ -248,14 +479,12 @@ phm::ecs::ModelComponent::ModelComponent(std::shared_ptr<Model>& modelPtr)
 	model = modelPtr;
 }
 
-phm::ecs::ModelComponent::ModelComponent(Device& device, std::string_view filePath)
+phm::ecs::ModelComponent::ModelComponent(Device& device, std::string_view filePath, JobSystem* jobSystem)
 {
-	Model::Builder builder{};
-	builder.loadModel(filePath);
-
-	DebugPrint("Loading model: " << filePath);
-	DebugPrint("Vertex count: " << builder.vertices.size());
-	DebugPrint("Index buffer length: " << builder.indices.size());
+	model = Model::createModelFromFile(device, filePath, jobSystem);
+}
 
-	model = std::make_shared<Model>(device, builder);
+phm::ecs::ModelComponent::ModelComponent(AssetCache& assetCache, std::string_view filePath)
+{
+	model = assetCache.getModel(filePath);
 }
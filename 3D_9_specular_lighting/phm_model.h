@@ -11,11 +11,19 @@
 
 #include "phm_device.h"
 #include "phm_buffer.h"
+#include "phm_bounds.h"
+#include "phm_uploadBatcher.h"
+#include "phm_geometryPool.h"
+#include "phm_vertexFormat.h"
+#include "phm_meshlet.h"
 
 #include "phm_component.h"
 
 namespace phm
 {
+	class JobSystem;
+	class AssetCache;
+
 	class Model
 	{
 	public:
@@ -34,19 +42,63 @@ namespace phm
 			bool operator==(const Vertex& other) const;
 		};
 
+		// Range of the index buffer drawn with one draw call. The indices are relative to vertexOffset.
+		struct SubMesh
+		{
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			int32_t vertexOffset = 0;
+		};
+
+		// Range of the builder indices that makes up one level of detail.
+		struct LodRange
+		{
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			// Largest distance to the full resolution surface, in model units.
+			float error = 0.0f;
+		};
+
+		// Level of detail, drawn as a range of the sub-meshes. Large levels are also split into meshlets.
+		struct Lod
+		{
+			uint32_t firstSubMesh = 0;
+			uint32_t subMeshCount = 0;
+			uint32_t triangleCount = 0;
+			float error = 0.0f;
+			uint32_t firstMeshlet = 0;
+			uint32_t meshletCount = 0;
+		};
+
 		// Temporary helper object for construction of models
 		struct Builder
 		{
 			std::vector<Vertex> vertices{};
 			std::vector<uint32_t> indices{};
+			// Levels of detail from fine to coarse. Empty if all indices make up a single level.
+			std::vector<LodRange> lods{};
 
-			void loadModel(std::string_view filePath);
+			// Parses the file in parallel if a job system is given.
+			void loadModel(std::string_view filePath, JobSystem* jobSystem = nullptr);
 		};
 
 
+		// Indexed meshes use 16 bit indices. Meshes with more vertices are split into sub-meshes that reference at most this many vertices each.
+		static constexpr uint32_t MAX_SUBMESH_VERTICES = 1 << 16;
+
+		// Largest projected simplification error of the selected level of detail, as a fraction of the screen height.
+		static constexpr float LOD_ERROR_THRESHOLD = 1.0f / 1000.0f;
+		// Relative band around the threshold in which the current level of detail is kept, so models don't flicker between levels.
+		static constexpr float LOD_HYSTERESIS = 0.25f;
+
+		// Levels of detail with at least this many triangles are split into meshlets, smaller ones aren't worth culling in pieces.
+		static constexpr uint32_t MESHLET_MIN_TRIANGLES = 2048;
+
 		// Constructors
 
-		Model(Device& device, const Model::Builder& builder);
+		Model(Device& device, const Model::Builder& builder, VertexFormat format = VertexFormat::Full);
+		Model(Device& device, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+			const LodRange* lods = nullptr, uint32_t lodCount = 0, VertexFormat format = VertexFormat::Full);
 		~Model();
 
 		Model(const Model&) = delete;
@@ -54,23 +106,107 @@ namespace phm
 
 		// Public methods
 
-		static std::unique_ptr<Model> createModelFromFile(Device& device, std::string_view filePath);
+		static std::unique_ptr<Model> createModelFromFile(Device& device, std::string_view filePath, JobSystem* jobSystem = nullptr, VertexFormat format = VertexFormat::Full);
+
+		// Vertex input state of the given vertex buffer layout.
+		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexFormat format);
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format);
 
+		// Binds the vertex and index buffers. Pooled models bind the whole geometry pool, which only has to happen once per vertex format.
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		// Draws every sub-mesh of the level of detail, see getDrawCount.
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0, uint32_t lod = 0);
+
+		inline const std::vector<SubMesh>& getSubMeshes() const { return subMeshes_; };
+		// Number of draw calls recorded by draw.
+		inline uint32_t getDrawCount(uint32_t lod = 0) const { return hasIndexBuffer ? lods_[lod].subMeshCount : 1; };
+		inline uint32_t getTriangleCount(uint32_t lod = 0) const { return hasIndexBuffer ? lods_[lod].triangleCount : vertexCount_ / 3; };
+
+		inline const std::vector<Lod>& getLods() const { return lods_; };
+		inline uint32_t getLodCount() const { return hasIndexBuffer ? static_cast<uint32_t>(lods_.size()) : 1; };
+
+		inline bool hasMeshlets(uint32_t lod = 0) const { return hasIndexBuffer && lods_[lod].meshletCount > 0; };
+
+		/// <summary>
+		/// Culls the meshlets of the level of detail and draws the visible ones for a single instance, merging neighbouring meshlets into one draw call.
+		/// The backface test assumes closed meshes with counter clockwise front faces, the winding of OBJ files.
+		/// </summary>
+		/// <param name="frustum">View frustum in model space.</param>
+		/// <param name="cameraPosition">Camera position in model space, only used for cone culling.</param>
+		/// <param name="triangles">Receives the number of triangles drawn.</param>
+		/// <returns>The number of draw calls.</returns>
+		uint32_t drawMeshlets(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t lod,
+			const Frustum& frustum, const glm::vec3& cameraPosition, bool coneCulling, uint32_t& triangles);
+
+		/// <summary>
+		/// Picks the coarsest level of detail whose error stays below LOD_ERROR_THRESHOLD on screen.
+		/// The current level is kept as long as it stays within the hysteresis band around the threshold.
+		/// </summary>
+		/// <param name="projectedRadius">Radius of the bounding sphere on screen, as a fraction of half the screen height.</param>
+		uint32_t selectLod(float projectedRadius, uint32_t currentLod) const;
+
+		// The vertex and index data is uploaded asynchronously. 
+		// Drawing before completion is fine as long as the upload batch is flushed before the frame is submitted.
+		inline UploadBatcher::BatchId getUploadBatch() const { return uploadBatch_; };
+		inline bool isUploaded() const { return device_.getUploadBatcher().isComplete(uploadBatch_); };
+
+		// Bounds in model space, computed from the vertices at load time.
+		inline const AABB& getBoundingBox() const { return boundingBox_; };
+		inline const BoundingSphere& getBoundingSphere() const { return boundingSphere_; };
+
+		inline VertexFormat getVertexFormat() const { return vertexFormat_; };
+
+		// Maps the vertex positions into model space, identity unless the positions are quantized.
+		inline const glm::mat4& getDequantizationMatrix() const { return dequantizationMatrix_; };
+
+		// Size of the vertices and indices on the GPU.
+		inline VkDeviceSize getMemorySize() const { return memorySize_; };
+
+		// True if the geometry lives in the geometry pool of the device, false if the pool was full and the model has buffers of its own.
+		inline bool isPooled() const { return geometry_ != nullptr; };
+
+		// Offsets of the geometry in the bound buffers, zero for dedicated buffers. Added to the sub-mesh ranges by the draws.
+		inline int32_t getBaseVertex() const { return geometry_ ? static_cast<int32_t>(geometry_->firstVertex) : 0; };
+		inline uint32_t getBaseIndex() const { return geometry_ ? geometry_->firstIndex : 0; };
 
 	private:
 		Device& device_;
 
+		// Range of the geometry pool, or the dedicated buffers if the pool was full.
+		GeometryPool::Range* geometry_ = nullptr;
 		std::unique_ptr<Buffer> vertexBuffer_;
 		uint32_t vertexCount_;
+		VertexFormat vertexFormat_;
+		glm::mat4 dequantizationMatrix_{ 1.0f };
 
 		bool hasIndexBuffer = false;
 		std::unique_ptr<Buffer> indexBuffer_;
 		uint32_t indexCount_;
+		std::vector<SubMesh> subMeshes_{};
+		VkDeviceSize memorySize_ = 0;
+		std::vector<Lod> lods_{};
+
+		std::vector<Meshlet> meshlets_{};
+		MeshletBounds meshletBounds_{};
+		// Scratch storage of drawMeshlets
+		std::vector<uint8_t> meshletVisibility_{};
+
+		UploadBatcher::BatchId uploadBatch_ = 0;
+
+		AABB boundingBox_{};
+		BoundingSphere boundingSphere_{};
+
+		void computeBounds(const Vertex* vertices, uint32_t vertexCount);
+		void createBuffers(const Vertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount);
+
+		// Narrows the indices to 16 bits, splitting every level of detail into sub-meshes if the mesh has too many vertices.
+		// The levels share the vertex ranges of the sub-meshes where they can.
+		// Returns the vertices the sub-meshes refer to, which are only copied if the mesh had to be split.
+		const Vertex* buildSubMeshes(const Vertex* vertices, uint32_t& vertexCount, const uint32_t* indices, uint32_t indexCount,
+			const LodRange* lods, uint32_t lodCount, std::vector<Vertex>& splitVertices, std::vector<uint16_t>& splitIndices);
 
-		void createVertexBuffers(const std::vector<Vertex>& vertices);
-		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		// Splits the sub-meshes of the large levels of detail into meshlets, reordering their triangles.
+		void buildMeshlets(const Vertex* vertices, std::vector<uint16_t>& indices);
 	};
 
 
@@ -80,10 +216,14 @@ namespace phm
 		{
 		public:
 			ModelComponent(std::shared_ptr<Model>& model);
-			ModelComponent(Device& device, std::string_view filePath);
+			ModelComponent(Device& device, std::string_view filePath, JobSystem* jobSystem = nullptr);
+			// Shares the model with every other user of the file.
+			ModelComponent(AssetCache& assetCache, std::string_view filePath);
 
 			std::shared_ptr<Model> model{};
 			glm::vec3 color{};
+			// Level of detail drawn last frame, the starting point of the next selection.
+			uint32_t lod = 0;
 		};
 	}
 }
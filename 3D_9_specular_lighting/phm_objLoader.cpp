@@ -0,0 +1,518 @@
+#include "pch.h"
+
+#include "phm_objLoader.h"
+
+#include "phm_mappedFile.h"
+#include "phm_vertexDeduplicator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace phm
+{
+	namespace
+	{
+		enum Attribute : uint32_t
+		{
+			POSITION = 0,
+			TEXCOORD = 1,
+			NORMAL = 2,
+			ATTRIBUTE_COUNT = 3
+		};
+
+		static constexpr int32_t MISSING_INDEX = -1;
+		static constexpr int32_t INVALID_INDEX = INT32_MIN;
+
+		// Zero based attribute indices of a face corner.
+		struct Corner
+		{
+			int32_t attributes[ATTRIBUTE_COUNT];
+		};
+
+		struct Chunk
+		{
+			const char* begin = nullptr;
+			const char* end = nullptr;
+
+			// 3 floats per position, color and normal, 2 per texture coordinate
+			std::vector<float> positions{};
+			std::vector<float> colors{};
+			std::vector<float> normals{};
+			std::vector<float> texcoords{};
+
+			// Corners of the triangulated faces
+			std::vector<Corner> corners{};
+
+			// Negative OBJ indices count back from the current line, so they depend on the attributes of the preceding chunks.
+			// They are stored chunk relative until those are known, and listed here as corner * ATTRIBUTE_COUNT + attribute.
+			std::vector<uint64_t> relativeAttributes{};
+
+			// Global index of the first attribute of each kind in the chunk
+			int64_t offsets[ATTRIBUTE_COUNT]{};
+
+			// Vertices of the chunk, deduplicated within the chunk, and their global index once merged
+			std::vector<Model::Vertex> vertices{};
+			std::vector<uint32_t> indices{};
+			std::vector<uint32_t> remap{};
+			size_t indexOffset = 0;
+
+			std::string error{};
+		};
+
+		inline bool isSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		inline bool isDigit(char c)
+		{
+			return c >= '0' && c <= '9';
+		}
+
+		inline void skipSpaces(const char*& p, const char* end)
+		{
+			while (p < end && isSpace(*p))
+				p++;
+		}
+
+		inline double powerOfTen(int exponent)
+		{
+			static constexpr double exact[] = {
+				1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+			};
+
+			if (exponent >= 0 && exponent <= 22)
+				return exact[exponent];
+			return std::pow(10.0, exponent);
+		}
+
+		// Parses a decimal number like 1, -0.25 or 1.5e-3. Returns false if there is no number at p.
+		// Faster than strtof since it ignores the locale, and exact enough for single precision.
+		bool parseFloat(const char*& p, const char* end, float& value)
+		{
+			const char* s = p;
+
+			bool negative = false;
+			if (s < end && (*s == '-' || *s == '+'))
+			{
+				negative = *s == '-';
+				s++;
+			}
+
+			// Up to 19 significant digits fit the mantissa, the rest only affects the exponent.
+			uint64_t mantissa = 0;
+			int digits = 0;
+			int exponent = 0;
+			bool hasDigits = false;
+
+			for (; s < end && isDigit(*s); s++)
+			{
+				hasDigits = true;
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+					digits += mantissa != 0;
+				}
+				else
+				{
+					exponent++;
+				}
+			}
+
+			if (s < end && *s == '.')
+			{
+				for (s++; s < end && isDigit(*s); s++)
+				{
+					hasDigits = true;
+					if (digits < 19)
+					{
+						mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+						digits += mantissa != 0;
+						exponent--;
+					}
+				}
+			}
+
+			if (!hasDigits)
+				return false;
+
+			if (s < end && (*s == 'e' || *s == 'E'))
+			{
+				const char* e = s + 1;
+
+				bool negativeExponent = false;
+				if (e < end && (*e == '-' || *e == '+'))
+				{
+					negativeExponent = *e == '-';
+					e++;
+				}
+
+				if (e < end && isDigit(*e))
+				{
+					int written = 0;
+					for (; e < end && isDigit(*e); e++)
+					{
+						if (written < 10000)
+							written = written * 10 + (*e - '0');
+					}
+
+					exponent += negativeExponent ? -written : written;
+					s = e;
+				}
+			}
+
+			// Dividing by an exact power of ten rounds better than multiplying by an inexact negative one.
+			double result = static_cast<double>(mantissa);
+			if (mantissa != 0 && exponent > 0)
+				result *= powerOfTen(exponent);
+			else if (mantissa != 0 && exponent < 0)
+				result /= powerOfTen(-exponent);
+
+			value = static_cast<float>(negative ? -result : result);
+			p = s;
+			return true;
+		}
+
+		bool parseInt(const char*& p, const char* end, int64_t& value)
+		{
+			const char* s = p;
+
+			bool negative = false;
+			if (s < end && (*s == '-' || *s == '+'))
+			{
+				negative = *s == '-';
+				s++;
+			}
+
+			if (s >= end || !isDigit(*s))
+				return false;
+
+			int64_t result = 0;
+			for (; s < end && isDigit(*s); s++)
+			{
+				if (result < INT64_MAX / 10)
+					result = result * 10 + (*s - '0');
+			}
+
+			value = negative ? -result : result;
+			p = s;
+			return true;
+		}
+
+		// Parses up to count numbers. Missing numbers are left untouched.
+		uint32_t parseFloats(const char* p, const char* end, float* values, uint32_t count)
+		{
+			uint32_t parsed = 0;
+			while (parsed < count)
+			{
+				skipSpaces(p, end);
+				if (!parseFloat(p, end, values[parsed]))
+					break;
+				parsed++;
+			}
+			return parsed;
+		}
+
+		void parseFace(const char* p, const char* end, Chunk& chunk, std::vector<Corner>& face, std::vector<uint8_t>& faceRelative)
+		{
+			face.clear();
+			faceRelative.clear();
+
+			const int64_t counts[ATTRIBUTE_COUNT] = {
+				static_cast<int64_t>(chunk.positions.size() / 3),
+				static_cast<int64_t>(chunk.texcoords.size() / 2),
+				static_cast<int64_t>(chunk.normals.size() / 3)
+			};
+
+			// Corners look like v, v/vt, v//vn or v/vt/vn
+			while (true)
+			{
+				skipSpaces(p, end);
+				if (p >= end)
+					break;
+
+				Corner corner{ { MISSING_INDEX, MISSING_INDEX, MISSING_INDEX } };
+				uint8_t relativeMask = 0;
+
+				for (uint32_t attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++)
+				{
+					int64_t index;
+					if (parseInt(p, end, index) && index != 0)
+					{
+						if (index > 0)
+						{
+							corner.attributes[attribute] = static_cast<int32_t>(std::min<int64_t>(index - 1, INT32_MAX));
+						}
+						else
+						{
+							corner.attributes[attribute] = static_cast<int32_t>(std::max<int64_t>(counts[attribute] + index, INT32_MIN + 1));
+							relativeMask |= 1 << attribute;
+						}
+					}
+
+					if (p >= end || *p != '/')
+						break;
+					p++;
+				}
+
+				// Skip anything unexpected up to the next corner
+				while (p < end && !isSpace(*p))
+					p++;
+
+				face.push_back(corner);
+				faceRelative.push_back(relativeMask);
+			}
+
+			// Fan triangulation
+			for (size_t i = 1; i + 1 < face.size(); i++)
+			{
+				for (size_t corner : { size_t(0), i, i + 1 })
+				{
+					for (uint32_t attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++)
+					{
+						if (faceRelative[corner] & (1 << attribute))
+							chunk.relativeAttributes.push_back(chunk.corners.size() * ATTRIBUTE_COUNT + attribute);
+					}
+
+					chunk.corners.push_back(face[corner]);
+				}
+			}
+		}
+
+		void parseChunk(Chunk& chunk)
+		{
+			std::vector<Corner> face{};
+			std::vector<uint8_t> faceRelative{};
+
+			const char* line = chunk.begin;
+			while (line < chunk.end)
+			{
+				const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+				if (lineEnd == nullptr)
+					lineEnd = chunk.end;
+
+				const char* p = line;
+				line = lineEnd + 1;
+
+				skipSpaces(p, lineEnd);
+				if (lineEnd - p < 2)
+					continue;
+
+				if (p[0] == 'v' && isSpace(p[1]))
+				{
+					// Positions can be followed by a vertex color, which defaults to white
+					float values[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+					if (parseFloats(p + 1, lineEnd, values, 6) < 6)
+						values[3] = values[4] = values[5] = 1.0f;
+
+					chunk.positions.insert(chunk.positions.end(), values, values + 3);
+					chunk.colors.insert(chunk.colors.end(), values + 3, values + 6);
+				}
+				else if (p[0] == 'v' && p[1] == 'n' && lineEnd - p > 2 && isSpace(p[2]))
+				{
+					float values[3] = { 0.0f, 0.0f, 0.0f };
+					parseFloats(p + 2, lineEnd, values, 3);
+					chunk.normals.insert(chunk.normals.end(), values, values + 3);
+				}
+				else if (p[0] == 'v' && p[1] == 't' && lineEnd - p > 2 && isSpace(p[2]))
+				{
+					float values[2] = { 0.0f, 0.0f };
+					parseFloats(p + 2, lineEnd, values, 2);
+					chunk.texcoords.insert(chunk.texcoords.end(), values, values + 2);
+				}
+				else if (p[0] == 'f' && isSpace(p[1]))
+				{
+					parseFace(p + 2, lineEnd, chunk, face, faceRelative);
+				}
+
+				// Everything else (objects, groups, materials, smoothing groups, lines, ...) doesn't affect the mesh
+			}
+		}
+
+		template<typename T>
+		void appendTo(std::vector<T>& destination, size_t offset, std::vector<T>& source)
+		{
+			std::copy(source.begin(), source.end(), destination.begin() + offset);
+			source = {};
+		}
+
+		void assembleChunk(Chunk& chunk, const std::vector<float>& positions, const std::vector<float>& colors,
+			const std::vector<float>& normals, const std::vector<float>& texcoords)
+		{
+			const int64_t counts[ATTRIBUTE_COUNT] = {
+				static_cast<int64_t>(positions.size() / 3),
+				static_cast<int64_t>(texcoords.size() / 2),
+				static_cast<int64_t>(normals.size() / 3)
+			};
+
+			chunk.indices.reserve(chunk.corners.size());
+			VertexDeduplicator uniqueVertices(chunk.vertices, chunk.corners.size());
+
+			for (const Corner& corner : chunk.corners)
+			{
+				for (uint32_t attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++)
+				{
+					const int32_t index = corner.attributes[attribute];
+					if (index != MISSING_INDEX && (index < 0 || index >= counts[attribute]))
+					{
+						chunk.error = "Face index out of range";
+						return;
+					}
+				}
+
+				Model::Vertex vertex{};
+
+				if (const int32_t index = corner.attributes[POSITION]; index != MISSING_INDEX)
+				{
+					vertex.position = { positions[3 * index], positions[3 * index + 1], positions[3 * index + 2] };
+					vertex.color = { colors[3 * index], colors[3 * index + 1], colors[3 * index + 2] };
+				}
+
+				if (const int32_t index = corner.attributes[NORMAL]; index != MISSING_INDEX)
+					vertex.normal = { normals[3 * index], normals[3 * index + 1], normals[3 * index + 2] };
+
+				if (const int32_t index = corner.attributes[TEXCOORD]; index != MISSING_INDEX)
+					vertex.uv = { texcoords[2 * index], texcoords[2 * index + 1] };
+
+				chunk.indices.push_back(uniqueVertices.insert(vertex));
+			}
+
+			chunk.corners = {};
+		}
+
+		void throwChunkErrors(const std::vector<Chunk>& chunks, std::string_view filePath)
+		{
+			for (const Chunk& chunk : chunks)
+			{
+				if (!chunk.error.empty())
+					throw std::runtime_error(chunk.error + ": " + std::string(filePath));
+			}
+		}
+	}
+
+	void ObjLoader::load(std::string_view filePath, Model::Builder& builder, JobSystem* jobSystem)
+	{
+		MappedFile file{};
+		if (!file.open(std::string(filePath)))
+			throw std::runtime_error("Failed to open model file: " + std::string(filePath));
+
+		const char* data = reinterpret_cast<const char*>(file.data());
+		const size_t size = file.size();
+
+		// Split the file into chunks that end after a newline
+		size_t chunkCount = 1;
+		if (jobSystem != nullptr)
+			chunkCount = std::clamp<size_t>(size / MIN_CHUNK_SIZE, 1, jobSystem->getThreadCount() * 4);
+
+		std::vector<Chunk> chunks(chunkCount);
+		const char* chunkBegin = data;
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			const char* chunkEnd = data + size;
+			if (i + 1 < chunkCount)
+			{
+				chunkEnd = std::max(chunkBegin, data + size * (i + 1) / chunkCount);
+				const void* newline = std::memchr(chunkEnd, '\n', data + size - chunkEnd);
+				chunkEnd = newline != nullptr ? static_cast<const char*>(newline) + 1 : data + size;
+			}
+
+			chunks[i].begin = chunkBegin;
+			chunks[i].end = chunkEnd;
+			chunkBegin = chunkEnd;
+		}
+
+		auto forEachChunk = [&](auto&& func)
+		{
+			if (jobSystem == nullptr)
+			{
+				for (Chunk& chunk : chunks)
+					func(chunk);
+				return;
+			}
+
+			jobSystem->parallelFor(static_cast<uint32_t>(chunkCount), 1, [&](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t i = begin; i < end; i++)
+						func(chunks[i]);
+				});
+		};
+
+		forEachChunk(parseChunk);
+
+		// The attribute offsets of a chunk are the counts of the chunks before it
+		int64_t totals[ATTRIBUTE_COUNT]{};
+		for (Chunk& chunk : chunks)
+		{
+			std::copy(totals, totals + ATTRIBUTE_COUNT, chunk.offsets);
+			totals[POSITION] += chunk.positions.size() / 3;
+			totals[TEXCOORD] += chunk.texcoords.size() / 2;
+			totals[NORMAL] += chunk.normals.size() / 3;
+		}
+
+		if (*std::max_element(totals, totals + ATTRIBUTE_COUNT) > INT32_MAX)
+			throw std::runtime_error("Too many vertex attributes: " + std::string(filePath));
+
+		// Gather the attributes in one array each and resolve the relative indices
+		std::vector<float> positions(totals[POSITION] * 3);
+		std::vector<float> colors(totals[POSITION] * 3);
+		std::vector<float> normals(totals[NORMAL] * 3);
+		std::vector<float> texcoords(totals[TEXCOORD] * 2);
+
+		forEachChunk([&](Chunk& chunk)
+			{
+				appendTo(positions, chunk.offsets[POSITION] * 3, chunk.positions);
+				appendTo(colors, chunk.offsets[POSITION] * 3, chunk.colors);
+				appendTo(normals, chunk.offsets[NORMAL] * 3, chunk.normals);
+				appendTo(texcoords, chunk.offsets[TEXCOORD] * 2, chunk.texcoords);
+
+				for (uint64_t entry : chunk.relativeAttributes)
+				{
+					int32_t& index = chunk.corners[entry / ATTRIBUTE_COUNT].attributes[entry % ATTRIBUTE_COUNT];
+					const int64_t resolved = chunk.offsets[entry % ATTRIBUTE_COUNT] + index;
+					index = resolved >= 0 ? static_cast<int32_t>(resolved) : INVALID_INDEX;
+				}
+				chunk.relativeAttributes = {};
+			});
+
+		forEachChunk([&](Chunk& chunk) { assembleChunk(chunk, positions, colors, normals, texcoords); });
+		throwChunkErrors(chunks, filePath);
+
+		positions = {};
+		colors = {};
+		normals = {};
+		texcoords = {};
+
+		// Merge the chunk vertices in file order, which gives every vertex the index a sequential load would have given it
+		size_t chunkVertexCount = 0;
+		size_t indexCount = 0;
+		for (Chunk& chunk : chunks)
+		{
+			chunkVertexCount += chunk.vertices.size();
+			chunk.indexOffset = indexCount;
+			indexCount += chunk.indices.size();
+		}
+
+		builder.vertices.clear();
+		builder.indices.clear();
+
+		VertexDeduplicator uniqueVertices(builder.vertices, chunkVertexCount);
+		for (Chunk& chunk : chunks)
+		{
+			chunk.remap.resize(chunk.vertices.size());
+			for (size_t i = 0; i < chunk.vertices.size(); i++)
+				chunk.remap[i] = uniqueVertices.insert(chunk.vertices[i]);
+
+			chunk.vertices = {};
+		}
+
+		builder.indices.resize(indexCount);
+		forEachChunk([&](Chunk& chunk)
+			{
+				uint32_t* indices = builder.indices.data() + chunk.indexOffset;
+				for (size_t i = 0; i < chunk.indices.size(); i++)
+					indices[i] = chunk.remap[chunk.indices[i]];
+			});
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef PHM_OBJ_LOADER_H
+#define PHM_OBJ_LOADER_H
+
+#include <string_view>
+
+#include "phm_model.h"
+#include "phm_jobSystem.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Wavefront OBJ importer for large files.
+	/// The mapped file is split into chunks at line boundaries, which are parsed and assembled into vertices in parallel.
+	/// The per chunk vertex tables are merged in file order, so the output is identical to a single threaded load.
+	/// Supports positions (with optional vertex colors), normals, texture coordinates and polygonal faces, which are fan triangulated.
+	/// </summary>
+	class ObjLoader
+	{
+	public:
+		// Files are only split into chunks of at least this size, smaller files aren't worth the overhead.
+		static constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+		/// <summary>
+		/// Loads the file into the vertices and indices of the builder. Throws std::runtime_error on failure.
+		/// </summary>
+		/// <param name="jobSystem">Runs the chunks in parallel if not null.</param>
+		static void load(std::string_view filePath, Model::Builder& builder, JobSystem* jobSystem = nullptr);
+	};
+}
+
+#endif /* PHM_OBJ_LOADER_H */
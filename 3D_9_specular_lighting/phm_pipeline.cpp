@@ -43,8 +43,14 @@ namespace phm
 		std::vector<char> vertCode = readFile(vertFilePath);
 		std::vector<char> fragCode = readFile(fragFilePath);
 
-		createShaderModule(vertCode, &vertexShaderModule_);
-		createShaderModule(fragCode, &fragmentShaderModule_);
+		createShaderModule(device_, vertCode, &vertexShaderModule_);
+		createShaderModule(device_, fragCode, &fragmentShaderModule_);
+
+		VkSpecializationInfo vertexSpecializationInfo{};
+		vertexSpecializationInfo.mapEntryCount = static_cast<uint32_t>(configInfo.vertexSpecializationEntries.size());
+		vertexSpecializationInfo.pMapEntries = configInfo.vertexSpecializationEntries.data();
+		vertexSpecializationInfo.dataSize = configInfo.vertexSpecializationData.size();
+		vertexSpecializationInfo.pData = configInfo.vertexSpecializationData.data();
 
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 		// Specify the vertex shader
@@ -54,7 +60,7 @@ namespace phm
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = configInfo.vertexSpecializationEntries.empty() ? nullptr : &vertexSpecializationInfo;
 
 		// Specify the fragment shader
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -130,14 +136,14 @@ namespace phm
 		return buffer;
 	}
 
-	void Pipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
+	void Pipeline::createShaderModule(Device& device, const std::vector<char>& code, VkShaderModule* shaderModule)
 	{
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		createInfo.codeSize = code.size();
 		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
-		if (vkCreateShaderModule(device_.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
+		if (vkCreateShaderModule(device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create shader module");
 		}
@@ -148,6 +154,47 @@ namespace phm
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline_);
 	}
 
+	ComputePipeline::ComputePipeline(Device& device, const std::string& compFilePath, VkPipelineLayout pipelineLayout)
+		: device_(device)
+	{
+		assert(
+			pipelineLayout != VK_NULL_HANDLE &&
+			"Unable to create compute pipeline: No pipelineLayout provided"
+		);
+
+		std::vector<char> compCode = Pipeline::readFile(compFilePath);
+		Pipeline::createShaderModule(device_, compCode, &computeShaderModule_);
+
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = computeShaderModule_;
+		shaderStage.pName = "main";
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = shaderStage;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		if (vkCreateComputePipelines(device_.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline_) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create compute pipeline");
+		}
+	}
+
+	ComputePipeline::~ComputePipeline()
+	{
+		vkDestroyShaderModule(device_.device(), computeShaderModule_, nullptr);
+		vkDestroyPipeline(device_.device(), computePipeline_, nullptr);
+	}
+
+	void ComputePipeline::bind(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline_);
+	}
+
 	/// <summary>
 	/// Takes in a reference to a configInfo object and writes default values to it.
 	/// </summary>
@@ -16,6 +16,9 @@ namespace phm
 
 		std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+		// Specialization constants of the vertex shader, none if empty.
+		std::vector<VkSpecializationMapEntry> vertexSpecializationEntries{};
+		std::vector<uint8_t> vertexSpecializationData{};
 		VkPipelineViewportStateCreateInfo viewportInfo;
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{};
 		VkPipelineRasterizationStateCreateInfo rasterizationInfo{};
@@ -54,6 +57,8 @@ namespace phm
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
 	private:
+		friend class ComputePipeline;
+
 		// Private member variables
 		Device& device_; // Pipeline has an aggregate relation to the device.
 		VkPipeline graphicsPipeline_;
@@ -69,8 +74,29 @@ namespace phm
 			const std::string& fragFilePath, 
 			const PipelineConfigInfo& configInfo);
 
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+		static void createShaderModule(Device& device, const std::vector<char>& code, VkShaderModule* shaderModule);
+
+	};
+
+	// Pipeline with a single compute shader.
+	class ComputePipeline
+	{
+	public:
+		ComputePipeline(Device& device, const std::string& compFilePath, VkPipelineLayout pipelineLayout);
+		~ComputePipeline();
 
+		// Not copyable or movable
+		ComputePipeline(const ComputePipeline&) = delete;
+		void operator=(const ComputePipeline&) = delete;
+		ComputePipeline(ComputePipeline&&) = delete;
+		ComputePipeline& operator=(ComputePipeline&&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+
+	private:
+		Device& device_;
+		VkPipeline computePipeline_;
+		VkShaderModule computeShaderModule_;
 	};
 
 }
@@ -12,6 +12,8 @@ namespace phm
 {
 	namespace ecs
 	{
+		// Every change bumps the version, so the light registry only uploads the lights that changed.
+		// Static lights are kept apart from the dynamic ones in the light buffer, mark lights that never change as static.
 		class PointlightComponent : public Component
 		{
 		public:
@@ -19,19 +21,25 @@ namespace phm
 			PointlightComponent(glm::vec3 color) : color_(color, 1.0f) {};
 			PointlightComponent(glm::vec3 color, float intensity, float radius = 0.1f) : color_(color, intensity), radius_(radius) {};
 
-			inline void setColor(glm::vec3 color) { color_ = glm::vec4(color, color_.w); };
-			inline void setColor(glm::vec4 colorIntensity) { color_ = colorIntensity; };
-			inline void setIntensity(float intensity) { color_.w = intensity; };
-			inline void setRadius(float radius) { radius_ = radius; };
+			// Setting the current value doesn't count as a change.
+			inline void setColor(glm::vec3 color) { setColor(glm::vec4(color, color_.w)); };
+			inline void setColor(glm::vec4 colorIntensity) { if (colorIntensity != color_) { color_ = colorIntensity; version_++; } };
+			inline void setIntensity(float intensity) { setColor(glm::vec4(getColor(), intensity)); };
+			inline void setRadius(float radius) { if (radius != radius_) { radius_ = radius; version_++; } };
+			inline void setStatic(bool isStatic) { if (isStatic != static_) { static_ = isStatic; version_++; } };
 
 			[[nodiscard]] glm::vec3 getColor() const { return glm::vec3(color_.x, color_.y, color_.z); };
 			[[nodiscard]] glm::vec4 getColorIntensity() const { return color_; };
 			[[nodiscard]] float getIntensity() const { return color_.w; };
 			[[nodiscard]] float getRadius() const { return radius_; };
+			[[nodiscard]] bool isStatic() const { return static_; };
+			[[nodiscard]] uint32_t getVersion() const { return version_; };
 
 		private:
 			glm::vec4 color_ = { 1.0f, 1.0f, 1.0f, 1.0f }; // w is intensity
 			float radius_ = 0.1f;
+			bool static_ = false;
+			uint32_t version_ = 0;
 		};
 	}
 }
@@ -0,0 +1,281 @@
+#include "pch.h"
+
+#include "phm_rangeAllocator.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace phm
+{
+	// Index of the lowest set bit, the value must not be zero.
+	static inline uint32_t findLowestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return static_cast<uint32_t>(index);
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+	}
+
+	// Index of the highest set bit, the value must not be zero.
+	static inline uint32_t findHighestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return static_cast<uint32_t>(index);
+#else
+		return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+	}
+
+	RangeAllocator::RangeAllocator(uint64_t size)
+		: size_(size)
+	{
+		assert(size > 0 && "Cannot create a range allocator without any space!");
+
+		for (auto& firstLevel : freeLists_)
+		{
+			std::fill(std::begin(firstLevel), std::end(firstLevel), INVALID_HANDLE);
+		}
+
+		const uint32_t range = createRange();
+		ranges_[range].offset = 0;
+		ranges_[range].size = size;
+		freeSize_ = size;
+		insertFree(range);
+	}
+
+	RangeAllocator::Allocation RangeAllocator::allocate(uint64_t size, uint64_t alignment)
+	{
+		assert(alignment > 0 && "Alignment must be at least 1!");
+		size = std::max<uint64_t>(size, 1);
+
+		// Search for a range that fits the allocation at any alignment.
+		uint32_t handle = findFreeRange(size + alignment - 1);
+		if (handle == INVALID_HANDLE)
+			return {};
+
+		removeFree(handle);
+
+		// Split off the front padding needed for the alignment.
+		const uint64_t offset = ranges_[handle].offset;
+		const uint64_t alignedOffset = (offset + alignment - 1) / alignment * alignment;
+		if (alignedOffset != offset)
+		{
+			const uint32_t padding = createRange();
+			Range& range = ranges_[handle];
+
+			ranges_[padding].offset = offset;
+			ranges_[padding].size = alignedOffset - offset;
+			ranges_[padding].previousPhysical = range.previousPhysical;
+			ranges_[padding].nextPhysical = handle;
+			if (range.previousPhysical != INVALID_HANDLE)
+				ranges_[range.previousPhysical].nextPhysical = padding;
+
+			range.previousPhysical = padding;
+			range.offset = alignedOffset;
+			range.size -= alignedOffset - offset;
+			insertFree(padding);
+		}
+
+		// Return the rest of the range to the free lists.
+		if (ranges_[handle].size > size)
+		{
+			const uint32_t remainder = createRange();
+			Range& range = ranges_[handle];
+
+			ranges_[remainder].offset = range.offset + size;
+			ranges_[remainder].size = range.size - size;
+			ranges_[remainder].previousPhysical = handle;
+			ranges_[remainder].nextPhysical = range.nextPhysical;
+			if (range.nextPhysical != INVALID_HANDLE)
+				ranges_[range.nextPhysical].previousPhysical = remainder;
+
+			range.nextPhysical = remainder;
+			range.size = size;
+			insertFree(remainder);
+		}
+
+		Range& range = ranges_[handle];
+		range.isFree = false;
+		freeSize_ -= range.size;
+		allocationCount_++;
+
+		return { range.offset, range.size, handle };
+	}
+
+	void RangeAllocator::free(uint32_t handle)
+	{
+		assert(handle < ranges_.size() && !ranges_[handle].isFree && "Tried to free a range that isn't allocated!");
+
+		freeSize_ += ranges_[handle].size;
+		allocationCount_--;
+
+		// Merge with the free neighbours, so there are never two free ranges next to each other.
+		const uint32_t previous = ranges_[handle].previousPhysical;
+		if (previous != INVALID_HANDLE && ranges_[previous].isFree)
+		{
+			removeFree(previous);
+			mergeWithNext(previous);
+			handle = previous;
+		}
+
+		const uint32_t next = ranges_[handle].nextPhysical;
+		if (next != INVALID_HANDLE && ranges_[next].isFree)
+		{
+			removeFree(next);
+			mergeWithNext(handle);
+		}
+
+		insertFree(handle);
+	}
+
+	uint64_t RangeAllocator::getLargestFreeRange() const
+	{
+		if (firstLevelBitmap_ == 0)
+			return 0;
+
+		// The largest range is in the highest non empty size class.
+		const uint32_t firstLevel = findHighestBit(firstLevelBitmap_);
+		const uint32_t secondLevel = findHighestBit(secondLevelBitmaps_[firstLevel]);
+
+		uint64_t largest = 0;
+		for (uint32_t handle = freeLists_[firstLevel][secondLevel]; handle != INVALID_HANDLE; handle = ranges_[handle].nextFree)
+		{
+			largest = std::max(largest, ranges_[handle].size);
+		}
+		return largest;
+	}
+
+	void RangeAllocator::mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+	{
+		if (size < SMALL_SIZE)
+		{
+			firstLevel = 0;
+			secondLevel = static_cast<uint32_t>(size / (SMALL_SIZE / SECOND_LEVEL_COUNT));
+			return;
+		}
+
+		const uint32_t highestBit = findHighestBit(size);
+		firstLevel = highestBit - SMALL_SIZE_LOG2 + 1;
+		secondLevel = static_cast<uint32_t>(size >> (highestBit - SECOND_LEVEL_LOG2)) - SECOND_LEVEL_COUNT;
+	}
+
+	uint32_t RangeAllocator::findFreeRange(uint64_t size) const
+	{
+		// Round up to the next size class, so every range in the found class is large enough.
+		if (size < SMALL_SIZE)
+			size += SMALL_SIZE / SECOND_LEVEL_COUNT - 1;
+		else
+			size += (1ull << (findHighestBit(size) - SECOND_LEVEL_LOG2)) - 1;
+
+		uint32_t firstLevel, secondLevel;
+		mapping(size, firstLevel, secondLevel);
+
+		if (firstLevel >= FIRST_LEVEL_COUNT)
+			return INVALID_HANDLE;
+
+		uint32_t secondLevelMap = secondLevelBitmaps_[firstLevel] & (~0u << secondLevel);
+		if (secondLevelMap == 0)
+		{
+			// Nothing in this first level, take the smallest larger one.
+			const uint64_t firstLevelMap = firstLevel + 1 < 64 ? firstLevelBitmap_ & (~0ull << (firstLevel + 1)) : 0;
+			if (firstLevelMap == 0)
+				return INVALID_HANDLE;
+
+			firstLevel = findLowestBit(firstLevelMap);
+			secondLevelMap = secondLevelBitmaps_[firstLevel];
+		}
+
+		return freeLists_[firstLevel][findLowestBit(secondLevelMap)];
+	}
+
+	uint32_t RangeAllocator::createRange()
+	{
+		if (unusedRanges_ == INVALID_HANDLE)
+		{
+			ranges_.emplace_back();
+			return static_cast<uint32_t>(ranges_.size() - 1);
+		}
+
+		const uint32_t handle = unusedRanges_;
+		unusedRanges_ = ranges_[handle].nextFree;
+		ranges_[handle] = Range{};
+		return handle;
+	}
+
+	void RangeAllocator::releaseRange(uint32_t handle)
+	{
+		ranges_[handle] = Range{};
+		ranges_[handle].nextFree = unusedRanges_;
+		unusedRanges_ = handle;
+	}
+
+	void RangeAllocator::insertFree(uint32_t handle)
+	{
+		Range& range = ranges_[handle];
+
+		uint32_t firstLevel, secondLevel;
+		mapping(range.size, firstLevel, secondLevel);
+
+		uint32_t& head = freeLists_[firstLevel][secondLevel];
+		range.isFree = true;
+		range.previousFree = INVALID_HANDLE;
+		range.nextFree = head;
+		if (head != INVALID_HANDLE)
+			ranges_[head].previousFree = handle;
+		head = handle;
+
+		firstLevelBitmap_ |= 1ull << firstLevel;
+		secondLevelBitmaps_[firstLevel] |= 1u << secondLevel;
+		freeRangeCount_++;
+	}
+
+	void RangeAllocator::removeFree(uint32_t handle)
+	{
+		Range& range = ranges_[handle];
+
+		uint32_t firstLevel, secondLevel;
+		mapping(range.size, firstLevel, secondLevel);
+
+		if (range.previousFree != INVALID_HANDLE)
+			ranges_[range.previousFree].nextFree = range.nextFree;
+		if (range.nextFree != INVALID_HANDLE)
+			ranges_[range.nextFree].previousFree = range.previousFree;
+
+		uint32_t& head = freeLists_[firstLevel][secondLevel];
+		if (head == handle)
+		{
+			head = range.nextFree;
+			if (head == INVALID_HANDLE)
+			{
+				secondLevelBitmaps_[firstLevel] &= ~(1u << secondLevel);
+				if (secondLevelBitmaps_[firstLevel] == 0)
+					firstLevelBitmap_ &= ~(1ull << firstLevel);
+			}
+		}
+
+		range.isFree = false;
+		range.previousFree = INVALID_HANDLE;
+		range.nextFree = INVALID_HANDLE;
+		freeRangeCount_--;
+	}
+
+	void RangeAllocator::mergeWithNext(uint32_t handle)
+	{
+		const uint32_t next = ranges_[handle].nextPhysical;
+
+		ranges_[handle].size += ranges_[next].size;
+		ranges_[handle].nextPhysical = ranges_[next].nextPhysical;
+		if (ranges_[next].nextPhysical != INVALID_HANDLE)
+			ranges_[ranges_[next].nextPhysical].previousPhysical = handle;
+
+		releaseRange(next);
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef PHM_RANGE_ALLOCATOR_H
+#define PHM_RANGE_ALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+namespace phm
+{
+	/// <summary>
+	/// Two level segregated fit (TLSF) allocator for ranges of an external resource, such as a block of device memory.
+	/// No memory is touched, the allocator only hands out offsets.
+	/// Allocation and freeing are O(1), and neighbouring free ranges are merged when freed.
+	/// </summary>
+	class RangeAllocator
+	{
+	public:
+		static constexpr uint32_t INVALID_HANDLE = UINT32_MAX;
+
+		struct Allocation
+		{
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			uint32_t handle = INVALID_HANDLE;
+
+			inline bool isValid() const { return handle != INVALID_HANDLE; };
+		};
+
+		RangeAllocator(uint64_t size);
+
+		/// <summary>
+		/// Finds a free range of the given size. The offset is a multiple of alignment.
+		/// Returns an invalid allocation if no range large enough is free.
+		/// </summary>
+		Allocation allocate(uint64_t size, uint64_t alignment = 1);
+		void free(uint32_t handle);
+
+		inline uint64_t getSize() const { return size_; };
+		inline uint64_t getFreeSize() const { return freeSize_; };
+		inline uint32_t getAllocationCount() const { return allocationCount_; };
+		inline uint32_t getFreeRangeCount() const { return freeRangeCount_; };
+		inline bool isEmpty() const { return allocationCount_ == 0; };
+
+		uint64_t getLargestFreeRange() const;
+
+	private:
+		// Sizes below SMALL_SIZE share the first level, the rest is split per power of two.
+		static constexpr uint32_t SECOND_LEVEL_LOG2 = 4;
+		static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_LOG2;
+		static constexpr uint32_t SMALL_SIZE_LOG2 = 8;
+		static constexpr uint64_t SMALL_SIZE = 1ull << SMALL_SIZE_LOG2;
+		static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - SMALL_SIZE_LOG2 + 1;
+
+		struct Range
+		{
+			uint64_t offset = 0;
+			uint64_t size = 0;
+
+			// Neighbouring ranges in the resource
+			uint32_t previousPhysical = INVALID_HANDLE;
+			uint32_t nextPhysical = INVALID_HANDLE;
+
+			// Neighbouring ranges in the free list of the size class. nextFree also links unused range nodes.
+			uint32_t previousFree = INVALID_HANDLE;
+			uint32_t nextFree = INVALID_HANDLE;
+
+			bool isFree = false;
+		};
+
+		uint64_t size_;
+		uint64_t freeSize_ = 0;
+		uint32_t allocationCount_ = 0;
+		uint32_t freeRangeCount_ = 0;
+
+		std::vector<Range> ranges_{};
+		uint32_t unusedRanges_ = INVALID_HANDLE;
+
+		uint64_t firstLevelBitmap_ = 0;
+		uint32_t secondLevelBitmaps_[FIRST_LEVEL_COUNT]{};
+		uint32_t freeLists_[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+
+		static void mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+		uint32_t findFreeRange(uint64_t size) const;
+
+		uint32_t createRange();
+		void releaseRange(uint32_t handle);
+
+		void insertFree(uint32_t handle);
+		void removeFree(uint32_t handle);
+
+		void mergeWithNext(uint32_t handle);
+	};
+}
+
+#endif /* PHM_RANGE_ALLOCATOR_H */
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "phm_renderer.h"
+#include "phm_uploadBatcher.h"
 
 #include <stdexcept>
 #include <array>
@@ -120,6 +121,9 @@ namespace phm
 			throw std::runtime_error("Failed to end recording command buffer");
 		}
 
+		// Uploads queued during the frame have to be submitted before the commands that use them.
+		device_.getUploadBatcher().flush();
+
 		auto result = swapchain_->submitCommandBuffers(&commandBuffer, &currentImageIndex_);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window_.wasWindowResized())
@@ -0,0 +1,142 @@
+#include "pch.h"
+
+#include "phm_scheduler.h"
+#include "phm_entity.h"
+
+#include <algorithm>
+
+namespace phm
+{
+	namespace ecs
+	{
+		void SystemScheduler::addSystem(SystemStage stage, std::unique_ptr<System> system)
+		{
+			auto node = std::make_unique<Node>();
+			node->system = std::move(system);
+			node->stage = stage;
+			node->insertionIndex = static_cast<uint32_t>(nodes_.size());
+			nodes_.push_back(std::move(node));
+
+			graphDirty_ = true;
+		}
+
+		void SystemScheduler::run(const FrameInfo& frameInfo, ArchetypeStorage& storage)
+		{
+			if (graphDirty_)
+				buildGraph();
+
+			const SystemContext context{ frameInfo, storage, jobSystem_, parallel_ };
+
+			storage.setStructureLocked(true);
+
+			if (!parallel_)
+			{
+				// The nodes are sorted, so this is a valid topological order.
+				for (auto& node : nodes_)
+					node->system->update(context);
+			}
+			else
+			{
+				JobSystem::Counter counter;
+				for (auto& node : nodes_)
+					node->remainingDependencies.store(node->dependencyCount, std::memory_order_relaxed);
+
+				for (auto& node : nodes_)
+				{
+					if (node->dependencyCount == 0)
+					{
+						Node* ptr = node.get();
+						jobSystem_.run(counter, [this, ptr, &context, &counter]() { runNode(*ptr, context, counter); });
+					}
+				}
+
+				jobSystem_.wait(counter);
+			}
+
+			storage.setStructureLocked(false);
+		}
+
+		void SystemScheduler::buildGraph()
+		{
+			std::stable_sort(nodes_.begin(), nodes_.end(), [](const auto& a, const auto& b)
+				{
+					if (a->stage != b->stage)
+						return a->stage < b->stage;
+					return a->insertionIndex < b->insertionIndex;
+				});
+
+			for (auto& node : nodes_)
+			{
+				node->dependents.clear();
+				node->dependencyCount = 0;
+			}
+
+			// A system depends on every earlier system it conflicts with.
+			for (uint32_t i = 0; i < nodes_.size(); i++)
+			{
+				for (uint32_t j = i + 1; j < nodes_.size(); j++)
+				{
+					if (nodes_[i]->system->getAccess().conflictsWith(nodes_[j]->system->getAccess()))
+					{
+						nodes_[i]->dependents.push_back(j);
+						nodes_[j]->dependencyCount++;
+					}
+				}
+			}
+
+			graphDirty_ = false;
+		}
+
+		void SystemScheduler::runNode(Node& node, const SystemContext& context, JobSystem::Counter& counter)
+		{
+			node.system->update(context);
+
+			// Release the dependents. They are submitted before this task finishes, so the counter can't reach zero early.
+			for (uint32_t dependent : node.dependents)
+			{
+				Node* ptr = nodes_[dependent].get();
+				if (ptr->remainingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					jobSystem_.run(counter, [this, ptr, &context, &counter]() { runNode(*ptr, context, counter); });
+			}
+		}
+
+
+		ComponentUpdateSystem::ComponentUpdateSystem(ComponentTypeID componentType)
+			: System("Component update"), componentType_(componentType)
+		{
+			assert(getComponentInfo(componentType).update != nullptr && "Component type doesn't override update");
+
+			// Component::update gets its entity, so it can read and write any component of it.
+			// Declaring every component as written keeps the update from running alongside any other system.
+			access_.writes.set();
+		}
+
+		void ComponentUpdateSystem::update(const SystemContext& context)
+		{
+			const ComponentInfo& info = getComponentInfo(componentType_);
+
+			ComponentBitSet signature{};
+			signature.set(componentType_);
+
+			for (const Archetype* archetype : context.storage.getMatchingArchetypes(signature))
+			{
+				context.parallelFor(static_cast<uint32_t>(archetype->getChunkCount()),
+					[&](uint32_t begin, uint32_t end)
+					{
+						for (uint32_t chunk = begin; chunk < end; chunk++)
+						{
+							std::byte* components = static_cast<std::byte*>(archetype->getColumn(chunk, componentType_));
+							const EntityId* entities = archetype->getEntities(chunk);
+							const uint32_t count = archetype->getChunkSize(chunk);
+
+							for (uint32_t i = 0; i < count; i++)
+							{
+								Entity entity{ context.storage, entities[i] };
+								info.update(components + i * info.size, entity);
+							}
+						}
+					});
+			}
+		}
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef PHM_SCHEDULER_H
+#define PHM_SCHEDULER_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "phm_system.h"
+
+namespace phm
+{
+	namespace ecs
+	{
+		// Systems run in stage order. Within a stage, systems with conflicting component access run in the order they were added.
+		enum class SystemStage
+		{
+			Update,
+			PostUpdate,
+		};
+
+		// Runs systems on the job system. A dependency graph is built from the declared component access of the systems,
+		// so systems that don't touch the same components run concurrently, while conflicting systems keep their order.
+		// This makes the result independent of whether the systems run in parallel or serially.
+		class SystemScheduler
+		{
+		public:
+			SystemScheduler(JobSystem& jobSystem) : jobSystem_(jobSystem) {};
+
+			SystemScheduler(const SystemScheduler&) = delete;
+			SystemScheduler& operator=(const SystemScheduler&) = delete;
+
+			template<typename T, typename... TArgs>
+			T& addSystem(SystemStage stage, TArgs&&... mArgs)
+			{
+				auto system = std::make_unique<T>(std::forward<TArgs>(mArgs)...);
+				T& ref = *system;
+				addSystem(stage, std::move(system));
+				return ref;
+			}
+			void addSystem(SystemStage stage, std::unique_ptr<System> system);
+
+			void run(const FrameInfo& frameInfo, ArchetypeStorage& storage);
+
+			// Runs all systems on the calling thread in a valid order. Useful for debugging and for verifying determinism.
+			inline void setParallel(bool parallel) { parallel_ = parallel; };
+			[[nodiscard]] inline bool isParallel() const { return parallel_; };
+
+		private:
+			struct Node
+			{
+				std::unique_ptr<System> system;
+				SystemStage stage;
+				uint32_t insertionIndex;
+
+				std::vector<uint32_t> dependents{};
+				uint32_t dependencyCount = 0;
+				std::atomic<uint32_t> remainingDependencies{ 0 };
+			};
+
+			JobSystem& jobSystem_;
+			std::vector<std::unique_ptr<Node>> nodes_;
+			bool graphDirty_ = false;
+			bool parallel_ = true;
+
+			void buildGraph();
+			void runNode(Node& node, const SystemContext& context, JobSystem::Counter& counter);
+		};
+
+
+		// Calls Component::update on every component of one type. 
+		// Components may only modify their own entity in update, which allows the chunks to be updated in parallel.
+		class ComponentUpdateSystem : public System
+		{
+		public:
+			ComponentUpdateSystem(ComponentTypeID componentType);
+
+			void update(const SystemContext& context) override;
+
+		private:
+			ComponentTypeID componentType_;
+		};
+	}
+}
+
+#endif /* PHM_SCHEDULER_H */
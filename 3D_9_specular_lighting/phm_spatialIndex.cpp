@@ -0,0 +1,453 @@
+#include "pch.h"
+
+#include "phm_spatialIndex.h"
+
+#include <algorithm>
+
+namespace phm
+{
+	namespace ecs
+	{
+		void SpatialIndex::beginUpdate()
+		{
+			stamp_++;
+		}
+
+		void SpatialIndex::endUpdate()
+		{
+			for (int32_t leaf : leaves_)
+			{
+				if (leaf != NULL_NODE && nodes_[leaf].stamp != stamp_)
+					remove(nodes_[leaf].entity);
+			}
+		}
+
+		bool SpatialIndex::update(EntityId entity, const AABB& box, const BoundingSphere& sphere)
+		{
+			assert(!entity.isNull() && "Cannot add a null entity to the spatial index!");
+
+			if (entity.index >= leaves_.size())
+				leaves_.resize(entity.index + 1, NULL_NODE);
+
+			int32_t leaf = leaves_[entity.index];
+
+			// The slot was reused by a new entity.
+			if (leaf != NULL_NODE && nodes_[leaf].entity != entity)
+			{
+				remove(nodes_[leaf].entity);
+				leaf = NULL_NODE;
+			}
+
+			if (leaf != NULL_NODE)
+			{
+				Node& node = nodes_[leaf];
+				node.sphere = sphere;
+				node.stamp = stamp_;
+
+				if (node.box.contains(box))
+					return false;
+
+				removeLeaf(leaf);
+				nodes_[leaf].box = box.expanded(AABB_MARGIN);
+				insertLeaf(leaf);
+				return true;
+			}
+
+			leaf = allocateNode();
+			Node& node = nodes_[leaf];
+			node.box = box.expanded(AABB_MARGIN);
+			node.entity = entity;
+			node.sphere = sphere;
+			node.stamp = stamp_;
+
+			leaves_[entity.index] = leaf;
+			leafCount_++;
+			insertLeaf(leaf);
+			return true;
+		}
+
+		void SpatialIndex::remove(EntityId entity)
+		{
+			if (entity.index >= leaves_.size())
+				return;
+
+			const int32_t leaf = leaves_[entity.index];
+			if (leaf == NULL_NODE || nodes_[leaf].entity != entity)
+				return;
+
+			removeLeaf(leaf);
+			freeNode(leaf);
+			leaves_[entity.index] = NULL_NODE;
+			leafCount_--;
+		}
+
+		void SpatialIndex::clear()
+		{
+			nodes_.clear();
+			leaves_.clear();
+			root_ = NULL_NODE;
+			freeList_ = NULL_NODE;
+			leafCount_ = 0;
+		}
+
+		void SpatialIndex::queryFrustum(const Frustum& frustum, std::vector<EntityId>& result) const
+		{
+			if (root_ == NULL_NODE)
+				return;
+
+			// Leaves on the border of the frustum are tested in one batch against their tight bounds.
+			std::vector<EntityId> candidates{};
+			SphereBoundsSoA candidateBounds{};
+
+			std::vector<int32_t> stack{};
+			stack.reserve(64);
+			stack.push_back(root_);
+
+			while (!stack.empty())
+			{
+				const int32_t index = stack.back();
+				stack.pop_back();
+
+				const Node& node = nodes_[index];
+				const Containment containment = frustum.classifyAABB(node.box);
+
+				if (containment == Containment::Outside)
+					continue;
+
+				// Everything below a node that is fully inside is visible.
+				if (containment == Containment::Inside)
+				{
+					collectLeaves(index, result);
+					continue;
+				}
+
+				if (node.isLeaf())
+				{
+					candidates.push_back(node.entity);
+					candidateBounds.push_back(node.sphere);
+				}
+				else
+				{
+					stack.push_back(node.child1);
+					stack.push_back(node.child2);
+				}
+			}
+
+			std::vector<uint8_t> visible(candidates.size());
+			cullSpheres(frustum, candidateBounds, visible.data());
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				if (visible[i])
+					result.push_back(candidates[i]);
+			}
+		}
+
+		EntityId SpatialIndex::raycast(const Ray& ray, float maxDistance, float* hitDistance) const
+		{
+			EntityId closest{};
+			if (root_ == NULL_NODE)
+				return closest;
+
+			const glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+			std::vector<int32_t> stack{};
+			stack.reserve(64);
+			stack.push_back(root_);
+
+			while (!stack.empty())
+			{
+				const Node& node = nodes_[stack.back()];
+				stack.pop_back();
+
+				// maxDistance shrinks with every hit, so farther nodes are skipped.
+				float entryDistance = 0.0f;
+				if (!node.box.intersectsRay(ray, inverseDirection, maxDistance, entryDistance))
+					continue;
+
+				if (node.isLeaf())
+				{
+					float distance = 0.0f;
+					if (node.sphere.intersectsRay(ray, maxDistance, distance))
+					{
+						maxDistance = distance;
+						closest = node.entity;
+					}
+				}
+				else
+				{
+					stack.push_back(node.child1);
+					stack.push_back(node.child2);
+				}
+			}
+
+			if (hitDistance != nullptr && !closest.isNull())
+				*hitDistance = maxDistance;
+
+			return closest;
+		}
+
+		int32_t SpatialIndex::allocateNode()
+		{
+			if (freeList_ == NULL_NODE)
+			{
+				nodes_.emplace_back();
+				return static_cast<int32_t>(nodes_.size() - 1);
+			}
+
+			const int32_t index = freeList_;
+			freeList_ = nodes_[index].parent;
+			nodes_[index] = Node{};
+			return index;
+		}
+
+		void SpatialIndex::freeNode(int32_t index)
+		{
+			nodes_[index].parent = freeList_;
+			nodes_[index].height = -1;
+			freeList_ = index;
+		}
+
+		void SpatialIndex::insertLeaf(int32_t leaf)
+		{
+			if (root_ == NULL_NODE)
+			{
+				root_ = leaf;
+				nodes_[root_].parent = NULL_NODE;
+				return;
+			}
+
+			// Find the best sibling by descending towards the child with the lowest surface area cost.
+			const AABB leafBox = nodes_[leaf].box;
+			int32_t index = root_;
+			while (!nodes_[index].isLeaf())
+			{
+				const Node& node = nodes_[index];
+
+				const float area = node.box.surfaceArea();
+				const float combinedArea = AABB::merge(node.box, leafBox).surfaceArea();
+
+				// Cost of creating a new parent for this node and the leaf.
+				const float cost = 2.0f * combinedArea;
+
+				// Minimum cost of pushing the leaf further down the tree.
+				const float inheritanceCost = 2.0f * (combinedArea - area);
+
+				auto descendCost = [&](int32_t child)
+				{
+					const Node& childNode = nodes_[child];
+					const float mergedArea = AABB::merge(leafBox, childNode.box).surfaceArea();
+					return childNode.isLeaf() ? mergedArea + inheritanceCost : mergedArea - childNode.box.surfaceArea() + inheritanceCost;
+				};
+
+				const float cost1 = descendCost(node.child1);
+				const float cost2 = descendCost(node.child2);
+
+				if (cost < cost1 && cost < cost2)
+					break;
+
+				index = cost1 < cost2 ? node.child1 : node.child2;
+			}
+
+			const int32_t sibling = index;
+
+			// Create a new parent for the sibling and the leaf.
+			const int32_t oldParent = nodes_[sibling].parent;
+			const int32_t newParent = allocateNode();
+			nodes_[newParent].parent = oldParent;
+			nodes_[newParent].box = AABB::merge(leafBox, nodes_[sibling].box);
+			nodes_[newParent].height = nodes_[sibling].height + 1;
+			nodes_[newParent].child1 = sibling;
+			nodes_[newParent].child2 = leaf;
+			nodes_[sibling].parent = newParent;
+			nodes_[leaf].parent = newParent;
+
+			if (oldParent != NULL_NODE)
+			{
+				if (nodes_[oldParent].child1 == sibling)
+					nodes_[oldParent].child1 = newParent;
+				else
+					nodes_[oldParent].child2 = newParent;
+			}
+			else
+			{
+				root_ = newParent;
+			}
+
+			refitAncestors(nodes_[leaf].parent);
+		}
+
+		void SpatialIndex::removeLeaf(int32_t leaf)
+		{
+			if (leaf == root_)
+			{
+				root_ = NULL_NODE;
+				return;
+			}
+
+			const int32_t parent = nodes_[leaf].parent;
+			const int32_t grandParent = nodes_[parent].parent;
+			const int32_t sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+			// The sibling takes the place of the parent.
+			if (grandParent != NULL_NODE)
+			{
+				if (nodes_[grandParent].child1 == parent)
+					nodes_[grandParent].child1 = sibling;
+				else
+					nodes_[grandParent].child2 = sibling;
+
+				nodes_[sibling].parent = grandParent;
+				freeNode(parent);
+				refitAncestors(grandParent);
+			}
+			else
+			{
+				root_ = sibling;
+				nodes_[sibling].parent = NULL_NODE;
+				freeNode(parent);
+			}
+		}
+
+		void SpatialIndex::refitAncestors(int32_t index)
+		{
+			while (index != NULL_NODE)
+			{
+				index = balance(index);
+
+				Node& node = nodes_[index];
+				const Node& child1 = nodes_[node.child1];
+				const Node& child2 = nodes_[node.child2];
+
+				node.height = 1 + std::max(child1.height, child2.height);
+				node.box = AABB::merge(child1.box, child2.box);
+
+				index = node.parent;
+			}
+		}
+
+		int32_t SpatialIndex::balance(int32_t indexA)
+		{
+			// Rotates the taller grandchild up if the subtree of A is unbalanced.
+			Node& a = nodes_[indexA];
+			if (a.isLeaf() || a.height < 2)
+				return indexA;
+
+			const int32_t indexB = a.child1;
+			const int32_t indexC = a.child2;
+			Node& b = nodes_[indexB];
+			Node& c = nodes_[indexC];
+
+			const int32_t heightDifference = c.height - b.height;
+
+			auto replaceChild = [this](int32_t parent, int32_t oldChild, int32_t newChild)
+			{
+				if (parent == NULL_NODE)
+				{
+					root_ = newChild;
+					return;
+				}
+
+				if (nodes_[parent].child1 == oldChild)
+					nodes_[parent].child1 = newChild;
+				else
+					nodes_[parent].child2 = newChild;
+			};
+
+			// Rotate C up
+			if (heightDifference > 1)
+			{
+				const int32_t indexF = c.child1;
+				const int32_t indexG = c.child2;
+				Node& f = nodes_[indexF];
+				Node& g = nodes_[indexG];
+
+				c.child1 = indexA;
+				c.parent = a.parent;
+				a.parent = indexC;
+				replaceChild(c.parent, indexA, indexC);
+
+				if (f.height > g.height)
+				{
+					c.child2 = indexF;
+					a.child2 = indexG;
+					g.parent = indexA;
+					a.box = AABB::merge(b.box, g.box);
+					c.box = AABB::merge(a.box, f.box);
+					a.height = 1 + std::max(b.height, g.height);
+					c.height = 1 + std::max(a.height, f.height);
+				}
+				else
+				{
+					c.child2 = indexG;
+					a.child2 = indexF;
+					f.parent = indexA;
+					a.box = AABB::merge(b.box, f.box);
+					c.box = AABB::merge(a.box, g.box);
+					a.height = 1 + std::max(b.height, f.height);
+					c.height = 1 + std::max(a.height, g.height);
+				}
+
+				return indexC;
+			}
+
+			// Rotate B up
+			if (heightDifference < -1)
+			{
+				const int32_t indexD = b.child1;
+				const int32_t indexE = b.child2;
+				Node& d = nodes_[indexD];
+				Node& e = nodes_[indexE];
+
+				b.child1 = indexA;
+				b.parent = a.parent;
+				a.parent = indexB;
+				replaceChild(b.parent, indexA, indexB);
+
+				if (d.height > e.height)
+				{
+					b.child2 = indexD;
+					a.child1 = indexE;
+					e.parent = indexA;
+					a.box = AABB::merge(c.box, e.box);
+					b.box = AABB::merge(a.box, d.box);
+					a.height = 1 + std::max(c.height, e.height);
+					b.height = 1 + std::max(a.height, d.height);
+				}
+				else
+				{
+					b.child2 = indexE;
+					a.child1 = indexD;
+					d.parent = indexA;
+					a.box = AABB::merge(c.box, d.box);
+					b.box = AABB::merge(a.box, e.box);
+					a.height = 1 + std::max(c.height, d.height);
+					b.height = 1 + std::max(a.height, e.height);
+				}
+
+				return indexB;
+			}
+
+			return indexA;
+		}
+
+		void SpatialIndex::collectLeaves(int32_t index, std::vector<EntityId>& result) const
+		{
+			std::vector<int32_t> stack{ index };
+			while (!stack.empty())
+			{
+				const Node& node = nodes_[stack.back()];
+				stack.pop_back();
+
+				if (node.isLeaf())
+				{
+					result.push_back(node.entity);
+				}
+				else
+				{
+					stack.push_back(node.child1);
+					stack.push_back(node.child2);
+				}
+			}
+		}
+	}
+}
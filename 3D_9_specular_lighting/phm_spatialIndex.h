@@ -0,0 +1,126 @@
+#ifndef PHM_SPATIAL_INDEX_H
+#define PHM_SPATIAL_INDEX_H
+
+#include <cstdint>
+#include <vector>
+
+#include "phm_bounds.h"
+#include "phm_component.h"
+
+namespace phm
+{
+	namespace ecs
+	{
+		// Dynamic bounding volume hierarchy over entity bounds.
+		// Leaves store a box fattened by a margin, so an entity that moves a little doesn't touch the tree.
+		// A leaf is only reinserted once its bounds leave the fat box, and the tree is rebalanced with rotations on the way up.
+		class SpatialIndex
+		{
+		public:
+			static constexpr int32_t NULL_NODE = -1;
+			static constexpr float AABB_MARGIN = 0.1f;
+
+			SpatialIndex() = default;
+
+			SpatialIndex(const SpatialIndex&) = delete;
+			SpatialIndex& operator=(const SpatialIndex&) = delete;
+
+			// Entities that aren't updated between beginUpdate and endUpdate are removed from the index.
+			void beginUpdate();
+			void endUpdate();
+
+			// Inserts the entity or refits its leaf. Returns true if the tree had to change.
+			bool update(EntityId entity, const AABB& box, const BoundingSphere& sphere);
+			void remove(EntityId entity);
+			void clear();
+
+			// Appends the entities whose bounds intersect the frustum.
+			void queryFrustum(const Frustum& frustum, std::vector<EntityId>& result) const;
+
+			// Calls func(EntityId) for every entity whose bounds intersect the sphere.
+			template<typename Func>
+			void querySphere(const glm::vec3& center, float radius, Func&& func) const;
+
+			// Returns the entity whose bounding sphere the ray hits first, or a null id.
+			EntityId raycast(const Ray& ray, float maxDistance, float* hitDistance = nullptr) const;
+
+			inline uint32_t size() const { return leafCount_; };
+			inline int32_t getHeight() const { return root_ == NULL_NODE ? 0 : nodes_[root_].height; };
+
+		private:
+			struct Node
+			{
+				AABB box{}; // Fattened for leaves
+
+				int32_t parent = NULL_NODE; // Next free node while on the free list
+				int32_t child1 = NULL_NODE;
+				int32_t child2 = NULL_NODE;
+
+				// Leaves are 0, free nodes are -1
+				int32_t height = 0;
+
+				// Leaf data
+				EntityId entity{};
+				BoundingSphere sphere{};
+				uint32_t stamp = 0;
+
+				inline bool isLeaf() const { return child1 == NULL_NODE; };
+			};
+
+			std::vector<Node> nodes_{};
+			int32_t root_ = NULL_NODE;
+			int32_t freeList_ = NULL_NODE;
+			uint32_t leafCount_ = 0;
+
+			// Leaf of every entity, indexed by the entity index.
+			std::vector<int32_t> leaves_{};
+			uint32_t stamp_ = 0;
+
+			int32_t allocateNode();
+			void freeNode(int32_t index);
+
+			void insertLeaf(int32_t leaf);
+			void removeLeaf(int32_t leaf);
+			void refitAncestors(int32_t index);
+			int32_t balance(int32_t index);
+
+			void collectLeaves(int32_t index, std::vector<EntityId>& result) const;
+		};
+
+
+		template<typename Func>
+		inline void SpatialIndex::querySphere(const glm::vec3& center, float radius, Func&& func) const
+		{
+			if (root_ == NULL_NODE)
+				return;
+
+			std::vector<int32_t> stack{};
+			stack.reserve(64);
+			stack.push_back(root_);
+
+			while (!stack.empty())
+			{
+				const Node& node = nodes_[stack.back()];
+				stack.pop_back();
+
+				if (!node.box.intersectsSphere(center, radius))
+					continue;
+
+				if (node.isLeaf())
+				{
+					const glm::vec3 offset = node.sphere.center - center;
+					const float reach = node.sphere.radius + radius;
+					if (glm::dot(offset, offset) <= reach * reach)
+						func(node.entity);
+				}
+				else
+				{
+					stack.push_back(node.child1);
+					stack.push_back(node.child2);
+				}
+			}
+		}
+	}
+}
+
+#endif /* PHM_SPATIAL_INDEX_H */
@@ -54,7 +54,7 @@ namespace phm
 		{
 			vkDestroyImageView(device_.device(), depthImageViews_[i], nullptr);
 			vkDestroyImage(device_.device(), depthImages_[i], nullptr);
-			vkFreeMemory(device_.device(), depthImageMemories_[i], nullptr);
+			device_.freeMemory(depthImageMemories_[i]);
 		}
 
 		for (auto framebuffer : swapChainFramebuffers_)
@@ -0,0 +1,98 @@
+#ifndef PHM_SYSTEM_H
+#define PHM_SYSTEM_H
+
+#include <string>
+#include <string_view>
+
+#include "phm_archetype.h"
+#include "phm_view.h"
+#include "phm_jobSystem.h"
+#include "phm_frame_info.h"
+
+namespace phm
+{
+	namespace ecs
+	{
+		// The components a system reads and writes. Used by the scheduler to find the systems that can run concurrently.
+		struct SystemAccess
+		{
+			ComponentBitSet reads{};
+			ComponentBitSet writes{};
+
+			// Two systems conflict if one of them writes a component the other one accesses.
+			[[nodiscard]] inline bool conflictsWith(const SystemAccess& other) const
+			{
+				return (writes & (other.reads | other.writes)).any() || (other.writes & reads).any();
+			};
+		};
+
+		struct SystemContext
+		{
+			const FrameInfo& frameInfo;
+			ArchetypeStorage& storage;
+			JobSystem& jobSystem;
+			// False if the scheduler runs serially, then everything runs on the calling thread.
+			bool parallel;
+
+			template<typename... Ts>
+			inline View<Ts...> view() const { return View<Ts...>(storage); };
+
+			// Calls func(uint32_t begin, uint32_t end) for ranges covering [0, count),
+			// spread over the job system if the scheduler runs in parallel, otherwise inline.
+			template<typename Func>
+			void parallelFor(uint32_t count, Func&& func) const
+			{
+				if (parallel)
+					jobSystem.parallelFor(count, jobSystem.getBatchSize(count), func);
+				else if (count > 0)
+					func(0u, count);
+			}
+
+			// Calls func(uint32_t count, const EntityId* entities, Ts*... columns) for every chunk of the view,
+			// spreading the chunks over the job system.
+			template<typename... Ts, typename Func>
+			void parallelEachChunk(const View<Ts...>& view, Func&& func) const
+			{
+				for (const Archetype* archetype : view.getArchetypes())
+				{
+					parallelFor(static_cast<uint32_t>(archetype->getChunkCount()),
+						[archetype, &func](uint32_t begin, uint32_t end)
+						{
+							for (uint32_t chunk = begin; chunk < end; chunk++)
+								func(archetype->getChunkSize(chunk), archetype->getEntities(chunk), archetype->template getColumn<Ts>(chunk)...);
+						});
+				}
+			}
+		};
+
+		// A unit of per frame work on the entities of a scene.
+		// Systems must declare every component they access in their constructor, and may not add or remove components or entities in update.
+		class System
+		{
+		public:
+			System(std::string_view name) : name_(name) {};
+			virtual ~System() = default;
+
+			System(const System&) = delete;
+			System& operator=(const System&) = delete;
+
+			virtual void update(const SystemContext& context) = 0;
+
+			[[nodiscard]] inline const SystemAccess& getAccess() const { return access_; };
+			[[nodiscard]] inline const std::string& getName() const { return name_; };
+
+		protected:
+			template<typename... Ts>
+			inline void readsComponents() { (access_.reads.set(getComponentTypeID<Ts>()), ...); };
+			template<typename... Ts>
+			inline void writesComponents() { (access_.writes.set(getComponentTypeID<Ts>()), ...); };
+
+			SystemAccess access_{};
+
+		private:
+			std::string name_;
+		};
+	}
+}
+
+#endif /* PHM_SYSTEM_H */
@@ -6,43 +6,43 @@ namespace phm
 {
     glm::mat4 Transform::mat4() const
     {
-        const float c3 = glm::cos(rotation.z);
-        const float s3 = glm::sin(rotation.z);
-        const float c2 = glm::cos(rotation.x);
-        const float s2 = glm::sin(rotation.x);
-        const float c1 = glm::cos(rotation.y);
-        const float s1 = glm::sin(rotation.y);
+        const float c3 = glm::cos(rotation_.z);
+        const float s3 = glm::sin(rotation_.z);
+        const float c2 = glm::cos(rotation_.x);
+        const float s2 = glm::sin(rotation_.x);
+        const float c1 = glm::cos(rotation_.y);
+        const float s1 = glm::sin(rotation_.y);
         return glm::mat4{
             {
-                scale.x * (c1 * c3 + s1 * s2 * s3),
-                scale.x * (c2 * s3),
-                scale.x * (c1 * s2 * s3 - c3 * s1),
+                scale_.x * (c1 * c3 + s1 * s2 * s3),
+                scale_.x * (c2 * s3),
+                scale_.x * (c1 * s2 * s3 - c3 * s1),
                 0.0f,
             },
             {
-                scale.y * (c3 * s1 * s2 - c1 * s3),
-                scale.y * (c2 * c3),
-                scale.y * (c1 * c3 * s2 + s1 * s3),
+                scale_.y * (c3 * s1 * s2 - c1 * s3),
+                scale_.y * (c2 * c3),
+                scale_.y * (c1 * c3 * s2 + s1 * s3),
                 0.0f,
             },
             {
-                scale.z * (c2 * s1),
-                scale.z * (-s2),
-                scale.z * (c1 * c2),
+                scale_.z * (c2 * s1),
+                scale_.z * (-s2),
+                scale_.z * (c1 * c2),
                 0.0f,
             },
-            {translation.x, translation.y, translation.z, 1.0f} };
+            {translation_.x, translation_.y, translation_.z, 1.0f} };
     }
 
     glm::mat3 Transform::normalMatrix() const
     {
-        const float c3 = glm::cos(rotation.z);
-        const float s3 = glm::sin(rotation.z);
-        const float c2 = glm::cos(rotation.x);
-        const float s2 = glm::sin(rotation.x);
-        const float c1 = glm::cos(rotation.y);
-        const float s1 = glm::sin(rotation.y);
-        const glm::vec3 invScale = 1.0f / scale;
+        const float c3 = glm::cos(rotation_.z);
+        const float s3 = glm::sin(rotation_.z);
+        const float c2 = glm::cos(rotation_.x);
+        const float s2 = glm::sin(rotation_.x);
+        const float c1 = glm::cos(rotation_.y);
+        const float s1 = glm::sin(rotation_.y);
+        const glm::vec3 invScale = 1.0f / scale_;
 
         return glm::mat3{
             {
@@ -8,16 +8,30 @@
 
 namespace phm
 {
-	struct Transform
+	// Position, rotation and scale of an entity.
+	// Every change bumps the version, so data derived from the transform can be cached and only recomputed when the version differs.
+	class Transform
 	{
-		glm::vec3 translation{};
-		glm::vec3 scale{ 1.0f, 1.0f, 1.0f };
+	public:
+		inline const glm::vec3& getTranslation() const { return translation_; };
+		inline const glm::vec3& getRotation() const { return rotation_; };
+		inline const glm::vec3& getScale() const { return scale_; };
 
+		// Setting the current value doesn't count as a change.
+		inline void setTranslation(const glm::vec3& translation) { if (translation != translation_) { translation_ = translation; version_++; } };
+		inline void setRotation(const glm::vec3& rotation) { if (rotation != rotation_) { rotation_ = rotation; version_++; } };
+		inline void setScale(const glm::vec3& scale) { if (scale != scale_) { scale_ = scale; version_++; } };
+
+		inline uint32_t getVersion() const { return version_; };
 
 		glm::mat4 mat4() const;
 		glm::mat3 normalMatrix() const;
 
-		glm::vec3 rotation{};
+	private:
+		glm::vec3 translation_{};
+		glm::vec3 scale_{ 1.0f, 1.0f, 1.0f };
+		glm::vec3 rotation_{};
+		uint32_t version_ = 0;
 	};
 }
 
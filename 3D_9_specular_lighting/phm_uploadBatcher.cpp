@@ -0,0 +1,287 @@
+#include "pch.h"
+
+#include "phm_uploadBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace phm
+{
+	UploadBatcher::UploadBatcher(Device& device, VkDeviceSize stagingSize)
+		: device_(device), ringSize_(stagingSize)
+	{
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device_.findPhysicalQueueFamilies().graphicsFamily.value();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(device_.device(), &poolInfo, nullptr, &commandPool_) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload command pool!");
+		}
+
+		stagingRing_ = std::make_unique<Buffer>(
+			device_,
+			ringSize_,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			);
+		stagingRing_->map();
+	}
+
+	UploadBatcher::~UploadBatcher()
+	{
+		waitIdle();
+
+		for (Batch& batch : freeBatches_)
+		{
+			vkDestroyFence(device_.device(), batch.fence, nullptr);
+		}
+
+		// Destroying the pool frees the command buffers.
+		vkDestroyCommandPool(device_.device(), commandPool_, nullptr);
+	}
+
+	UploadBatcher::BatchId UploadBatcher::upload(VkBuffer destination, const void* data, VkDeviceSize size, VkDeviceSize destinationOffset)
+	{
+		assert(size > 0 && "Cannot upload an empty range!");
+
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		VkDeviceSize stagingOffset = 0;
+		if (allocateStaging(size, stagingOffset))
+		{
+			memcpy(static_cast<char*>(stagingRing_->getMappedMemory()) + stagingOffset, data, size);
+			pendingCopies_.push_back({ stagingRing_->getBuffer(), destination, { stagingOffset, destinationOffset, size } });
+		}
+		else
+		{
+			// Too large for the ring, give the upload a staging buffer of its own.
+			auto staging = std::make_unique<Buffer>(
+				device_,
+				size,
+				1,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				);
+			staging->map();
+			staging->writeToBuffer(const_cast<void*>(data));
+
+			pendingCopies_.push_back({ staging->getBuffer(), destination, { 0, destinationOffset, size } });
+			pendingOversizedStaging_.push_back(std::move(staging));
+		}
+
+		return nextBatchId_;
+	}
+
+	UploadBatcher::BatchId UploadBatcher::flush()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		retireCompleted();
+		return flushLocked();
+	}
+
+	bool UploadBatcher::isComplete(BatchId batch)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		retireCompleted();
+		return batch <= completedBatchId_;
+	}
+
+	void UploadBatcher::wait(BatchId batch)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (batch >= nextBatchId_)
+			flushLocked();
+
+		while (completedBatchId_ < batch && !inFlight_.empty())
+		{
+			waitForOldest();
+		}
+	}
+
+	void UploadBatcher::waitIdle()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		flushLocked();
+		while (!inFlight_.empty())
+		{
+			waitForOldest();
+		}
+	}
+
+	bool UploadBatcher::allocateStaging(VkDeviceSize size, VkDeviceSize& offset)
+	{
+		if (size > ringSize_)
+			return false;
+
+		constexpr VkDeviceSize alignment = 16;
+
+		while (true)
+		{
+			// Start at the beginning of the ring when it's empty, so the whole ring is available.
+			if (ringHead_ == ringTail_ && ringHead_ % ringSize_ != 0)
+			{
+				ringHead_ += ringSize_ - ringHead_ % ringSize_;
+				ringTail_ = ringHead_;
+			}
+
+			const VkDeviceSize position = ringHead_ % ringSize_;
+			VkDeviceSize alignedPosition = (position + alignment - 1) / alignment * alignment;
+
+			// Skip the end of the ring if the data doesn't fit before it wraps around.
+			if (alignedPosition + size > ringSize_)
+				alignedPosition = ringSize_;
+
+			const VkDeviceSize advance = alignedPosition - position + size;
+			if (ringHead_ + advance - ringTail_ <= ringSize_)
+			{
+				offset = alignedPosition % ringSize_;
+				ringHead_ += advance;
+				return true;
+			}
+
+			// The ring is full. Submit the queued copies so their space can be reclaimed, then wait for the oldest batch.
+			flushLocked();
+			waitForOldest();
+		}
+	}
+
+	UploadBatcher::BatchId UploadBatcher::flushLocked()
+	{
+		if (pendingCopies_.empty())
+			return nextBatchId_ - 1;
+
+		Batch batch = acquireBatch();
+		batch.id = nextBatchId_++;
+		batch.ringEnd = ringHead_;
+		batch.oversizedStaging = std::move(pendingOversizedStaging_);
+		pendingOversizedStaging_.clear();
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+		// Group the copies by source and destination, so each pair takes a single copy command.
+		std::stable_sort(pendingCopies_.begin(), pendingCopies_.end(), [](const PendingCopy& a, const PendingCopy& b)
+			{
+				return a.source != b.source ? a.source < b.source : a.destination < b.destination;
+			});
+
+		std::vector<VkBufferCopy> regions{};
+		for (size_t begin = 0; begin < pendingCopies_.size();)
+		{
+			const PendingCopy& first = pendingCopies_[begin];
+
+			regions.clear();
+			size_t end = begin;
+			while (end < pendingCopies_.size() && pendingCopies_[end].source == first.source && pendingCopies_[end].destination == first.destination)
+			{
+				regions.push_back(pendingCopies_[end].region);
+				end++;
+			}
+
+			vkCmdCopyBuffer(batch.commandBuffer, first.source, first.destination, static_cast<uint32_t>(regions.size()), regions.data());
+			begin = end;
+		}
+
+		// Make the copies visible to everything submitted after this batch.
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(
+			batch.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to record upload command buffer!");
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+		if (vkQueueSubmit(device_.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+
+		pendingCopies_.clear();
+
+		const BatchId id = batch.id;
+		inFlight_.push_back(std::move(batch));
+		return id;
+	}
+
+	void UploadBatcher::retireCompleted()
+	{
+		while (!inFlight_.empty() && vkGetFenceStatus(device_.device(), inFlight_.front().fence) == VK_SUCCESS)
+		{
+			waitForOldest();
+		}
+	}
+
+	void UploadBatcher::waitForOldest()
+	{
+		assert(!inFlight_.empty() && "No upload batch in flight!");
+
+		Batch batch = std::move(inFlight_.front());
+		inFlight_.pop_front();
+
+		vkWaitForFences(device_.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+
+		// The staging data of the batch is no longer needed.
+		ringTail_ = batch.ringEnd;
+		completedBatchId_ = batch.id;
+		batch.oversizedStaging.clear();
+
+		vkResetFences(device_.device(), 1, &batch.fence);
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+		freeBatches_.push_back(std::move(batch));
+	}
+
+	UploadBatcher::Batch UploadBatcher::acquireBatch()
+	{
+		if (!freeBatches_.empty())
+		{
+			Batch batch = std::move(freeBatches_.back());
+			freeBatches_.pop_back();
+			return batch;
+		}
+
+		Batch batch{};
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool_;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(device_.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(device_.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload fence!");
+		}
+
+		return batch;
+	}
+}
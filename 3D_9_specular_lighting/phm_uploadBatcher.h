@@ -0,0 +1,109 @@
+#ifndef PHM_UPLOAD_BATCHER_H
+#define PHM_UPLOAD_BATCHER_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "phm_device.h"
+#include "phm_buffer.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Batches buffer uploads into a single command buffer.
+	/// Data is copied into a persistently mapped staging ring, and the copies are recorded and submitted together on flush.
+	/// Every submitted batch signals a fence, so callers can poll or wait for their upload without idling the queue.
+	/// </summary>
+	class UploadBatcher
+	{
+	public:
+		using BatchId = uint64_t;
+
+		static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 32ull * 1024 * 1024;
+
+		UploadBatcher(Device& device, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+		~UploadBatcher();
+
+		UploadBatcher(const UploadBatcher&) = delete;
+		UploadBatcher& operator=(const UploadBatcher&) = delete;
+
+		/// <summary>
+		/// Copies the data into the staging ring and queues a copy to the destination buffer.
+		/// The data can be discarded right after the call.
+		/// </summary>
+		/// <returns>The batch the copy is part of.</returns>
+		BatchId upload(VkBuffer destination, const void* data, VkDeviceSize size, VkDeviceSize destinationOffset = 0);
+
+		/// <summary>
+		/// Records and submits the queued copies. Later submissions on the graphics queue see the uploaded data.
+		/// Submits on the graphics queue, so it must not be called while another thread submits to it.
+		/// </summary>
+		/// <returns>The id of the submitted batch.</returns>
+		BatchId flush();
+
+		// Returns true once the batch has finished executing on the GPU.
+		bool isComplete(BatchId batch);
+
+		// Submits the batch if needed and blocks until it has finished executing.
+		void wait(BatchId batch);
+
+		// Submits and waits for everything queued so far.
+		void waitIdle();
+
+	private:
+		struct PendingCopy
+		{
+			VkBuffer source;
+			VkBuffer destination;
+			VkBufferCopy region;
+		};
+
+		struct Batch
+		{
+			BatchId id = 0;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+
+			// Ring position the staging data of the batch ends at.
+			uint64_t ringEnd = 0;
+
+			// Staging buffers for uploads that don't fit the ring.
+			std::vector<std::unique_ptr<Buffer>> oversizedStaging{};
+		};
+
+		Device& device_;
+		VkCommandPool commandPool_ = VK_NULL_HANDLE;
+
+		std::unique_ptr<Buffer> stagingRing_;
+		VkDeviceSize ringSize_;
+
+		// Monotonic byte counters, the ring position is the counter modulo the ring size.
+		uint64_t ringHead_ = 0;
+		uint64_t ringTail_ = 0;
+
+		std::vector<PendingCopy> pendingCopies_{};
+		std::vector<std::unique_ptr<Buffer>> pendingOversizedStaging_{};
+
+		std::deque<Batch> inFlight_{};
+		std::vector<Batch> freeBatches_{};
+
+		BatchId nextBatchId_ = 1;
+		BatchId completedBatchId_ = 0;
+
+		std::mutex mutex_;
+
+		// Reserves ring space, submitting and waiting for older batches if the ring is full.
+		// Returns false if the size can never fit the ring.
+		bool allocateStaging(VkDeviceSize size, VkDeviceSize& offset);
+
+		BatchId flushLocked();
+		void retireCompleted();
+		void waitForOldest();
+		Batch acquireBatch();
+	};
+}
+
+#endif /* PHM_UPLOAD_BATCHER_H */
@@ -0,0 +1,113 @@
+#include "pch.h"
+
+#include "phm_vertexDeduplicator.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace phm
+{
+	// Hashing and comparing the raw bytes is only valid if the vertex has no padding.
+	static_assert(sizeof(Model::Vertex) == 11 * sizeof(float), "Model::Vertex must be tightly packed");
+
+	static constexpr size_t VERTEX_WORDS = sizeof(Model::Vertex) / sizeof(uint32_t);
+
+	// Keeps the load factor at or below 7/8.
+	static inline size_t capacityFor(size_t count)
+	{
+		size_t capacity = 16;
+		while (capacity - capacity / 8 < count)
+			capacity *= 2;
+		return capacity;
+	}
+
+	VertexDeduplicator::VertexDeduplicator(std::vector<Model::Vertex>& vertices, size_t expectedCount)
+		: vertices_(vertices)
+	{
+		rehash(capacityFor(std::max(expectedCount, vertices_.size())));
+
+		// Vertices already in the vector are valid targets too.
+		for (size_t i = 0; i < vertices_.size(); i++)
+		{
+			const uint64_t hash = hashVertex(vertices_[i]);
+			size_t slot = static_cast<size_t>(hash) & mask_;
+			while (slots_[slot].index != EMPTY)
+				slot = (slot + 1) & mask_;
+
+			slots_[slot] = { static_cast<uint32_t>(hash >> 32), static_cast<uint32_t>(i) };
+			count_++;
+		}
+	}
+
+	uint32_t VertexDeduplicator::insert(const Model::Vertex& vertex)
+	{
+		if (count_ + 1 > slots_.size() - slots_.size() / 8)
+			rehash(slots_.size() * 2);
+
+		// The low bits pick the slot, the high bits are stored to filter candidates.
+		const uint64_t hash = hashVertex(vertex);
+		const uint32_t tag = static_cast<uint32_t>(hash >> 32);
+
+		size_t slot = static_cast<size_t>(hash) & mask_;
+		while (true)
+		{
+			Slot& candidate = slots_[slot];
+
+			if (candidate.index == EMPTY)
+			{
+				const uint32_t index = static_cast<uint32_t>(vertices_.size());
+				vertices_.push_back(vertex);
+
+				candidate = { tag, index };
+				count_++;
+				return index;
+			}
+
+			if (candidate.hash == tag && std::memcmp(&vertices_[candidate.index], &vertex, sizeof(Model::Vertex)) == 0)
+				return candidate.index;
+
+			slot = (slot + 1) & mask_;
+		}
+	}
+
+	uint64_t VertexDeduplicator::hashVertex(const Model::Vertex& vertex)
+	{
+		uint32_t words[VERTEX_WORDS];
+		std::memcpy(words, &vertex, sizeof(Model::Vertex));
+
+		// Multiply-xorshift over the 32 bit words, followed by a final avalanche.
+		uint64_t hash = 0x9E3779B97F4A7C15ull;
+		for (size_t i = 0; i < VERTEX_WORDS; i++)
+		{
+			hash ^= words[i];
+			hash *= 0xFF51AFD7ED558CCDull;
+			hash ^= hash >> 32;
+		}
+
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB9FE1A85EC53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	void VertexDeduplicator::rehash(size_t capacity)
+	{
+		std::vector<Slot> old = std::move(slots_);
+
+		slots_.assign(capacity, Slot{});
+		mask_ = capacity - 1;
+
+		for (const Slot& entry : old)
+		{
+			if (entry.index == EMPTY)
+				continue;
+
+			// Only the high half of the hash is stored, so the slot is recomputed from the vertex.
+			size_t slot = static_cast<size_t>(hashVertex(vertices_[entry.index])) & mask_;
+			while (slots_[slot].index != EMPTY)
+				slot = (slot + 1) & mask_;
+
+			slots_[slot] = entry;
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef PHM_VERTEX_DEDUPLICATOR_H
+#define PHM_VERTEX_DEDUPLICATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "phm_model.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Open addressing hash table that merges identical vertices while building an index buffer.
+	/// Vertices are keyed on their raw bytes and stored once in the output vector, the table only holds their indices.
+	/// </summary>
+	class VertexDeduplicator
+	{
+	public:
+		/// <summary>
+		/// Unique vertices are appended to the given vector.
+		/// </summary>
+		/// <param name="expectedCount">Upper bound of the unique vertex count, usually the index count of the source mesh. The table is sized so it never has to grow below this count.</param>
+		VertexDeduplicator(std::vector<Model::Vertex>& vertices, size_t expectedCount);
+
+		VertexDeduplicator(const VertexDeduplicator&) = delete;
+		VertexDeduplicator& operator=(const VertexDeduplicator&) = delete;
+
+		/// <summary>
+		/// Returns the index of the vertex, appending it to the vertices if it wasn't seen before.
+		/// </summary>
+		uint32_t insert(const Model::Vertex& vertex);
+
+		static uint64_t hashVertex(const Model::Vertex& vertex);
+
+	private:
+		static constexpr uint32_t EMPTY = UINT32_MAX;
+
+		// The hash is kept next to the index, so most mismatches are rejected without touching the vertex.
+		struct Slot
+		{
+			uint32_t hash = 0;
+			uint32_t index = EMPTY;
+		};
+
+		std::vector<Model::Vertex>& vertices_;
+		std::vector<Slot> slots_{};
+		size_t mask_ = 0;
+		size_t count_ = 0;
+
+		void rehash(size_t capacity);
+	};
+}
+
+#endif /* PHM_VERTEX_DEDUPLICATOR_H */
@@ -0,0 +1,200 @@
+#include "pch.h"
+
+#include "phm_vertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace phm
+{
+	static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex must be tightly packed");
+
+	QuantizedVertex QuantizedVertex::encode(const glm::vec3& position, const glm::vec3& color, const glm::vec3& normal, const glm::vec2& uv, const AABB& bounds)
+	{
+		QuantizedVertex vertex{};
+
+		const glm::vec3 size = bounds.max - bounds.min;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			// A flat axis has nothing to quantize
+			const float relative = size[axis] > 0.0f ? (position[axis] - bounds.min[axis]) / size[axis] : 0.0f;
+			vertex.position[axis] = packing::packUnorm16(relative);
+		}
+		vertex.position[3] = 0;
+
+		vertex.normal = packing::packOctahedral(normal);
+
+		vertex.uv[0] = packing::packHalf(uv.x);
+		vertex.uv[1] = packing::packHalf(uv.y);
+
+		vertex.color[0] = packing::packUnorm8(color.x);
+		vertex.color[1] = packing::packUnorm8(color.y);
+		vertex.color[2] = packing::packUnorm8(color.z);
+		vertex.color[3] = 255;
+
+		return vertex;
+	}
+
+	std::vector<VkVertexInputBindingDescription> QuantizedVertex::getBindingDescriptions()
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(QuantizedVertex);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> QuantizedVertex::getAttributeDescriptions()
+	{
+		// The locations match Model::Vertex, so the same shader reads both. All of these formats are mandatory for vertex buffers.
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+		attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R16G16B16A16_UNORM,	offsetof(QuantizedVertex, position) });	// position
+		attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R8G8B8A8_UNORM,		offsetof(QuantizedVertex, color) });	// color
+		attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R16G16_SNORM,			offsetof(QuantizedVertex, normal) });	// normal
+		attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R16G16_SFLOAT,		offsetof(QuantizedVertex, uv) });		// uv
+
+		return attributeDescriptions;
+	}
+
+	glm::mat4 QuantizedVertex::getDequantizationMatrix(const AABB& bounds)
+	{
+		const glm::vec3 size = bounds.max - bounds.min;
+
+		glm::mat4 matrix{ 1.0f };
+		matrix[0][0] = size.x;
+		matrix[1][1] = size.y;
+		matrix[2][2] = size.z;
+		matrix[3] = glm::vec4(bounds.min, 1.0f);
+		return matrix;
+	}
+
+
+	uint16_t packing::packUnorm16(float value)
+	{
+		return static_cast<uint16_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	int16_t packing::packSnorm16(float value)
+	{
+		return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	uint8_t packing::packUnorm8(float value)
+	{
+		return static_cast<uint8_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+	}
+
+	uint16_t packing::packHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const uint32_t exponent = (bits >> 23) & 0xFF;
+		uint32_t mantissa = bits & 0x7FFFFF;
+
+		// Infinity and NaN, NaN keeps a mantissa bit set
+		if (exponent == 0xFF)
+			return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+
+		const int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+		if (halfExponent >= 0x1F)
+			return static_cast<uint16_t>(sign | 0x7C00);
+
+		uint32_t half;
+		uint32_t remainder;
+		uint32_t halfway;
+		if (halfExponent <= 0)
+		{
+			// Subnormal half, shift the mantissa with its implicit bit into place
+			if (halfExponent < -10)
+				return static_cast<uint16_t>(sign);
+
+			mantissa |= 0x800000;
+			const uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+			half = mantissa >> shift;
+			remainder = mantissa & ((1u << shift) - 1);
+			halfway = 1u << (shift - 1);
+		}
+		else
+		{
+			half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+			remainder = mantissa & 0x1FFF;
+			halfway = 0x1000;
+		}
+
+		// Round to nearest even. A carry out of the mantissa correctly bumps the exponent.
+		if (remainder > halfway || (remainder == halfway && (half & 1) != 0))
+			half++;
+
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	float packing::unpackHalf(uint16_t value)
+	{
+		const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+		const uint32_t exponent = (value >> 10) & 0x1F;
+		const uint32_t mantissa = value & 0x3FF;
+
+		float result;
+		if (exponent == 0)
+		{
+			result = std::ldexp(static_cast<float>(mantissa), -24);
+		}
+		else if (exponent == 0x1F)
+		{
+			const uint32_t bits = 0x7F800000 | (mantissa << 13);
+			std::memcpy(&result, &bits, sizeof(result));
+		}
+		else
+		{
+			const uint32_t bits = ((exponent - 15 + 127) << 23) | (mantissa << 13);
+			std::memcpy(&result, &bits, sizeof(result));
+		}
+
+		return sign != 0 ? -result : result;
+	}
+
+	uint32_t packing::packOctahedral(const glm::vec3& normal)
+	{
+		const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+		if (length == 0.0f)
+			return 0;
+
+		glm::vec2 octahedral = glm::vec2(normal.x, normal.y) / length;
+
+		// Fold the lower hemisphere over the diagonals
+		if (normal.z < 0.0f)
+		{
+			const glm::vec2 folded{ 1.0f - std::abs(octahedral.y), 1.0f - std::abs(octahedral.x) };
+			octahedral.x = octahedral.x >= 0.0f ? folded.x : -folded.x;
+			octahedral.y = octahedral.y >= 0.0f ? folded.y : -folded.y;
+		}
+
+		const uint16_t x = static_cast<uint16_t>(packSnorm16(octahedral.x));
+		const uint16_t y = static_cast<uint16_t>(packSnorm16(octahedral.y));
+		return static_cast<uint32_t>(x) | (static_cast<uint32_t>(y) << 16);
+	}
+
+	glm::vec3 packing::unpackOctahedral(uint32_t value)
+	{
+		// Same decode as the vertex shader, snorm16 maps -32768 and -32767 to -1
+		const float x = std::max(static_cast<int16_t>(value & 0xFFFF) / 32767.0f, -1.0f);
+		const float y = std::max(static_cast<int16_t>(value >> 16) / 32767.0f, -1.0f);
+
+		glm::vec3 normal{ x, y, 1.0f - std::abs(x) - std::abs(y) };
+		if (normal.z < 0.0f)
+		{
+			const float foldedX = 1.0f - std::abs(y);
+			const float foldedY = 1.0f - std::abs(x);
+			normal.x = x >= 0.0f ? foldedX : -foldedX;
+			normal.y = y >= 0.0f ? foldedY : -foldedY;
+		}
+
+		return glm::normalize(normal);
+	}
+}
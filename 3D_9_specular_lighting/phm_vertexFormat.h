@@ -0,0 +1,71 @@
+#ifndef PHM_VERTEX_FORMAT_H
+#define PHM_VERTEX_FORMAT_H
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "phm_bounds.h"
+
+namespace phm
+{
+	/// <summary>
+	/// Layout of the vertex buffer of a model.
+	/// Full stores every attribute as 32 bit floats (Model::Vertex, 44 bytes).
+	/// Quantized packs the attributes into 20 bytes (QuantizedVertex), which less than halves the vertex fetch bandwidth.
+	/// </summary>
+	enum class VertexFormat : uint32_t
+	{
+		Full = 0,
+		Quantized = 1
+	};
+
+	static constexpr uint32_t VERTEX_FORMAT_COUNT = 2;
+
+	/// <summary>
+	/// Packed vertex. Every attribute is read as floats by the shader through a normalized or half float format, except the normal,
+	/// which the shader has to decode from its octahedral encoding (see the OCTAHEDRAL_NORMALS specialization constant).
+	/// Worst case errors:
+	/// - position: 1/131070 of the mesh bounds on each axis, the positions are relative to the bounds,
+	/// - normal: 0.04 degrees,
+	/// - uv: 1/2048 relative (half float), exact for values that are multiples of 1/1024 in [0, 1],
+	/// - color: 1/510.
+	/// </summary>
+	struct QuantizedVertex
+	{
+		uint16_t position[4];	// R16G16B16A16_UNORM in the mesh bounds, w unused
+		uint32_t normal;		// R16G16_SNORM octahedral encoding
+		uint16_t uv[2];			// R16G16_SFLOAT
+		uint8_t color[4];		// R8G8B8A8_UNORM, alpha unused
+
+		static QuantizedVertex encode(const glm::vec3& position, const glm::vec3& color, const glm::vec3& normal, const glm::vec2& uv, const AABB& bounds);
+
+		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+
+		// Maps the normalized positions back into the bounds. Folded into the model matrix of the instances.
+		static glm::mat4 getDequantizationMatrix(const AABB& bounds);
+	};
+
+	namespace packing
+	{
+		uint16_t packUnorm16(float value);
+		int16_t packSnorm16(float value);
+		uint8_t packUnorm8(float value);
+
+		// Rounds to nearest even, overflows to infinity.
+		uint16_t packHalf(float value);
+		float unpackHalf(uint16_t value);
+
+		// Maps the unit vector to the octahedron and unfolds it onto a square, two snorm16 values in the low and high half.
+		uint32_t packOctahedral(const glm::vec3& normal);
+		glm::vec3 unpackOctahedral(uint32_t value);
+	}
+}
+
+#endif /* PHM_VERTEX_FORMAT_H */
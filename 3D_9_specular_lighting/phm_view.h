@@ -0,0 +1,71 @@
+#ifndef PHM_VIEW_H
+#define PHM_VIEW_H
+
+#include <vector>
+
+#include "phm_archetype.h"
+#include "phm_entity.h"
+
+namespace phm
+{
+	namespace ecs
+	{
+		template<typename... Ts>
+		inline ComponentBitSet getComponentSignature()
+		{
+			ComponentBitSet signature{};
+			(signature.set(getComponentTypeID<Ts>()), ...);
+			return signature;
+		}
+
+		// Iterates all entities that have (at least) the components Ts. 
+		// The matching archetypes are cached by the storage, so creating and iterating a view doesn't allocate,
+		// and the cost scales with the number of matching entities rather than the total number of entities.
+		template<typename... Ts>
+		class View
+		{
+		public:
+			View(ArchetypeStorage& storage)
+				: storage_(&storage), archetypes_(&storage.getMatchingArchetypes(getComponentSignature<Ts...>()))
+			{}
+
+			// Calls func(uint32_t count, const EntityId* entities, Ts*... columns) for every non-empty chunk.
+			template<typename Func>
+			void eachChunk(Func&& func) const
+			{
+				for (const Archetype* archetype : *archetypes_)
+				{
+					for (size_t chunk = 0; chunk < archetype->getChunkCount(); chunk++)
+						func(archetype->getChunkSize(chunk), archetype->getEntities(chunk), archetype->template getColumn<Ts>(chunk)...);
+				}
+			}
+
+			// Calls func(Entity entity, Ts&... components) for every matching entity.
+			template<typename Func>
+			void each(Func&& func) const
+			{
+				eachChunk([this, &func](uint32_t count, const EntityId* entities, Ts*... columns)
+					{
+						for (uint32_t i = 0; i < count; i++)
+							func(Entity{ *storage_, entities[i] }, columns[i]...);
+					});
+			}
+
+			[[nodiscard]] uint32_t size() const
+			{
+				uint32_t count = 0;
+				for (const Archetype* archetype : *archetypes_)
+					count += archetype->size();
+				return count;
+			}
+
+			[[nodiscard]] inline const std::vector<Archetype*>& getArchetypes() const { return *archetypes_; };
+
+		private:
+			ArchetypeStorage* storage_;
+			const std::vector<Archetype*>* archetypes_;
+		};
+	}
+}
+
+#endif /* PHM_VIEW_H */
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "point_light_system.h"
+#include "phm_swapchain.h"
 #include "time.h"
 
 #define GLM_FORCE_RADIANS
@@ -9,6 +10,7 @@
 #include <glm/gtc/constants.hpp>
 
 #include <stdexcept>
+#include <algorithm>
 #include <array>
 #include <iostream>
 
@@ -16,7 +18,7 @@
 namespace phm
 {
 	PointLightSystem::PointLightSystem(Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-		: device_(device)
+		: device_(device), instanceBuffers_(Swapchain::MAX_FRAMES_IN_FLIGHT)
 	{
 		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
@@ -62,6 +64,13 @@ namespace phm
 		pipelineConfig.attributeDescriptions.clear();
 		pipelineConfig.bindingDescriptions.clear();
 
+		// The index of the light is the only instance data, the quad corners come from the vertex index.
+		pipelineConfig.bindingDescriptions.push_back({ 0, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE });
+		pipelineConfig.attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32_UINT, 0 });
+
+		// Blended back to front, the billboards must not hide each other in the depth buffer.
+		pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+
 		pipelineConfig.renderPass = renderPass;
 		pipelineConfig.pipelineLayout = pipelineLayout_;
 
@@ -74,8 +83,42 @@ namespace phm
 
 	}
 
-	void PointLightSystem::renderObjects(const FrameInfo& frameInfo, const VkDescriptorSet* const descriptorSet, const uint32_t activeLights) const
+	void PointLightSystem::renderObjects(const FrameInfo& frameInfo, const VkDescriptorSet* const descriptorSet, const std::vector<PointLight>& lights, RenderStats& stats)
 	{
+		const uint32_t lightCount = static_cast<uint32_t>(lights.size());
+		stats.lightSprites = 0;
+		if (lightCount == 0)
+			return;
+
+		spheres_.clear();
+		for (const PointLight& light : lights)
+			spheres_.push_back({ glm::vec3{ light.position.x, light.position.y, light.position.z }, light.position.w });
+
+		visible_.resize(lightCount);
+		const Frustum frustum = Frustum::fromMatrix(frameInfo.camera.getProjection() * frameInfo.camera.getView());
+		const uint32_t visibleCount = cullSpheres(frustum, spheres_, visible_.data());
+		if (visibleCount == 0)
+			return;
+
+		const glm::vec3 cameraPosition{ frameInfo.camera.getInverseView()[3] };
+		sprites_.clear();
+		for (uint32_t i = 0; i < lightCount; i++)
+		{
+			if (!visible_[i])
+				continue;
+
+			const glm::vec3 offset = glm::vec3{ lights[i].position.x, lights[i].position.y, lights[i].position.z } - cameraPosition;
+			sprites_.push_back({ glm::dot(offset, offset), i });
+		}
+
+		// Farthest first, ties broken by the light index so the order doesn't flicker between frames.
+		std::sort(sprites_.begin(), sprites_.end(), [](const Sprite& a, const Sprite& b)
+			{
+				return a.distanceSquared != b.distanceSquared ? a.distanceSquared > b.distanceSquared : a.light < b.light;
+			});
+
+		writeInstanceBuffer(frameInfo.frameIndex);
+
 		pipeline_->bind(frameInfo.commandBuffer);
 
 		vkCmdBindDescriptorSets(
@@ -89,6 +132,42 @@ namespace phm
 			nullptr
 		);
 
-		vkCmdDraw(frameInfo.commandBuffer, 6 * activeLights, 1, 0, 0);
+		VkBuffer instanceBuffer = instanceBuffers_[frameInfo.frameIndex]->getBuffer();
+		VkDeviceSize instanceOffset = 0;
+		vkCmdBindVertexBuffers(frameInfo.commandBuffer, 0, 1, &instanceBuffer, &instanceOffset);
+
+		// Instances are rasterized in order, so the quads blend back to front.
+		vkCmdDraw(frameInfo.commandBuffer, 6, visibleCount, 0, 0);
+
+		stats.lightSprites = visibleCount;
+		stats.drawCalls++;
+	}
+
+	void PointLightSystem::writeInstanceBuffer(int frameIndex)
+	{
+		const uint32_t spriteCount = static_cast<uint32_t>(sprites_.size());
+
+		// The fence of this frame index has been waited on before recording, so the old buffer is no longer in use.
+		std::unique_ptr<Buffer>& instanceBuffer = instanceBuffers_[frameIndex];
+		if (!instanceBuffer || instanceBuffer->getInstanceCount() < spriteCount)
+		{
+			// Grow geometrically so a slowly growing scene does not reallocate every frame.
+			uint32_t capacity = instanceBuffer ? instanceBuffer->getInstanceCount() : 64;
+			while (capacity < spriteCount)
+				capacity *= 2;
+
+			instanceBuffer = std::make_unique<Buffer>(
+				device_,
+				sizeof(uint32_t),
+				capacity,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				);
+			instanceBuffer->map();
+		}
+
+		auto* mapped = static_cast<uint32_t*>(instanceBuffer->getMappedMemory());
+		for (uint32_t i = 0; i < spriteCount; i++)
+			mapped[i] = sprites_[i].light;
 	}
 }
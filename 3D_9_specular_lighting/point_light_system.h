@@ -7,10 +7,15 @@
 #include "phm_camera.h"
 #include "phm_pipeline.h"
 #include "phm_frame_info.h"
+#include "phm_buffer.h"
+#include "phm_bounds.h"
 
 
 namespace phm
 {
+	// Draws a camera facing billboard for every point light in the light storage buffer.
+	// The billboards are frustum culled on the CPU and the visible ones drawn back to front, so their alpha blends in the right order.
+	// The sorted light indices are the instance data, each instance expands to one quad in the vertex shader.
 	class PointLightSystem
 	{
 
@@ -21,16 +26,32 @@ namespace phm
 		PointLightSystem(const PointLightSystem&) = delete;
 		PointLightSystem& operator=(const PointLightSystem&) = delete;
 
-		void renderObjects(const FrameInfo& frameInfo, const VkDescriptorSet* const descriptorSet, const uint32_t activeLights) const;
+		// The lights have to be the ones in the light buffer of the descriptor set, in the same order.
+		void renderObjects(const FrameInfo& frameInfo, const VkDescriptorSet* const descriptorSet, const std::vector<PointLight>& lights, RenderStats& stats);
 
 	private:
+		struct Sprite
+		{
+			float distanceSquared;
+			uint32_t light;
+		};
+
 		Device& device_;
 
 		std::unique_ptr<Pipeline> pipeline_;
 		VkPipelineLayout pipelineLayout_;
 
+		// Sorted light indices of each frame in flight, persistently mapped
+		std::vector<std::unique_ptr<Buffer>> instanceBuffers_;
+
+		// Scratch storage reused between frames to avoid reallocating every frame.
+		SphereBoundsSoA spheres_{};
+		std::vector<uint8_t> visible_{};
+		std::vector<Sprite> sprites_{};
+
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
 		void createPipeline(VkRenderPass renderPass);
+		void writeInstanceBuffer(int frameIndex);
 	};
 }
 
@@ -7,8 +7,8 @@ layout (location = 0) out vec4 outColor;
 
 struct PointLight
 {
-	vec4 position;
-	vec4 color;
+	vec4 position; // w is the radius
+	vec4 color; // w is the intensity
 };
 
 layout(set = 0, binding = 0) uniform GlobalUbo 
@@ -17,11 +17,24 @@ layout(set = 0, binding = 0) uniform GlobalUbo
 	mat4 view;
 	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLights[20];
-	int numPointLights;
+	vec4 clusterParameters; // x is the depth slice scale, y the depth slice bias, z the light cutoff
+	uvec4 clusterGrid; // xyz is the size of the cluster grid, w the number of lights
 } ubo;
+
+layout(std430, set = 0, binding = 1) readonly buffer Lights
+{
+	PointLight lights[];
+};
+
 void main()
 {
-	PointLight light = ubo.pointLights[lightIndex];
-	outColor = vec4(light.color.xyz, (1 - dot(fragOffset, fragOffset)) * 1.0);
+	// Round sprite, the corners of the quad would blend in with a negative alpha.
+	float distanceSquared = dot(fragOffset, fragOffset);
+	if (distanceSquared >= 1.0f)
+	{
+		discard;
+	}
+
+	PointLight light = lights[lightIndex];
+	outColor = vec4(light.color.xyz, (1 - distanceSquared) * 1.0);
 }
\ No newline at end of file
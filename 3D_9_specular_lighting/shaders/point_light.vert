@@ -9,13 +9,16 @@ const vec2 OFFSETS[6] = vec2[](
 	vec2(1.0, 1.0)
 );
 
+// The index of the light this billboard belongs to, the instances are sorted back to front.
+layout (location = 0) in uint spriteLight;
+
 layout (location = 0) out vec2 fragOffset;
 layout (location = 1) out flat int lightIndex;
 
 struct PointLight
 {
-	vec4 position;
-	vec4 color;
+	vec4 position; // w is the radius
+	vec4 color; // w is the intensity
 };
 
 layout(set = 0, binding = 0) uniform GlobalUbo 
@@ -24,16 +27,21 @@ layout(set = 0, binding = 0) uniform GlobalUbo
 	mat4 view;
 	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLights[20];
-	int numPointLights;
+	vec4 clusterParameters; // x is the depth slice scale, y the depth slice bias, z the light cutoff
+	uvec4 clusterGrid; // xyz is the size of the cluster grid, w the number of lights
 } ubo;
 
+layout(std430, set = 0, binding = 1) readonly buffer Lights
+{
+	PointLight lights[];
+};
+
 void main()
 {
-	int index = int(floor(gl_VertexIndex/6));
-	PointLight light = ubo.pointLights[index];
+	int index = int(spriteLight);
+	PointLight light = lights[index];
 
-	fragOffset = OFFSETS[gl_VertexIndex % 6];
+	fragOffset = OFFSETS[gl_VertexIndex];
 	vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
 	vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
@@ -8,8 +8,14 @@ layout (location = 0) out vec4 outColor;
 
 struct PointLight
 {
-	vec4 position;
-	vec4 color;
+	vec4 position; // w is the radius
+	vec4 color; // w is the intensity
+};
+
+struct Cluster
+{
+	uint offset;
+	uint count;
 };
 
 layout(set = 0, binding = 0) uniform GlobalUbo 
@@ -18,16 +24,36 @@ layout(set = 0, binding = 0) uniform GlobalUbo
 	mat4 view;
 	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLights[20];
-	int numPointLights;
+	vec4 clusterParameters; // x is the depth slice scale, y the depth slice bias, z the light cutoff
+	uvec4 clusterGrid; // xyz is the size of the cluster grid, w the number of lights
 } ubo;
 
-layout(push_constant) uniform Push
+layout(std430, set = 0, binding = 1) readonly buffer Lights
+{
+	PointLight lights[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Clusters
+{
+	Cluster clusters[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer LightIndices
 {
-	mat4 modelMatrix;
-	mat4 normalMatrix;
-} push;
+	uint lightIndices[];
+};
 
+// Same mapping as LightClusters: screen tiles in x and y, exponential depth slices in z.
+uint clusterIndex(vec3 positionWorld)
+{
+	vec4 positionView = ubo.view * vec4(positionWorld, 1.0f);
+	vec4 positionClip = ubo.projection * positionView;
+	vec2 tile = floor((positionClip.xy / positionClip.w * 0.5f + 0.5f) * vec2(ubo.clusterGrid.xy));
+	float slice = floor(log(max(positionView.z, 1e-4f)) * ubo.clusterParameters.x + ubo.clusterParameters.y);
+
+	uvec3 cluster = uvec3(clamp(vec3(tile, slice), vec3(0.0f), vec3(ubo.clusterGrid.xyz) - 1.0f));
+	return (cluster.z * ubo.clusterGrid.y + cluster.y) * ubo.clusterGrid.x + cluster.x;
+}
 
 void main()
 {
@@ -38,15 +64,19 @@ void main()
 	vec3 cameraPosWorld = ubo.inverseView[3].xyz;
 	vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
-	for (int i = 0; i < ubo.numPointLights; i++)
+	// Only the lights whose range reaches the cluster of the fragment
+	Cluster cluster = clusters[clusterIndex(fragPosWorld)];
+	for (uint i = 0; i < cluster.count; i++)
 	{
-		PointLight light = ubo.pointLights[i];
+		PointLight light = lights[lightIndices[cluster.offset + i]];
 		vec3 directionToLight = light.position.xyz - fragPosWorld;
-		float attenuation = 1.0 / dot(directionToLight, directionToLight); // Distance squared
+		float distanceSquared = dot(directionToLight, directionToLight);
+		// Inverse square falloff, lowered by the cutoff so it reaches zero at the edge of the light's range
+		float attenuation = max(light.color.w / distanceSquared - ubo.clusterParameters.z, 0.0f);
 		directionToLight = normalize(directionToLight);
 		
 		float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
-		vec3 intensity = light.color.xyz * light.color.w * attenuation;
+		vec3 intensity = light.color.xyz * attenuation;
 
 		diffuseLight += intensity * cosAngIncidence;
 		
@@ -59,4 +89,3 @@ void main()
 
 	outColor = vec4(diffuseLight * fragColor + specularLight * fragColor, 1.0); 
 }
-
@@ -5,41 +5,47 @@ layout(location = 1) in vec3 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
 
+// Per instance data
+layout(location = 4) in mat4 modelMatrix;
+layout(location = 8) in mat3 normalMatrix;
+
+// Set for the quantized vertex format, the normal then holds an octahedral encoding in xy.
+layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 
-struct PointLight
-{
-	vec4 position;
-	vec4 color;
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo 
 {
 	mat4 projection;
 	mat4 view;
 	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLights[20];
-	int numPointLights;
+	vec4 clusterParameters; // x is the depth slice scale, y the depth slice bias, z the light cutoff
+	uvec4 clusterGrid; // xyz is the size of the cluster grid, w the number of lights
 } ubo;
 
-layout(push_constant) uniform Push
-{
-	mat4 modelMatrix;
-	mat4 normalMatrix;
-} push;
 
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	if (normal.z < 0.0f)
+	{
+		normal.xy = (1.0f - abs(normal.yx)) * vec2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return normal;
+}
 
 void main()
 {
 	// Calculate vertex position in world space
-	vec4 positionWorld = push.modelMatrix * vec4(position, 1.0f);
-	gl_Position = ubo.projection * ubo.view * push.modelMatrix * vec4(position, 1.0);
+	vec4 positionWorld = modelMatrix * vec4(position, 1.0f);
+	gl_Position = ubo.projection * ubo.view * positionWorld;
 
 	// Only work when scaling is applied uniformly.
-	fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+	vec3 vertexNormal = OCTAHEDRAL_NORMALS ? decodeOctahedral(normal.xy) : normal;
+	fragNormalWorld = normalize(normalMatrix * vertexNormal);
 	fragPosWorld = positionWorld.xyz;
 	fragColor = color;
 }
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "simple_render_system.h"
+#include "phm_swapchain.h"
 #include "time.h"
 //#include "phm_entityComponentSystem.h"
 
@@ -11,19 +12,16 @@
 
 #include <stdexcept>
 #include <array>
+#include <algorithm>
+#include <cstring>
+#include <cfloat>
 #include <iostream>
 
 
 namespace phm
 {
-	struct SimplePushConstantData
-	{
-		glm::mat4 modelMatrix{ 1.0f };
-		glm::mat4 normalMatrix{ 1.0f };
-	};
-
 	SimpleRenderSystem::SimpleRenderSystem(Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-		: device_(device)
+		: device_(device), instanceBuffers_(Swapchain::MAX_FRAMES_IN_FLIGHT)
 	{
 		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
@@ -37,19 +35,14 @@ namespace phm
 	// Self documenting
 	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 	{
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(SimplePushConstantData);
-
 		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
 		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+		pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
 
 		if (vkCreatePipelineLayout(device_.device(), &pipelineLayoutCreateInfo, nullptr, &pipelineLayout_) != VK_SUCCESS)
 		{
@@ -64,26 +57,67 @@ namespace phm
 			"Cannot create pipeline before the pipeline layout"
 		);
 
-		phm::PipelineConfigInfo pipelineConfig{};
-		Pipeline::defaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout_;
+		for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++)
+		{
+			const VertexFormat vertexFormat = static_cast<VertexFormat>(format);
 
-		pipeline_ = std::make_unique<Pipeline>(
-			device_,
-			"shaders/simple_shader.vert.spv",
-			"shaders/simple_shader.frag.spv",
-			pipelineConfig
-			);
+			phm::PipelineConfigInfo pipelineConfig{};
+			Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+			pipelineConfig.renderPass = renderPass;
+			pipelineConfig.pipelineLayout = pipelineLayout_;
+			pipelineConfig.bindingDescriptions = Model::getBindingDescriptions(vertexFormat);
+			pipelineConfig.attributeDescriptions = Model::getAttributeDescriptions(vertexFormat);
 
+			addInstanceAttributes(pipelineConfig);
+
+			// OCTAHEDRAL_NORMALS, a VkBool32
+			const VkBool32 octahedralNormals = vertexFormat == VertexFormat::Quantized;
+			pipelineConfig.vertexSpecializationEntries.push_back({ 0, 0, sizeof(VkBool32) });
+			pipelineConfig.vertexSpecializationData.resize(sizeof(VkBool32));
+			std::memcpy(pipelineConfig.vertexSpecializationData.data(), &octahedralNormals, sizeof(VkBool32));
+
+			pipelines_[format] = std::make_unique<Pipeline>(
+				device_,
+				"shaders/simple_shader.vert.spv",
+				"shaders/simple_shader.frag.spv",
+				pipelineConfig
+				);
+		}
+	}
+
+	void SimpleRenderSystem::addInstanceAttributes(PipelineConfigInfo& pipelineConfig)
+	{
+		// Per instance model and normal matrices, each matrix column takes up one location.
+		pipelineConfig.bindingDescriptions.push_back({ 1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE });
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			pipelineConfig.attributeDescriptions.push_back({ 4 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+				static_cast<uint32_t>(offsetof(InstanceData, modelMatrix) + column * sizeof(glm::vec4)) });
+		}
+		for (uint32_t column = 0; column < 3; column++)
+		{
+			pipelineConfig.attributeDescriptions.push_back({ 8 + column, 1, VK_FORMAT_R32G32B32_SFLOAT,
+				static_cast<uint32_t>(offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3)) });
+		}
 	}
 
 	void SimpleRenderSystem::renderObjects(
 		const FrameInfo& frameInfo, 
-		const std::vector<ecs::Entity*>& entities,
-		const VkDescriptorSet* const descriptorSet) const
+		ecs::ArchetypeStorage& storage,
+		const std::vector<ecs::EntityId>& entities,
+		const VkDescriptorSet* const descriptorSet,
+		RenderStats& stats)
 	{
-		pipeline_->bind(frameInfo.commandBuffer);
+		stats.drawCalls = 0;
+		stats.triangles = 0;
+
+		// The instances are regrouped every frame, so all of them are written.
+		const uint32_t instanceCount = gatherInstances(frameInfo.camera, storage, entities);
+		stats.uploadedObjects = instanceCount;
+		if (instanceCount == 0)
+			return;
+
+		writeInstanceBuffer(frameInfo.frameIndex, instanceCount);
 
 		vkCmdBindDescriptorSets(
 			frameInfo.commandBuffer,
@@ -96,23 +130,166 @@ namespace phm
 			nullptr
 		);
 
-		for (auto& entity : entities)
+		VkBuffer instanceBuffer = instanceBuffers_[frameInfo.frameIndex]->getBuffer();
+		VkDeviceSize instanceOffset = 0;
+		vkCmdBindVertexBuffers(frameInfo.commandBuffer, 1, 1, &instanceBuffer, &instanceOffset);
+
+		// The batches are laid out back to back in the instance buffer, so each draw starts at the running instance offset.
+		// The pipelines share the layout, so the bound descriptor set stays valid when switching between them.
+		const glm::mat4 viewProjection = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+		const glm::vec4 cameraPosition = frameInfo.camera.getInverseView()[3];
+		// Orthographic cameras see every meshlet from the same direction, which the cone test doesn't handle.
+		const bool coneCulling = frameInfo.camera.getProjection()[3][3] == 0.0f;
+
+		uint32_t firstInstance = 0;
+		Pipeline* boundPipeline = nullptr;
+		bool poolBound = false;
+		for (uint32_t i = 0; i < batchCount_; i++)
+		{
+			const InstanceBatch& batch = batches_[i];
+			const uint32_t batchSize = static_cast<uint32_t>(batch.instances.size());
+
+			Pipeline* pipeline = pipelines_[static_cast<uint32_t>(batch.model->getVertexFormat())].get();
+			if (pipeline != boundPipeline)
+			{
+				pipeline->bind(frameInfo.commandBuffer);
+				boundPipeline = pipeline;
+				poolBound = false;
+			}
+
+			// Pooled models of one vertex format share the geometry buffers, which stay bound until the format changes.
+			if (!batch.model->isPooled() || !poolBound)
+			{
+				batch.model->bind(frameInfo.commandBuffer);
+				poolBound = batch.model->isPooled();
+			}
+
+			if (batch.model->hasMeshlets(batch.lod))
+			{
+				// The meshlet bounds are in model space, so the frustum and the camera are brought into the space of each instance.
+				for (uint32_t instance = 0; instance < batchSize; instance++)
+				{
+					const glm::mat4& transform = batch.transforms[instance];
+					const Frustum frustum = Frustum::fromMatrix(viewProjection * transform);
+					const glm::vec3 modelCameraPosition{ glm::inverse(transform) * cameraPosition };
+
+					uint32_t triangles;
+					stats.drawCalls += batch.model->drawMeshlets(frameInfo.commandBuffer, firstInstance + instance, batch.lod, frustum, modelCameraPosition, coneCulling, triangles);
+					stats.triangles += triangles;
+				}
+			}
+			else
+			{
+				batch.model->draw(frameInfo.commandBuffer, batchSize, firstInstance, batch.lod);
+				stats.drawCalls += batch.model->getDrawCount(batch.lod);
+				stats.triangles += batch.model->getTriangleCount(batch.lod) * batchSize;
+			}
+			firstInstance += batchSize;
+		}
+	}
+
+	uint32_t SimpleRenderSystem::gatherInstances(const Camera& camera, ecs::ArchetypeStorage& storage, const std::vector<ecs::EntityId>& entities)
+	{
+		for (uint32_t i = 0; i < batchCount_; i++)
+		{
+			batches_[i].instances.clear();
+			batches_[i].transforms.clear();
+		}
+		batchLookup_.clear();
+		batchCount_ = 0;
+
+		// The projected radius is the world radius scaled by the focal length over the distance, which is constant for orthographic projections.
+		const glm::mat4& projection = camera.getProjection();
+		const glm::vec3 cameraPosition{ camera.getInverseView()[3] };
+		const bool perspective = projection[3][3] == 0.0f;
+
+		uint32_t instanceCount = 0;
+		for (ecs::EntityId id : entities)
+		{
+			ecs::Entity entity{ storage, id };
+			const Transform& transform = entity.transform();
+			ecs::ModelComponent& component = entity.getComponent<ecs::ModelComponent>();
+			Model* model = component.model.get();
+			if (model == nullptr)
+				continue;
+
+			const glm::mat4 transformMatrix = transform.mat4();
+
+			if (model->getLodCount() > 1)
+			{
+				const BoundingSphere sphere = model->getBoundingSphere().transformed(transformMatrix);
+				const float distance = glm::length(sphere.center - cameraPosition);
+
+				// Inside the sphere the full resolution is always selected.
+				float projectedRadius = sphere.radius * projection[1][1];
+				if (perspective)
+					projectedRadius = distance > sphere.radius ? projectedRadius / distance : FLT_MAX;
+
+				component.lod = model->selectLod(std::abs(projectedRadius), std::min(component.lod, model->getLodCount() - 1));
+			}
+			else
+			{
+				component.lod = 0;
+			}
+
+			auto [it, inserted] = batchLookup_.try_emplace(BatchKey{ model, component.lod }, batchCount_);
+			if (inserted)
+			{
+				if (batchCount_ == batches_.size())
+					batches_.emplace_back();
+
+				batches_[batchCount_].model = model;
+				batches_[batchCount_].lod = component.lod;
+				batchCount_++;
+			}
+
+			// Quantized positions are mapped back into model space by the model matrix.
+			glm::mat4 modelMatrix = transformMatrix;
+			if (model->getVertexFormat() != VertexFormat::Full)
+				modelMatrix = modelMatrix * model->getDequantizationMatrix();
+
+			batches_[it->second].instances.push_back({ modelMatrix, transform.normalMatrix() });
+			if (model->hasMeshlets(component.lod))
+				batches_[it->second].transforms.push_back(transformMatrix);
+			instanceCount++;
+		}
+
+		// Batches of the same vertex format are drawn back to back, so the pipeline and the geometry pool are bound once per format.
+		std::stable_sort(batches_.begin(), batches_.begin() + batchCount_, [](const InstanceBatch& a, const InstanceBatch& b)
+		{
+			return a.model->getVertexFormat() < b.model->getVertexFormat();
+		});
+
+		return instanceCount;
+	}
+
+	void SimpleRenderSystem::writeInstanceBuffer(int frameIndex, uint32_t instanceCount)
+	{
+		// The fence of this frame index has been waited on before recording, so the old buffer is no longer in use.
+		std::unique_ptr<Buffer>& instanceBuffer = instanceBuffers_[frameIndex];
+		if (!instanceBuffer || instanceBuffer->getInstanceCount() < instanceCount)
+		{
+			// Grow geometrically so a slowly growing scene does not reallocate every frame.
+			uint32_t capacity = instanceBuffer ? instanceBuffer->getInstanceCount() : 64;
+			while (capacity < instanceCount)
+				capacity *= 2;
+
+			instanceBuffer = std::make_unique<Buffer>(
+				device_,
+				sizeof(InstanceData),
+				capacity,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				);
+			instanceBuffer->map();
+		}
+
+		auto* mapped = static_cast<InstanceData*>(instanceBuffer->getMappedMemory());
+		for (uint32_t i = 0; i < batchCount_; i++)
 		{
-			ecs::ModelComponent& modelComponent = entity->getComponent<ecs::ModelComponent>();
-			
-			SimplePushConstantData push{};
-			push.modelMatrix = entity->transform.mat4();
-			push.normalMatrix = entity->transform.normalMatrix();
-			
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
-				pipelineLayout_,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(SimplePushConstantData),
-				&push);
-			modelComponent.model->bind(frameInfo.commandBuffer);
-			modelComponent.model->draw(frameInfo.commandBuffer);
+			const std::vector<InstanceData>& instances = batches_[i].instances;
+			std::copy(instances.begin(), instances.end(), mapped);
+			mapped += instances.size();
 		}
 	}
 }
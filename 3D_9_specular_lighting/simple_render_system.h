@@ -1,20 +1,26 @@
 #ifndef PHM_SIMPLE_RENDER_SYSTEM_H
 #define PHM_SIMPLE_RENDER_SYSTEM_H
 
+#include <array>
 #include <memory>
 #include <vector>
+#include <unordered_map>
+#include <utility>
 
 #include "phm_camera.h"
 #include "phm_pipeline.h"
 #include "phm_frame_info.h"
 
 #include "phm_entity.h"
+#include "phm_archetype.h"
 #include "phm_model.h"
 
 
 namespace phm
 {
-	// Renders objects that have a normal model
+	// Renders objects that have a normal model.
+	// Entities sharing a model and level of detail are drawn with a single instanced draw call.
+	// Large models split into meshlets are culled per meshlet and drawn one instance at a time instead.
 	class SimpleRenderSystem
 	{
 
@@ -25,19 +31,59 @@ namespace phm
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
+		// Draws the given entities, which must have a ModelComponent. Fills in the draw call and triangle counts of the stats.
 		void renderObjects(
 			const FrameInfo& frameInfo, 
-			const std::vector<ecs::Entity*>& entities,
-			const VkDescriptorSet* const descriptorSet) const;
+			ecs::ArchetypeStorage& storage,
+			const std::vector<ecs::EntityId>& entities,
+			const VkDescriptorSet* const descriptorSet,
+			RenderStats& stats);
 
 	private:
+		// Per instance vertex data, read through vertex binding 1.
+		struct InstanceData
+		{
+			glm::mat4 modelMatrix{ 1.0f };
+			glm::mat3 normalMatrix{ 1.0f };
+		};
+
+		// All instances of one level of detail of a model for the current frame.
+		struct InstanceBatch
+		{
+			Model* model = nullptr;
+			uint32_t lod = 0;
+			std::vector<InstanceData> instances{};
+			// Model to world transforms of the instances, only gathered if the level of detail is culled per meshlet.
+			std::vector<glm::mat4> transforms{};
+		};
+
+		using BatchKey = std::pair<Model*, uint32_t>;
+		struct BatchKeyHash
+		{
+			size_t operator()(const BatchKey& key) const { return std::hash<Model*>{}(key.first) ^ (static_cast<size_t>(key.second) * 0x9E3779B97F4A7C15ull); }
+		};
+
 		Device& device_;
 
-		std::unique_ptr<Pipeline> pipeline_;
+		// One pipeline per vertex format, the shader is specialized for the format.
+		std::array<std::unique_ptr<Pipeline>, VERTEX_FORMAT_COUNT> pipelines_{};
 		VkPipelineLayout pipelineLayout_;
 
+		// One instance buffer per frame in flight, grown on demand.
+		std::vector<std::unique_ptr<Buffer>> instanceBuffers_;
+
+		// Scratch storage reused between frames to avoid reallocating every frame.
+		std::unordered_map<BatchKey, uint32_t, BatchKeyHash> batchLookup_{};
+		std::vector<InstanceBatch> batches_{};
+		uint32_t batchCount_ = 0;
+
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
 		void createPipeline(VkRenderPass renderPass);
+		void addInstanceAttributes(PipelineConfigInfo& pipelineConfig);
+
+		// Groups the entities by model and the level of detail selected for their distance to the camera.
+		uint32_t gatherInstances(const Camera& camera, ecs::ArchetypeStorage& storage, const std::vector<ecs::EntityId>& entities);
+		void writeInstanceBuffer(int frameIndex, uint32_t instanceCount);
 	};
 }
 
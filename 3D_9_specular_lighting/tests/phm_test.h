@@ -0,0 +1,42 @@
+#ifndef PHM_TEST_H
+#define PHM_TEST_H
+
+#include <cstdio>
+
+// Minimal checks for the tests. Every test is a separate executable that returns a non zero exit code when a check failed,
+// which is all CTest needs.
+namespace phm
+{
+	namespace test
+	{
+		inline int& failureCount()
+		{
+			static int failures = 0;
+			return failures;
+		}
+
+		inline void check(bool condition, const char* expression, const char* file, int line)
+		{
+			if (condition)
+				return;
+
+			std::printf("%s:%d: check failed: %s\n", file, line, expression);
+			failureCount()++;
+		}
+
+		// Returns the exit code of the test.
+		inline int result()
+		{
+			if (failureCount() == 0)
+				std::printf("All checks passed\n");
+			else
+				std::printf("%d check(s) failed\n", failureCount());
+
+			return failureCount() == 0 ? 0 : 1;
+		}
+	}
+}
+
+#define PHM_CHECK(condition) phm::test::check((condition), #condition, __FILE__, __LINE__)
+
+#endif /* PHM_TEST_H */
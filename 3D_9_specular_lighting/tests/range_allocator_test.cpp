@@ -0,0 +1,121 @@
+#include "pch.h"
+
+#include "phm_test.h"
+
+#include "phm_rangeAllocator.h"
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+// Stress test of the TLSF range allocator behind the device memory allocator. Random allocations and frees of random sizes
+// and alignments are checked against a shadow copy: ranges have to be aligned, in bounds and never overlap,
+// and the statistics have to match. Once everything is freed the whole resource has to be one free range again.
+
+namespace
+{
+	constexpr uint64_t RESOURCE_SIZE = 64ull * 1024 * 1024;
+	constexpr uint32_t ITERATIONS = 200'000;
+
+	bool overlapsNeighbours(const std::map<uint64_t, uint64_t>& ranges, uint64_t offset, uint64_t size)
+	{
+		auto next = ranges.lower_bound(offset);
+		if (next != ranges.end() && next->first < offset + size)
+			return true;
+		if (next != ranges.begin() && std::prev(next)->second > offset)
+			return true;
+		return false;
+	}
+}
+
+int main()
+{
+	phm::RangeAllocator allocator{ RESOURCE_SIZE };
+	PHM_CHECK(allocator.isEmpty());
+	PHM_CHECK(allocator.getFreeSize() == RESOURCE_SIZE);
+	PHM_CHECK(allocator.getLargestFreeRange() == RESOURCE_SIZE);
+
+	std::mt19937 random{ 7 };
+	std::uniform_int_distribution<uint32_t> action{ 0, 99 };
+	// Mostly small allocations with the occasional large one, like buffers and images.
+	std::uniform_int_distribution<uint64_t> smallSize{ 1, 4096 };
+	std::uniform_int_distribution<uint64_t> largeSize{ 4096, 4ull * 1024 * 1024 };
+	const uint64_t alignments[] = { 1, 4, 16, 256, 4096, 65536 };
+	std::uniform_int_distribution<size_t> alignmentIndex{ 0, std::size(alignments) - 1 };
+
+	std::vector<phm::RangeAllocator::Allocation> allocations{};
+	// offset -> end of every live allocation
+	std::map<uint64_t, uint64_t> ranges{};
+	uint64_t allocatedSize = 0;
+
+	uint32_t failedAllocations = 0;
+	uint32_t misaligned = 0;
+	uint32_t outOfBounds = 0;
+	uint32_t overlapping = 0;
+	uint32_t tooSmall = 0;
+
+	for (uint32_t i = 0; i < ITERATIONS; i++)
+	{
+		// Allocate more than free while the resource is mostly empty, so it fills up and fragments.
+		const bool allocate = allocations.empty() || action(random) < (allocatedSize < RESOURCE_SIZE / 2 ? 70u : 45u);
+		if (allocate)
+		{
+			const uint64_t size = action(random) < 90 ? smallSize(random) : largeSize(random);
+			const uint64_t alignment = alignments[alignmentIndex(random)];
+
+			const phm::RangeAllocator::Allocation allocation = allocator.allocate(size, alignment);
+			if (!allocation.isValid())
+			{
+				failedAllocations++;
+				continue;
+			}
+
+			misaligned += allocation.offset % alignment != 0;
+			outOfBounds += allocation.offset + allocation.size > RESOURCE_SIZE;
+			tooSmall += allocation.size < size;
+			overlapping += overlapsNeighbours(ranges, allocation.offset, allocation.size);
+
+			ranges[allocation.offset] = allocation.offset + allocation.size;
+			allocatedSize += allocation.size;
+			allocations.push_back(allocation);
+		}
+		else
+		{
+			std::uniform_int_distribution<size_t> pick{ 0, allocations.size() - 1 };
+			const size_t index = pick(random);
+			const phm::RangeAllocator::Allocation allocation = allocations[index];
+			allocations[index] = allocations.back();
+			allocations.pop_back();
+
+			allocator.free(allocation.handle);
+			ranges.erase(allocation.offset);
+			allocatedSize -= allocation.size;
+		}
+
+		PHM_CHECK(allocator.getAllocationCount() == allocations.size());
+		PHM_CHECK(allocator.getFreeSize() == RESOURCE_SIZE - allocatedSize);
+	}
+
+	PHM_CHECK(misaligned == 0);
+	PHM_CHECK(outOfBounds == 0);
+	PHM_CHECK(overlapping == 0);
+	PHM_CHECK(tooSmall == 0);
+	std::printf("%u allocations live at the end, %u free ranges, %u allocations failed\n",
+		static_cast<uint32_t>(allocations.size()), allocator.getFreeRangeCount(), failedAllocations);
+
+	// Freeing everything has to merge all ranges back together.
+	for (const phm::RangeAllocator::Allocation& allocation : allocations)
+		allocator.free(allocation.handle);
+
+	PHM_CHECK(allocator.isEmpty());
+	PHM_CHECK(allocator.getFreeSize() == RESOURCE_SIZE);
+	PHM_CHECK(allocator.getFreeRangeCount() == 1);
+	PHM_CHECK(allocator.getLargestFreeRange() == RESOURCE_SIZE);
+
+	// A fully merged resource can hand out all of it at once.
+	const phm::RangeAllocator::Allocation whole = allocator.allocate(RESOURCE_SIZE);
+	PHM_CHECK(whole.isValid() && whole.offset == 0);
+
+	return phm::test::result();
+}
@@ -0,0 +1,220 @@
+#include "pch.h"
+
+#include "phm_test.h"
+
+#include "phm_scheduler.h"
+#include "phm_entity.h"
+#include "phm_functionComponent.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+// Runs the same scene with the scheduler in parallel and in serial mode and checks that every transform ends up bit for bit the same.
+// The systems conflict on purpose, so a wrong order in either mode changes the result.
+// The serial run also checks that nothing runs off the calling thread.
+
+namespace
+{
+	constexpr uint32_t ENTITY_COUNT = 20'000;
+	constexpr uint32_t FRAME_COUNT = 60;
+	constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+	// Counts the chunk loops and component updates that ran on another thread than the one running the scheduler.
+	std::thread::id schedulerThread{};
+	std::atomic<uint32_t> offThreadCalls{ 0 };
+
+	void recordThread()
+	{
+		if (std::this_thread::get_id() != schedulerThread)
+			offThreadCalls++;
+	}
+
+	struct Velocity
+	{
+		glm::vec3 value{};
+	};
+
+	struct Spin
+	{
+		float speed = 0.0f;
+	};
+
+	// Moves the entities along their velocity.
+	class MoveSystem : public phm::ecs::System
+	{
+	public:
+		MoveSystem() : System("Move")
+		{
+			readsComponents<Velocity>();
+			writesComponents<phm::Transform>();
+		}
+
+		void update(const phm::ecs::SystemContext& context) override
+		{
+			context.parallelEachChunk(context.view<phm::Transform, Velocity>(),
+				[&](uint32_t count, const phm::ecs::EntityId*, phm::Transform* transforms, Velocity* velocities)
+				{
+					recordThread();
+					for (uint32_t i = 0; i < count; i++)
+						transforms[i].setTranslation(transforms[i].getTranslation() + velocities[i].value * context.frameInfo.deltaTime);
+				});
+		}
+	};
+
+	// Pulls the velocity towards the origin, so it depends on the translation written by MoveSystem.
+	class SpringSystem : public phm::ecs::System
+	{
+	public:
+		SpringSystem() : System("Spring")
+		{
+			readsComponents<phm::Transform>();
+			writesComponents<Velocity>();
+		}
+
+		void update(const phm::ecs::SystemContext& context) override
+		{
+			context.parallelEachChunk(context.view<phm::Transform, Velocity>(),
+				[&](uint32_t count, const phm::ecs::EntityId*, phm::Transform* transforms, Velocity* velocities)
+				{
+					recordThread();
+					for (uint32_t i = 0; i < count; i++)
+						velocities[i].value -= transforms[i].getTranslation() * (2.0f * context.frameInfo.deltaTime);
+				});
+		}
+	};
+
+	// Rotates the entities by an amount that depends on their translation.
+	class SpinSystem : public phm::ecs::System
+	{
+	public:
+		SpinSystem() : System("Spin")
+		{
+			readsComponents<Spin>();
+			writesComponents<phm::Transform>();
+		}
+
+		void update(const phm::ecs::SystemContext& context) override
+		{
+			context.parallelEachChunk(context.view<phm::Transform, Spin>(),
+				[&](uint32_t count, const phm::ecs::EntityId*, phm::Transform* transforms, Spin* spins)
+				{
+					recordThread();
+					for (uint32_t i = 0; i < count; i++)
+					{
+						const float angle = spins[i].speed * context.frameInfo.deltaTime * (1.0f + transforms[i].getTranslation().x);
+						transforms[i].setRotation(transforms[i].getRotation() + glm::vec3{ 0.0f, angle, 0.0f });
+					}
+				});
+		}
+	};
+
+	// Slows the spins down. Doesn't touch the components of MoveSystem and SpringSystem, so it runs concurrently with them.
+	class FrictionSystem : public phm::ecs::System
+	{
+	public:
+		FrictionSystem() : System("Friction")
+		{
+			writesComponents<Spin>();
+		}
+
+		void update(const phm::ecs::SystemContext& context) override
+		{
+			context.view<Spin>().eachChunk([&](uint32_t count, const phm::ecs::EntityId*, Spin* spins)
+				{
+					for (uint32_t i = 0; i < count; i++)
+						spins[i].speed *= 0.99f;
+				});
+		}
+	};
+
+	struct Scene
+	{
+		phm::ecs::ArchetypeStorage storage{};
+		std::vector<phm::ecs::EntityId> entities{};
+	};
+
+	// Builds the same scene every time, spread over several archetypes.
+	void buildScene(Scene& scene)
+	{
+		for (uint32_t i = 0; i < ENTITY_COUNT; i++)
+		{
+			phm::ecs::Entity entity{ scene.storage, scene.storage.createEntity() };
+			entity.addComponent<phm::Transform>();
+			entity.transform().setTranslation(glm::vec3{ static_cast<float>(i % 97) * 0.1f, static_cast<float>(i % 13), static_cast<float>(i % 7) });
+
+			if (i % 2 == 0)
+				entity.addComponent<Velocity>().value = glm::vec3{ 1.0f, static_cast<float>(i % 5) * 0.5f, -1.0f };
+			if (i % 3 == 0)
+				entity.addComponent<Spin>().speed = static_cast<float>(i % 11);
+			if (i % 5 == 0)
+			{
+				// Grows with the height written by MoveSystem
+				entity.addComponent<phm::ecs::FunctionComponent<>>([](phm::ecs::Entity& e, const std::array<const int, 0>&)
+					{
+						recordThread();
+						e.transform().setScale(glm::vec3{ 1.0f + 0.01f * e.transform().getTranslation().y });
+					});
+			}
+
+			scene.entities.push_back(entity.getId());
+		}
+	}
+
+	void runScene(Scene& scene, phm::JobSystem& jobSystem, bool parallel)
+	{
+		phm::ecs::SystemScheduler scheduler{ jobSystem };
+		scheduler.addSystem<MoveSystem>(phm::ecs::SystemStage::Update);
+		scheduler.addSystem<phm::ecs::ComponentUpdateSystem>(phm::ecs::SystemStage::Update, phm::ecs::getComponentTypeID<phm::ecs::FunctionComponent<>>());
+		scheduler.addSystem<SpringSystem>(phm::ecs::SystemStage::Update);
+		scheduler.addSystem<FrictionSystem>(phm::ecs::SystemStage::Update);
+		scheduler.addSystem<SpinSystem>(phm::ecs::SystemStage::PostUpdate);
+		scheduler.setParallel(parallel);
+
+		phm::Camera camera{};
+		const phm::FrameInfo frameInfo{ 0, DELTA_TIME, VK_NULL_HANDLE, camera };
+		schedulerThread = std::this_thread::get_id();
+		offThreadCalls = 0;
+		for (uint32_t frame = 0; frame < FRAME_COUNT; frame++)
+			scheduler.run(frameInfo, scene.storage);
+	}
+
+	bool sameBits(const glm::vec3& a, const glm::vec3& b)
+	{
+		return std::memcmp(&a, &b, sizeof(glm::vec3)) == 0;
+	}
+}
+
+int main()
+{
+	phm::JobSystem jobSystem{ 4 };
+
+	Scene parallelScene{};
+	buildScene(parallelScene);
+	runScene(parallelScene, jobSystem, true);
+
+	// Same job system, serial mode has to keep everything on this thread anyway
+	Scene serialScene{};
+	buildScene(serialScene);
+	runScene(serialScene, jobSystem, false);
+	PHM_CHECK(offThreadCalls == 0);
+
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < ENTITY_COUNT; i++)
+	{
+		const phm::Transform& a = phm::ecs::Entity{ parallelScene.storage, parallelScene.entities[i] }.transform();
+		const phm::Transform& b = phm::ecs::Entity{ serialScene.storage, serialScene.entities[i] }.transform();
+
+		if (!sameBits(a.getTranslation(), b.getTranslation()) || !sameBits(a.getRotation(), b.getRotation())
+			|| !sameBits(a.getScale(), b.getScale()) || a.getVersion() != b.getVersion())
+			mismatches++;
+	}
+	PHM_CHECK(mismatches == 0);
+
+	// Make sure the systems actually did something.
+	const phm::Transform& moved = phm::ecs::Entity{ serialScene.storage, serialScene.entities[10] }.transform();
+	PHM_CHECK(moved.getVersion() > 0);
+	PHM_CHECK(moved.getScale().x != 1.0f);
+
+	return phm::test::result();
+}
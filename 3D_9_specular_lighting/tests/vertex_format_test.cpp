@@ -0,0 +1,136 @@
+#include "pch.h"
+
+#include "phm_test.h"
+
+#include "phm_vertexFormat.h"
+#include "phm_model.h"
+
+#include <cmath>
+#include <random>
+
+// Encodes random vertices into QuantizedVertex, decodes them the way the vertex shader reads the formats,
+// and checks the worst case errors documented on QuantizedVertex. Also compares the vertex fetch bandwidth of both formats.
+
+namespace
+{
+	constexpr uint32_t SAMPLE_COUNT = 1'000'000;
+
+	// The encoder works in floats, which adds rounding far below the quantization steps.
+	constexpr double ROUNDING = 1e-6;
+
+	double angleDegrees(const glm::vec3& a, const glm::vec3& b)
+	{
+		const double crossX = static_cast<double>(a.y) * b.z - static_cast<double>(a.z) * b.y;
+		const double crossY = static_cast<double>(a.z) * b.x - static_cast<double>(a.x) * b.z;
+		const double crossZ = static_cast<double>(a.x) * b.y - static_cast<double>(a.y) * b.x;
+		const double dot = static_cast<double>(a.x) * b.x + static_cast<double>(a.y) * b.y + static_cast<double>(a.z) * b.z;
+		return std::atan2(std::sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot) * 180.0 / 3.14159265358979323846;
+	}
+}
+
+int main()
+{
+	std::mt19937 random{ 1234 };
+	std::uniform_real_distribution<float> unit{ -1.0f, 1.0f };
+	std::uniform_real_distribution<float> zeroToOne{ 0.0f, 1.0f };
+
+	const phm::AABB bounds{ glm::vec3{ -3.0f, 0.5f, -100.0f }, glm::vec3{ 5.0f, 0.75f, 250.0f } };
+	const glm::vec3 size = bounds.max - bounds.min;
+
+	double positionError = 0.0;
+	double normalError = 0.0;
+	double uvError = 0.0;
+	double colorError = 0.0;
+
+	for (uint32_t i = 0; i < SAMPLE_COUNT; i++)
+	{
+		const glm::vec3 position = bounds.min + glm::vec3{ zeroToOne(random), zeroToOne(random), zeroToOne(random) } * size;
+		const glm::vec3 color{ zeroToOne(random), zeroToOne(random), zeroToOne(random) };
+		glm::vec3 normal{ unit(random), unit(random), unit(random) };
+		if (glm::dot(normal, normal) < 1e-6f)
+			normal = glm::vec3{ 0.0f, 0.0f, 1.0f };
+		normal = glm::normalize(normal);
+		const glm::vec2 uv{ unit(random) * 2.0f, unit(random) * 2.0f };
+
+		const phm::QuantizedVertex vertex = phm::QuantizedVertex::encode(position, color, normal, uv, bounds);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			// R16G16B16A16_UNORM, then the dequantization matrix
+			const double decoded = bounds.min[axis] + vertex.position[axis] / 65535.0 * size[axis];
+			positionError = std::max(positionError, std::abs(decoded - position[axis]) / size[axis]);
+
+			// R8G8B8A8_UNORM
+			colorError = std::max(colorError, std::abs(vertex.color[axis] / 255.0 - color[axis]));
+		}
+
+		normalError = std::max(normalError, angleDegrees(phm::packing::unpackOctahedral(vertex.normal), normal));
+
+		// R16G16_SFLOAT, relative error
+		for (int axis = 0; axis < 2; axis++)
+		{
+			const double decoded = phm::packing::unpackHalf(vertex.uv[axis]);
+			if (std::abs(uv[axis]) >= 1.0f / 16384.0f)
+				uvError = std::max(uvError, std::abs(decoded - uv[axis]) / std::abs(uv[axis]));
+		}
+	}
+
+	std::printf("Worst errors over %u vertices: position %g of the bounds, normal %g degrees, uv %g relative, color %g\n",
+		SAMPLE_COUNT, positionError, normalError, uvError, colorError);
+
+	PHM_CHECK(positionError <= 1.0 / 131070.0 + ROUNDING);
+	PHM_CHECK(normalError <= 0.04);
+	PHM_CHECK(uvError <= 1.0 / 2048.0 + ROUNDING);
+	PHM_CHECK(colorError <= 1.0 / 510.0 + ROUNDING);
+
+	// The axes and the corners of the octahedron are the edge cases of the folding.
+	const glm::vec3 edgeNormals[] = {
+		{ 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f },
+		glm::normalize(glm::vec3{ 1.0f, 1.0f, -1.0f }), glm::normalize(glm::vec3{ -1.0f, 1.0f, -1.0f }),
+		glm::normalize(glm::vec3{ 1.0f, -1.0f, -1.0f }), glm::normalize(glm::vec3{ -1.0f, -1.0f, -1.0f }),
+	};
+	for (const glm::vec3& normal : edgeNormals)
+		PHM_CHECK(angleDegrees(phm::packing::unpackOctahedral(phm::packing::packOctahedral(normal)), normal) <= 0.04);
+
+	// Texture coordinates on a 1/1024 grid in [0, 1] are exact.
+	uint32_t inexactUvs = 0;
+	for (uint32_t i = 0; i <= 1024; i++)
+	{
+		const float value = i / 1024.0f;
+		inexactUvs += phm::packing::unpackHalf(phm::packing::packHalf(value)) != value;
+	}
+	PHM_CHECK(inexactUvs == 0);
+
+	// Every half float, normal or not, survives a round trip through float.
+	uint32_t halfMismatches = 0;
+	for (uint32_t bits = 0; bits <= 0xFFFF; bits++)
+	{
+		const uint16_t half = static_cast<uint16_t>(bits);
+		const float value = phm::packing::unpackHalf(half);
+		if (std::isnan(value))
+			halfMismatches += (phm::packing::packHalf(value) & 0x7FFF) <= 0x7C00;
+		else
+			halfMismatches += phm::packing::packHalf(value) != half;
+	}
+	PHM_CHECK(halfMismatches == 0);
+	PHM_CHECK(phm::packing::packHalf(1e6f) == 0x7C00);
+	PHM_CHECK(phm::packing::packHalf(-1e6f) == 0xFC00);
+
+	// A flat axis decodes to the bounds.
+	const phm::AABB flat{ glm::vec3{ 0.0f, 2.0f, 0.0f }, glm::vec3{ 1.0f, 2.0f, 1.0f } };
+	const phm::QuantizedVertex flatVertex = phm::QuantizedVertex::encode(glm::vec3{ 0.5f, 2.0f, 0.5f }, glm::vec3{ 1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f }, glm::vec2{ 0.0f }, flat);
+	PHM_CHECK(flatVertex.position[1] == 0);
+
+	// Bandwidth: every vertex fetched by the vertex shader reads the whole stride.
+	const uint32_t vertexCount = 1'000'000;
+	const double fullMiB = static_cast<double>(sizeof(phm::Model::Vertex)) * vertexCount / (1024.0 * 1024.0);
+	const double quantizedMiB = static_cast<double>(sizeof(phm::QuantizedVertex)) * vertexCount / (1024.0 * 1024.0);
+	std::printf("Vertex fetch of %u vertices: Full %zu bytes each, %.1f MiB, Quantized %zu bytes each, %.1f MiB (%.0f%%)\n",
+		vertexCount, sizeof(phm::Model::Vertex), fullMiB, sizeof(phm::QuantizedVertex), quantizedMiB, 100.0 * quantizedMiB / fullMiB);
+
+	PHM_CHECK(sizeof(phm::Model::Vertex) == 44);
+	PHM_CHECK(sizeof(phm::QuantizedVertex) == 20);
+	PHM_CHECK(2 * sizeof(phm::QuantizedVertex) < sizeof(phm::Model::Vertex));
+
+	return phm::test::result();
+}